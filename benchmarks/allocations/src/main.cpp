@@ -0,0 +1,296 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// Steady-state allocation benchmark
+//
+// Replaces the global operator new / delete of this process (and therefore of
+// tcp_pubsub, the standard library and asio) with counting versions. A
+// publisher sends messages to a subscriber over loopback, one at a time, and
+// after a warm-up phase the allocations are counted:
+//
+//  - in_send:  allocations within Publisher::send() on the sending thread
+//  - total:    all allocations of the process, i.e. sending, writing,
+//              receiving and calling back
+//
+// Both are given per message. If the total exceeds the budget
+// (--budget, allocations per message) for any combination, the program
+// exits with 1, so it can be used as a regression check. Results are printed
+// to stdout as CSV (default) or as one JSON object per line.
+//
+// Usage:
+//   allocations [--sizes 64,65536] [--modes best_effort,reliable]
+//               [--callbacks sync,async] [--messages 10000] [--warmup 1000]
+//               [--budget 16] [--format csv|json]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+////////////////////////////////////////////////
+// Counting allocator
+////////////////////////////////////////////////
+
+namespace
+{
+  std::atomic<uint64_t>  total_allocations { 0 };
+  thread_local uint64_t  thread_allocations = 0;
+
+  void* countedAllocate(std::size_t size)
+  {
+    total_allocations.fetch_add(1, std::memory_order_relaxed);
+    thread_allocations++;
+
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+      throw std::bad_alloc();
+    return memory;
+  }
+}
+
+void* operator new  (std::size_t size)                                  { return countedAllocate(size); }
+void* operator new[](std::size_t size)                                  { return countedAllocate(size); }
+void* operator new  (std::size_t size, const std::nothrow_t&) noexcept  { try { return countedAllocate(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept  { try { return countedAllocate(size); } catch (...) { return nullptr; } }
+void  operator delete  (void* memory) noexcept                          { std::free(memory); }
+void  operator delete[](void* memory) noexcept                          { std::free(memory); }
+void  operator delete  (void* memory, std::size_t) noexcept             { std::free(memory); }
+void  operator delete[](void* memory, std::size_t) noexcept             { std::free(memory); }
+
+////////////////////////////////////////////////
+// Benchmark
+////////////////////////////////////////////////
+
+namespace
+{
+  struct Options
+  {
+    std::vector<size_t>      sizes          = { 64, 65536 };
+    std::vector<std::string> modes          = { "best_effort", "reliable" };
+    std::vector<std::string> callback_modes = { "sync", "async" };
+    size_t                   messages       = 10000;
+    size_t                   warmup         = 1000;
+    double                   budget         = 16.0;
+    bool                     json           = false;
+  };
+
+  struct Result
+  {
+    std::string mode;
+    std::string callback_mode;
+    size_t      message_size          = 0;
+    size_t      messages              = 0;
+    double      in_send_per_message   = 0.0;
+    double      total_per_message     = 0.0;
+  };
+
+  // The sender waits for each message to be received before sending the next
+  struct ReceiveWaiter
+  {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    uint64_t                received = 0;
+  };
+
+  const tcp_pubsub::logger::logger_t warnings_only_logger
+        = [](const tcp_pubsub::logger::LogLevel log_level, const std::string& message)
+          {
+            if (log_level >= tcp_pubsub::logger::LogLevel::Warning)
+              std::cerr << "[TCP ps] " + message + "\n";
+          };
+
+  template <typename T>
+  std::vector<T> parseList(const std::string& list, T (*parse)(const std::string&))
+  {
+    std::vector<T>     values;
+    std::stringstream  ss(list);
+    std::string        item;
+    while (std::getline(ss, item, ','))
+    {
+      if (!item.empty())
+        values.push_back(parse(item));
+    }
+    return values;
+  }
+
+  size_t      parseSize  (const std::string& s) { return static_cast<size_t>(std::stoull(s)); }
+  std::string parseString(const std::string& s) { return s; }
+
+  bool parseOptions(int argc, char** argv, Options& options)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg   = argv[i];
+      const bool        has_value = (i + 1 < argc);
+
+      if      ((arg == "--sizes")     && has_value) options.sizes          = parseList(argv[++i], parseSize);
+      else if ((arg == "--modes")     && has_value) options.modes          = parseList(argv[++i], parseString);
+      else if ((arg == "--callbacks") && has_value) options.callback_modes = parseList(argv[++i], parseString);
+      else if ((arg == "--messages")  && has_value) options.messages       = parseSize(argv[++i]);
+      else if ((arg == "--warmup")    && has_value) options.warmup         = parseSize(argv[++i]);
+      else if ((arg == "--budget")    && has_value) options.budget         = std::stod(argv[++i]);
+      else if ((arg == "--format")    && has_value) options.json           = (std::string(argv[++i]) == "json");
+      else
+      {
+        std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Result runBenchmark(const std::string& mode, const std::string& callback_mode, size_t message_size, const Options& options)
+  {
+    Result result;
+    result.mode          = mode;
+    result.callback_mode = callback_mode;
+    result.message_size  = message_size;
+    result.messages      = options.messages;
+
+    auto executor = std::make_shared<tcp_pubsub::Executor>(2, warnings_only_logger);
+
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_ = (mode == "reliable");
+
+    tcp_pubsub::Publisher  publisher (executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+    tcp_pubsub::Subscriber subscriber(executor);
+
+    ReceiveWaiter receive_waiter;
+    subscriber.setCallback([&receive_waiter](const tcp_pubsub::CallbackData& /*callback_data*/)
+                           {
+                             std::lock_guard<std::mutex> receive_lock(receive_waiter.mutex);
+                             receive_waiter.received++;
+                             receive_waiter.cv.notify_all();
+                           }
+                           , (callback_mode == "sync"));
+    subscriber.addSession("127.0.0.1", publisher.getPort());
+
+    const auto connect_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((publisher.getSubscriberCount() < 1) && (std::chrono::steady_clock::now() < connect_deadline))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::vector<char> payload(message_size, 'x');
+
+    // Sends a message and waits until it has been received. Returns false on timeout.
+    const auto send_and_wait = [&publisher, &payload, &receive_waiter](uint64_t message_number) -> bool
+                               {
+                                 publisher.send(payload.data(), payload.size());
+
+                                 std::unique_lock<std::mutex> receive_lock(receive_waiter.mutex);
+                                 return receive_waiter.cv.wait_for(receive_lock, std::chrono::seconds(1), [&receive_waiter, message_number]() { return receive_waiter.received >= message_number; });
+                               };
+
+    uint64_t message_number = 0;
+    for (size_t i = 0; i < options.warmup; i++)
+      send_and_wait(++message_number);
+
+    // The callback may still run after notifying us, so give it a moment to return
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    uint64_t in_send_allocations = 0;
+    const uint64_t total_start   = total_allocations;
+
+    for (size_t i = 0; i < options.messages; i++)
+    {
+      const uint64_t thread_start = thread_allocations;
+      publisher.send(payload.data(), payload.size());
+      in_send_allocations += thread_allocations - thread_start;
+
+      std::unique_lock<std::mutex> receive_lock(receive_waiter.mutex);
+      message_number++;
+      if (!receive_waiter.cv.wait_for(receive_lock, std::chrono::seconds(1), [&receive_waiter, message_number]() { return receive_waiter.received >= message_number; }))
+        std::cerr << "Message " << message_number << " has not been received" << std::endl;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const uint64_t total_end = total_allocations;
+
+    subscriber.cancel();
+    publisher.cancel();
+
+    const double messages = static_cast<double>(std::max<size_t>(1, options.messages));
+    result.in_send_per_message = static_cast<double>(in_send_allocations)    / messages;
+    result.total_per_message   = static_cast<double>(total_end - total_start) / messages;
+
+    return result;
+  }
+
+  void printResult(const Result& result, double budget, bool json)
+  {
+    const bool within_budget = (result.total_per_message <= budget);
+
+    std::stringstream ss;
+    if (json)
+    {
+      ss << "{\"mode\":\""                  << result.mode          << "\""
+         << ",\"callbacks\":\""             << result.callback_mode << "\""
+         << ",\"message_size\":"            << result.message_size
+         << ",\"messages\":"                << result.messages
+         << ",\"in_send_per_message\":"     << result.in_send_per_message
+         << ",\"total_per_message\":"       << result.total_per_message
+         << ",\"budget\":"                  << budget
+         << ",\"within_budget\":"           << (within_budget ? "true" : "false")
+         << "}";
+    }
+    else
+    {
+      ss << result.mode                 << ","
+         << result.callback_mode        << ","
+         << result.message_size         << ","
+         << result.messages             << ","
+         << result.in_send_per_message  << ","
+         << result.total_per_message    << ","
+         << budget                      << ","
+         << (within_budget ? "yes" : "no");
+    }
+    std::cout << ss.str() << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+    return 1;
+
+  if (!options.json)
+    std::cout << "mode,callbacks,message_size,messages,in_send_per_message,total_per_message,budget,within_budget" << std::endl;
+
+  bool all_within_budget = true;
+
+  for (const auto& mode : options.modes)
+  {
+    for (const auto& callback_mode : options.callback_modes)
+    {
+      for (size_t message_size : options.sizes)
+      {
+        std::cerr << "Running " << mode << " callbacks=" << callback_mode << " size=" << message_size << std::endl;
+        const Result result = runBenchmark(mode, callback_mode, message_size, options);
+        printResult(result, options.budget, options.json);
+
+        all_within_budget = all_within_budget && (result.total_per_message <= options.budget);
+      }
+    }
+  }
+
+  if (!all_within_budget)
+  {
+    std::cerr << "Allocations per message exceed the budget of " << options.budget << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
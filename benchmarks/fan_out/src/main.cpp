@@ -0,0 +1,395 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// Fan-out scaling benchmark over loopback
+//
+// Connects a growing number of subscribers (by default 1 to 1000) to a single
+// publisher and sends as fast as possible for a fixed time. For each
+// subscriber count it reports:
+//
+//  - The latency of Publisher::send(), i.e. the cost of filling the buffer
+//    and of the loop that hands it to every session, also per session.
+//  - The latency of Publisher::getSubscriberCount() called concurrently from
+//    a probe thread. It only locks the session list, so it shows how long
+//    send() holds that lock.
+//  - The aggregate throughput of all subscribers and the rate of messages
+//    each subscriber has dropped (mean and worst subscriber).
+//  - The resident memory per session, once idle after connecting and once
+//    after the run, when all buffers have been allocated.
+//
+// Each subscriber is a Subscriber of its own with a synchronous callback, so
+// there is no callback thread per subscriber. The open file limit is raised
+// to allow for 2 sockets per subscriber. Results are printed to stdout as CSV
+// (default) or as one JSON object per line. Progress and errors go to stderr.
+//
+// Usage:
+//   fan_out [--subscribers 1,10,100,1000] [--sizes 1024] [--threads 1,4]
+//           [--duration-ms 1000] [--format csv|json]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+namespace
+{
+  struct Options
+  {
+    std::vector<size_t>       subscriber_counts = { 1, 10, 100, 1000 };
+    std::vector<size_t>       sizes             = { 1024 };
+    std::vector<size_t>       thread_counts     = { 1, 4 };
+    std::chrono::milliseconds duration          = std::chrono::milliseconds(1000);
+    bool                      json              = false;
+  };
+
+  struct Result
+  {
+    size_t      subscriber_count        = 0;
+    size_t      message_size            = 0;
+    size_t      thread_count            = 0;
+    size_t      connected               = 0;
+    uint64_t    messages_sent           = 0;
+    uint64_t    messages_received       = 0;           // Sum over all subscribers
+    double      seconds                 = 0.0;
+    double      send_mean_us            = 0.0;
+    double      send_p50_us             = 0.0;
+    double      send_p99_us             = 0.0;
+    double      send_max_us             = 0.0;
+    double      lock_probe_p50_us       = 0.0;
+    double      lock_probe_p99_us       = 0.0;
+    double      lock_probe_max_us       = 0.0;
+    double      drop_rate_mean          = 0.0;
+    double      drop_rate_max           = 0.0;
+    double      idle_kb_per_session     = 0.0;
+    double      loaded_kb_per_session   = 0.0;
+  };
+
+  struct ReceiveCounter
+  {
+    std::atomic<uint64_t> received { 0 };
+  };
+
+  const tcp_pubsub::logger::logger_t warnings_only_logger
+        = [](const tcp_pubsub::logger::LogLevel log_level, const std::string& message)
+          {
+            if (log_level >= tcp_pubsub::logger::LogLevel::Warning)
+              std::cerr << "[TCP ps] " + message + "\n";
+          };
+
+  template <typename T>
+  std::vector<T> parseList(const std::string& list, T (*parse)(const std::string&))
+  {
+    std::vector<T>     values;
+    std::stringstream  ss(list);
+    std::string        item;
+    while (std::getline(ss, item, ','))
+    {
+      if (!item.empty())
+        values.push_back(parse(item));
+    }
+    return values;
+  }
+
+  size_t parseSize(const std::string& s) { return static_cast<size_t>(std::stoull(s)); }
+
+  bool parseOptions(int argc, char** argv, Options& options)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg   = argv[i];
+      const bool        has_value = (i + 1 < argc);
+
+      if      ((arg == "--subscribers") && has_value) options.subscriber_counts = parseList(argv[++i], parseSize);
+      else if ((arg == "--sizes")       && has_value) options.sizes             = parseList(argv[++i], parseSize);
+      else if ((arg == "--threads")     && has_value) options.thread_counts     = parseList(argv[++i], parseSize);
+      else if ((arg == "--duration-ms") && has_value) options.duration          = std::chrono::milliseconds(std::stoll(argv[++i]));
+      else if ((arg == "--format")      && has_value) options.json              = (std::string(argv[++i]) == "json");
+      else
+      {
+        std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  double percentileUs(const std::vector<int64_t>& sorted_latencies_ns, double percentile)
+  {
+    if (sorted_latencies_ns.empty())
+      return 0.0;
+
+    const size_t index = std::min(sorted_latencies_ns.size() - 1, static_cast<size_t>(percentile * static_cast<double>(sorted_latencies_ns.size())));
+    return static_cast<double>(sorted_latencies_ns[index]) / 1000.0;
+  }
+
+  double meanUs(const std::vector<int64_t>& latencies_ns)
+  {
+    if (latencies_ns.empty())
+      return 0.0;
+
+    double sum_ns = 0.0;
+    for (const int64_t latency_ns : latencies_ns)
+      sum_ns += static_cast<double>(latency_ns);
+    return sum_ns / static_cast<double>(latencies_ns.size()) / 1000.0;
+  }
+
+  // Resident set size of this process in kilobytes
+  double residentKb()
+  {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t      size_pages     = 0;
+    uint64_t      resident_pages = 0;
+    statm >> size_pages >> resident_pages;
+    return static_cast<double>(resident_pages) * static_cast<double>(sysconf(_SC_PAGESIZE)) / 1024.0;
+  }
+
+  // Each subscriber needs a socket on both sides
+  void raiseOpenFileLimit(size_t max_subscriber_count)
+  {
+    struct rlimit limit {};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+      return;
+
+    const rlim_t required = static_cast<rlim_t>(2 * max_subscriber_count + 64);
+    if (limit.rlim_cur >= required)
+      return;
+
+    limit.rlim_cur = std::min(required, limit.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    if (limit.rlim_cur < required)
+      std::cerr << "Open file limit of " << limit.rlim_cur << " is too low for " << max_subscriber_count << " subscribers" << std::endl;
+  }
+
+  Result runBenchmark(size_t subscriber_count, size_t message_size, size_t thread_count, std::chrono::milliseconds duration)
+  {
+    Result result;
+    result.subscriber_count = subscriber_count;
+    result.message_size     = message_size;
+    result.thread_count     = thread_count;
+
+    auto executor = std::make_shared<tcp_pubsub::Executor>(thread_count, warnings_only_logger);
+
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), "127.0.0.1", 0);
+
+    const double rss_before_kb = residentKb();
+
+    std::vector<std::unique_ptr<ReceiveCounter>>         counters;
+    std::vector<std::unique_ptr<tcp_pubsub::Subscriber>> subscribers;
+    counters   .reserve(subscriber_count);
+    subscribers.reserve(subscriber_count);
+    for (size_t i = 0; i < subscriber_count; i++)
+    {
+      counters.push_back(std::make_unique<ReceiveCounter>());
+      subscribers.push_back(std::make_unique<tcp_pubsub::Subscriber>(executor));
+
+      ReceiveCounter* counter = counters.back().get();
+      subscribers.back()->setCallback([counter](const tcp_pubsub::CallbackData& /*callback_data*/)
+                                      {
+                                        counter->received++;
+                                      }
+                                      , true);
+      subscribers.back()->addSession("127.0.0.1", publisher.getPort());
+    }
+
+    // Wait for all subscribers to connect
+    const auto connect_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10 + subscriber_count / 100);
+    while ((publisher.getSubscriberCount() < subscriber_count) && (std::chrono::steady_clock::now() < connect_deadline))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    result.connected = publisher.getSubscriberCount();
+    if (result.connected < subscriber_count)
+      std::cerr << "Only " << result.connected << " of " << subscriber_count << " subscribers have connected" << std::endl;
+
+    const double rss_idle_kb = residentKb();
+
+    // The probe competes with send() for the session list lock
+    std::atomic<bool>    probe_stop { false };
+    std::vector<int64_t> lock_probe_ns;
+    std::thread probe_thread([&publisher, &probe_stop, &lock_probe_ns]()
+                             {
+                               while (!probe_stop)
+                               {
+                                 const auto probe_start = std::chrono::steady_clock::now();
+                                 publisher.getSubscriberCount();
+                                 lock_probe_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - probe_start).count());
+                                 std::this_thread::sleep_for(std::chrono::microseconds(100));
+                               }
+                             });
+
+    std::vector<char>    payload(message_size, 'x');
+    std::vector<int64_t> send_ns;
+
+    const auto start      = std::chrono::steady_clock::now();
+    const auto send_until = start + duration;
+
+    for (;;)
+    {
+      const auto send_start = std::chrono::steady_clock::now();
+      if (send_start >= send_until)
+        break;
+
+      publisher.send(payload.data(), payload.size());
+      send_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - send_start).count());
+    }
+    result.messages_sent = send_ns.size();
+
+    probe_stop = true;
+    probe_thread.join();
+
+    // Let the subscribers drain what is still in flight
+    const auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    uint64_t   last_received  = 0;
+    for (;;)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+      uint64_t received = 0;
+      for (const auto& counter : counters)
+        received += counter->received;
+
+      if ((received == last_received) || (std::chrono::steady_clock::now() > drain_deadline))
+        break;
+      last_received = received;
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double rss_loaded_kb = residentKb();
+
+    for (auto& subscriber : subscribers)
+      subscriber->cancel();
+    publisher.cancel();
+
+    // A best-effort publisher replaces the pending message of a session that
+    // is still busy, so whatever a subscriber has not received has been dropped.
+    double drop_rate_sum = 0.0;
+    for (const auto& counter : counters)
+    {
+      const uint64_t received  = counter->received;
+      const double   drop_rate = (result.messages_sent > 0 ? 1.0 - static_cast<double>(received) / static_cast<double>(result.messages_sent) : 0.0);
+
+      result.messages_received += received;
+      drop_rate_sum            += drop_rate;
+      result.drop_rate_max      = std::max(result.drop_rate_max, drop_rate);
+    }
+
+    result.seconds           = std::chrono::duration<double>(end - start).count();
+    result.drop_rate_mean    = drop_rate_sum / static_cast<double>(std::max<size_t>(1, subscriber_count));
+
+    result.send_mean_us      = meanUs(send_ns);
+    std::sort(send_ns.begin(), send_ns.end());
+    result.send_p50_us       = percentileUs(send_ns, 0.50);
+    result.send_p99_us       = percentileUs(send_ns, 0.99);
+    result.send_max_us       = (send_ns.empty() ? 0.0 : static_cast<double>(send_ns.back()) / 1000.0);
+
+    std::sort(lock_probe_ns.begin(), lock_probe_ns.end());
+    result.lock_probe_p50_us = percentileUs(lock_probe_ns, 0.50);
+    result.lock_probe_p99_us = percentileUs(lock_probe_ns, 0.99);
+    result.lock_probe_max_us = (lock_probe_ns.empty() ? 0.0 : static_cast<double>(lock_probe_ns.back()) / 1000.0);
+
+    const double sessions          = static_cast<double>(std::max<size_t>(1, result.connected));
+    result.idle_kb_per_session     = (rss_idle_kb   - rss_before_kb) / sessions;
+    result.loaded_kb_per_session   = (rss_loaded_kb - rss_before_kb) / sessions;
+
+    return result;
+  }
+
+  void printResult(const Result& result, bool json)
+  {
+    // Note that the receive time includes draining, so throughput is a lower bound
+    const double messages_per_second      = (result.seconds > 0.0 ? static_cast<double>(result.messages_received) / result.seconds : 0.0);
+    const double megabytes_per_second     = messages_per_second * static_cast<double>(result.message_size) / (1024.0 * 1024.0);
+    const double send_ns_per_session      = result.send_mean_us * 1000.0 / static_cast<double>(std::max<size_t>(1, result.connected));
+
+    std::stringstream ss;
+    if (json)
+    {
+      ss << "{\"subscribers\":"             << result.subscriber_count
+         << ",\"connected\":"               << result.connected
+         << ",\"message_size\":"            << result.message_size
+         << ",\"threads\":"                 << result.thread_count
+         << ",\"messages_sent\":"           << result.messages_sent
+         << ",\"messages_received\":"       << result.messages_received
+         << ",\"messages_per_second\":"     << messages_per_second
+         << ",\"megabytes_per_second\":"    << megabytes_per_second
+         << ",\"send_mean_us\":"            << result.send_mean_us
+         << ",\"send_p50_us\":"             << result.send_p50_us
+         << ",\"send_p99_us\":"             << result.send_p99_us
+         << ",\"send_max_us\":"             << result.send_max_us
+         << ",\"send_ns_per_session\":"     << send_ns_per_session
+         << ",\"lock_probe_p50_us\":"       << result.lock_probe_p50_us
+         << ",\"lock_probe_p99_us\":"       << result.lock_probe_p99_us
+         << ",\"lock_probe_max_us\":"       << result.lock_probe_max_us
+         << ",\"drop_rate_mean\":"          << result.drop_rate_mean
+         << ",\"drop_rate_max\":"           << result.drop_rate_max
+         << ",\"idle_kb_per_session\":"     << result.idle_kb_per_session
+         << ",\"loaded_kb_per_session\":"   << result.loaded_kb_per_session
+         << "}";
+    }
+    else
+    {
+      ss << result.subscriber_count      << ","
+         << result.connected             << ","
+         << result.message_size          << ","
+         << result.thread_count          << ","
+         << result.messages_sent         << ","
+         << result.messages_received     << ","
+         << messages_per_second          << ","
+         << megabytes_per_second         << ","
+         << result.send_mean_us          << ","
+         << result.send_p50_us           << ","
+         << result.send_p99_us           << ","
+         << result.send_max_us           << ","
+         << send_ns_per_session          << ","
+         << result.lock_probe_p50_us     << ","
+         << result.lock_probe_p99_us     << ","
+         << result.lock_probe_max_us     << ","
+         << result.drop_rate_mean        << ","
+         << result.drop_rate_max         << ","
+         << result.idle_kb_per_session   << ","
+         << result.loaded_kb_per_session;
+    }
+    std::cout << ss.str() << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+    return 1;
+
+  if (!options.subscriber_counts.empty())
+    raiseOpenFileLimit(*std::max_element(options.subscriber_counts.begin(), options.subscriber_counts.end()));
+
+  if (!options.json)
+    std::cout << "subscribers,connected,message_size,threads,messages_sent,messages_received,messages_per_second,megabytes_per_second,send_mean_us,send_p50_us,send_p99_us,send_max_us,send_ns_per_session,lock_probe_p50_us,lock_probe_p99_us,lock_probe_max_us,drop_rate_mean,drop_rate_max,idle_kb_per_session,loaded_kb_per_session" << std::endl;
+
+  for (size_t thread_count : options.thread_counts)
+  {
+    for (size_t message_size : options.sizes)
+    {
+      for (size_t subscriber_count : options.subscriber_counts)
+      {
+        std::cerr << "Running subscribers=" << subscriber_count << " size=" << message_size << " threads=" << thread_count << std::endl;
+        printResult(runBenchmark(subscriber_count, message_size, thread_count, options.duration), options.json);
+      }
+    }
+  }
+
+  return 0;
+}
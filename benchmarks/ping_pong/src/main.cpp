@@ -0,0 +1,320 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// Ping-pong round-trip latency benchmark over loopback
+//
+// A "ping" Publisher sends a message to a "pong" Subscriber, whose callback
+// immediately sends it back through a "pong" Publisher to a "ping"
+// Subscriber. Only one message is in flight at a time, so each round trip
+// measures the end-to-end latency of two messages without any queueing.
+//
+// Sweeps message size, executor threads, whether both sides share one
+// Executor or have their own, and the callback mode. The round-trip latency
+// distribution of each combination is printed to stdout as CSV (default) or
+// as one JSON object per line. Progress and errors go to stderr.
+//
+// Usage:
+//   ping_pong [--sizes 64,1024,...] [--threads 1,4] [--executors shared,separate]
+//             [--callbacks sync,async] [--round-trips 10000] [--warmup 100]
+//             [--format csv|json]
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+namespace
+{
+  struct Options
+  {
+    std::vector<size_t>      sizes;
+    std::vector<size_t>      thread_counts     = { 1, 4 };
+    std::vector<std::string> executor_modes    = { "shared", "separate" };
+    std::vector<std::string> callback_modes    = { "sync", "async" };
+    size_t                   round_trips       = 10000;
+    size_t                   warmup            = 100;
+    bool                     json              = false;
+  };
+
+  struct Result
+  {
+    std::string executor_mode;
+    std::string callback_mode;
+    size_t      message_size     = 0;
+    size_t      thread_count     = 0;
+    size_t      round_trips      = 0;
+    size_t      timeouts         = 0;
+    double      mean_us          = 0.0;
+    double      p50_us           = 0.0;
+    double      p90_us           = 0.0;
+    double      p99_us           = 0.0;
+    double      p999_us          = 0.0;
+    double      max_us           = 0.0;
+  };
+
+  // The ping side waits for the reply of the round trip it has started
+  struct ReplyWaiter
+  {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    uint64_t                last_reply = 0;
+  };
+
+  const tcp_pubsub::logger::logger_t warnings_only_logger
+        = [](const tcp_pubsub::logger::LogLevel log_level, const std::string& message)
+          {
+            if (log_level >= tcp_pubsub::logger::LogLevel::Warning)
+              std::cerr << "[TCP ps] " + message + "\n";
+          };
+
+  template <typename T>
+  std::vector<T> parseList(const std::string& list, T (*parse)(const std::string&))
+  {
+    std::vector<T>     values;
+    std::stringstream  ss(list);
+    std::string        item;
+    while (std::getline(ss, item, ','))
+    {
+      if (!item.empty())
+        values.push_back(parse(item));
+    }
+    return values;
+  }
+
+  size_t      parseSize  (const std::string& s) { return static_cast<size_t>(std::stoull(s)); }
+  std::string parseString(const std::string& s) { return s; }
+
+  bool parseOptions(int argc, char** argv, Options& options)
+  {
+    // 64 B to 4 MB in steps of 4
+    for (size_t size = 64; size <= 4 * 1024 * 1024; size *= 4)
+      options.sizes.push_back(size);
+
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg   = argv[i];
+      const bool        has_value = (i + 1 < argc);
+
+      if      ((arg == "--sizes")       && has_value) options.sizes          = parseList(argv[++i], parseSize);
+      else if ((arg == "--threads")     && has_value) options.thread_counts  = parseList(argv[++i], parseSize);
+      else if ((arg == "--executors")   && has_value) options.executor_modes = parseList(argv[++i], parseString);
+      else if ((arg == "--callbacks")   && has_value) options.callback_modes = parseList(argv[++i], parseString);
+      else if ((arg == "--round-trips") && has_value) options.round_trips    = parseSize(argv[++i]);
+      else if ((arg == "--warmup")      && has_value) options.warmup         = parseSize(argv[++i]);
+      else if ((arg == "--format")      && has_value) options.json           = (std::string(argv[++i]) == "json");
+      else
+      {
+        std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+        return false;
+      }
+    }
+
+    for (const auto& executor_mode : options.executor_modes)
+    {
+      if ((executor_mode != "shared") && (executor_mode != "separate"))
+      {
+        std::cerr << "Unknown executor mode: " << executor_mode << std::endl;
+        return false;
+      }
+    }
+
+    for (const auto& callback_mode : options.callback_modes)
+    {
+      if ((callback_mode != "sync") && (callback_mode != "async"))
+      {
+        std::cerr << "Unknown callback mode: " << callback_mode << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  double percentileUs(const std::vector<int64_t>& sorted_latencies_ns, double percentile)
+  {
+    if (sorted_latencies_ns.empty())
+      return 0.0;
+
+    const size_t index = std::min(sorted_latencies_ns.size() - 1, static_cast<size_t>(percentile * static_cast<double>(sorted_latencies_ns.size())));
+    return static_cast<double>(sorted_latencies_ns[index]) / 1000.0;
+  }
+
+  bool waitForSubscriber(const tcp_pubsub::Publisher& publisher)
+  {
+    const auto connect_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((publisher.getSubscriberCount() < 1) && (std::chrono::steady_clock::now() < connect_deadline))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return (publisher.getSubscriberCount() >= 1);
+  }
+
+  Result runBenchmark(const std::string& executor_mode, const std::string& callback_mode, size_t message_size, size_t thread_count, const Options& options)
+  {
+    Result result;
+    result.executor_mode    = executor_mode;
+    result.callback_mode    = callback_mode;
+    result.message_size     = message_size;
+    result.thread_count     = thread_count;
+
+    auto ping_executor = std::make_shared<tcp_pubsub::Executor>(thread_count, warnings_only_logger);
+    auto pong_executor = (executor_mode == "shared" ? ping_executor : std::make_shared<tcp_pubsub::Executor>(thread_count, warnings_only_logger));
+
+    const bool synchronous_callbacks = (callback_mode == "sync");
+
+    tcp_pubsub::Publisher  ping_publisher (ping_executor, tcp_pubsub::PublisherTransientLocalSetting(), "127.0.0.1", 0);
+    tcp_pubsub::Publisher  pong_publisher (pong_executor, tcp_pubsub::PublisherTransientLocalSetting(), "127.0.0.1", 0);
+    tcp_pubsub::Subscriber pong_subscriber(pong_executor);
+    tcp_pubsub::Subscriber ping_subscriber(ping_executor);
+
+    // The pong side sends each message straight back
+    pong_subscriber.setCallback([&pong_publisher](const tcp_pubsub::CallbackData& callback_data)
+                                {
+                                  pong_publisher.send(callback_data.buffer_->data(), callback_data.buffer_->size());
+                                }
+                                , synchronous_callbacks);
+
+    ReplyWaiter reply_waiter;
+    ping_subscriber.setCallback([&reply_waiter](const tcp_pubsub::CallbackData& callback_data)
+                                {
+                                  uint64_t round_trip = 0;
+                                  std::memcpy(&round_trip, callback_data.buffer_->data(), sizeof(round_trip));
+
+                                  std::lock_guard<std::mutex> reply_lock(reply_waiter.mutex);
+                                  reply_waiter.last_reply = round_trip;
+                                  reply_waiter.cv.notify_all();
+                                }
+                                , synchronous_callbacks);
+
+    pong_subscriber.addSession("127.0.0.1", ping_publisher.getPort());
+    ping_subscriber.addSession("127.0.0.1", pong_publisher.getPort());
+
+    if (!waitForSubscriber(ping_publisher) || !waitForSubscriber(pong_publisher))
+      std::cerr << "Subscribers have not connected" << std::endl;
+
+    std::vector<char>    payload(std::max(message_size, sizeof(uint64_t)), 'x');
+    std::vector<int64_t> latencies_ns;
+    latencies_ns.reserve(options.round_trips);
+
+    // Round trips are numbered from 1, so a late reply of a timed out round
+    // trip is not mistaken for the reply of the current one
+    const uint64_t total_round_trips = options.warmup + options.round_trips;
+    for (uint64_t round_trip = 1; round_trip <= total_round_trips; round_trip++)
+    {
+      std::memcpy(payload.data(), &round_trip, sizeof(round_trip));
+
+      const auto start = std::chrono::steady_clock::now();
+      ping_publisher.send(payload.data(), payload.size());
+
+      bool replied = false;
+      {
+        std::unique_lock<std::mutex> reply_lock(reply_waiter.mutex);
+        replied = reply_waiter.cv.wait_for(reply_lock, std::chrono::seconds(1), [&reply_waiter, round_trip]() { return reply_waiter.last_reply == round_trip; });
+      }
+      const auto end = std::chrono::steady_clock::now();
+
+      if (round_trip <= options.warmup)
+        continue;
+
+      if (replied)
+        latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+      else
+        result.timeouts++;
+    }
+
+    // Cancelling joins the callback threads, so they don't use the publishers any more
+    ping_subscriber.cancel();
+    pong_subscriber.cancel();
+    ping_publisher.cancel();
+    pong_publisher.cancel();
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+
+    int64_t sum_ns = 0;
+    for (const int64_t latency_ns : latencies_ns)
+      sum_ns += latency_ns;
+
+    result.round_trips = latencies_ns.size();
+    result.mean_us     = (latencies_ns.empty() ? 0.0 : static_cast<double>(sum_ns) / static_cast<double>(latencies_ns.size()) / 1000.0);
+    result.p50_us      = percentileUs(latencies_ns, 0.50);
+    result.p90_us      = percentileUs(latencies_ns, 0.90);
+    result.p99_us      = percentileUs(latencies_ns, 0.99);
+    result.p999_us     = percentileUs(latencies_ns, 0.999);
+    result.max_us      = (latencies_ns.empty() ? 0.0 : static_cast<double>(latencies_ns.back()) / 1000.0);
+
+    return result;
+  }
+
+  void printResult(const Result& result, bool json)
+  {
+    std::stringstream ss;
+    if (json)
+    {
+      ss << "{\"executors\":\""        << result.executor_mode << "\""
+         << ",\"callbacks\":\""        << result.callback_mode << "\""
+         << ",\"message_size\":"       << result.message_size
+         << ",\"threads\":"            << result.thread_count
+         << ",\"round_trips\":"        << result.round_trips
+         << ",\"timeouts\":"           << result.timeouts
+         << ",\"mean_us\":"            << result.mean_us
+         << ",\"p50_us\":"             << result.p50_us
+         << ",\"p90_us\":"             << result.p90_us
+         << ",\"p99_us\":"             << result.p99_us
+         << ",\"p999_us\":"            << result.p999_us
+         << ",\"max_us\":"             << result.max_us
+         << "}";
+    }
+    else
+    {
+      ss << result.executor_mode  << ","
+         << result.callback_mode  << ","
+         << result.message_size   << ","
+         << result.thread_count   << ","
+         << result.round_trips    << ","
+         << result.timeouts       << ","
+         << result.mean_us        << ","
+         << result.p50_us         << ","
+         << result.p90_us         << ","
+         << result.p99_us         << ","
+         << result.p999_us        << ","
+         << result.max_us;
+    }
+    std::cout << ss.str() << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+    return 1;
+
+  if (!options.json)
+    std::cout << "executors,callbacks,message_size,threads,round_trips,timeouts,mean_us,p50_us,p90_us,p99_us,p999_us,max_us" << std::endl;
+
+  for (const auto& executor_mode : options.executor_modes)
+  {
+    for (const auto& callback_mode : options.callback_modes)
+    {
+      for (size_t thread_count : options.thread_counts)
+      {
+        for (size_t message_size : options.sizes)
+        {
+          std::cerr << "Running executors=" << executor_mode << " callbacks=" << callback_mode << " size=" << message_size << " threads=" << thread_count << std::endl;
+          printResult(runBenchmark(executor_mode, callback_mode, message_size, thread_count, options), options.json);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,285 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "impairment_proxy.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+////////////////////////////////////////////////
+// Link
+////////////////////////////////////////////////
+
+// A client connection and the connection to the target. If either direction
+// fails, both sockets are closed.
+class ImpairmentProxy::Link
+{
+public:
+  explicit Link(asio::io_context& io_context)
+    : client_socket_(io_context)
+    , target_socket_(io_context)
+  {}
+
+  void close()
+  {
+    asio::error_code ec;
+    client_socket_.close(ec);
+    target_socket_.close(ec);
+  }
+
+  asio::ip::tcp::socket client_socket_;
+  asio::ip::tcp::socket target_socket_;
+};
+
+////////////////////////////////////////////////
+// Pipe
+////////////////////////////////////////////////
+
+// Forwards one direction of a link. Everything runs on the proxy's single io
+// thread, so no locking is needed.
+class ImpairmentProxy::Pipe : public std::enable_shared_from_this<ImpairmentProxy::Pipe>
+{
+private:
+  struct Chunk
+  {
+    std::vector<char>                     data_;
+    size_t                                position_;
+    std::chrono::steady_clock::time_point due_;
+  };
+
+  static constexpr size_t read_size_     = 64 * 1024;
+  static constexpr size_t max_write_size_ = 16 * 1024;  // Small writes keep the rate limit smooth
+
+public:
+  Pipe(const std::shared_ptr<Link>& link, asio::ip::tcp::socket& source, asio::ip::tcp::socket& destination, const ImpairmentSetting& setting, bool limited, std::chrono::steady_clock::time_point start_time, const std::shared_ptr<std::atomic<uint64_t>>& forwarded_bytes)
+    : link_           (link)
+    , source_         (source)
+    , destination_    (destination)
+    , setting_        (setting)
+    , limited_        (limited)
+    , start_time_     (start_time)
+    , forwarded_bytes_(forwarded_bytes)
+    , timer_          (source.get_executor())
+    , random_engine_  (std::random_device()())
+    , read_buffer_    (read_size_)
+    , buffered_bytes_ (0)
+    , reading_paused_ (false)
+    , writing_        (false)
+    , source_closed_  (false)
+  {}
+
+  void start()
+  {
+    readNext();
+  }
+
+private:
+  void readNext()
+  {
+    if (buffered_bytes_ >= setting_.link_buffer_bytes_)
+    {
+      // The link is full. Not reading lets TCP push back to the sender.
+      reading_paused_ = true;
+      return;
+    }
+
+    source_.async_read_some(asio::buffer(read_buffer_)
+                          , [me = shared_from_this()](asio::error_code ec, std::size_t length)
+                            {
+                              if (ec)
+                              {
+                                // Forward what is still on the link, then close
+                                me->source_closed_ = true;
+                                if (!me->writing_)
+                                  me->writeNext();
+                                return;
+                              }
+
+                              me->enqueue(length);
+                              if (!me->writing_)
+                                me->writeNext();
+                              me->readNext();
+                            });
+  }
+
+  void enqueue(size_t length)
+  {
+    auto due = std::chrono::steady_clock::now() + setting_.delay_;
+    if (setting_.jitter_.count() > 0)
+    {
+      std::uniform_int_distribution<int64_t> jitter_distribution(0, setting_.jitter_.count());
+      due += std::chrono::microseconds(jitter_distribution(random_engine_));
+    }
+
+    // Data on a TCP connection is never reordered
+    if (!chunks_.empty())
+      due = std::max(due, chunks_.back().due_);
+
+    chunks_.push_back(Chunk{ std::vector<char>(read_buffer_.begin(), read_buffer_.begin() + length), 0, due });
+    buffered_bytes_ += length;
+  }
+
+  void writeNext()
+  {
+    if (chunks_.empty())
+    {
+      writing_ = false;
+      if (source_closed_)
+        link_->close();
+      return;
+    }
+
+    writing_ = true;
+
+    const auto now      = std::chrono::steady_clock::now();
+    auto       earliest = chunks_.front().due_;
+
+    if (limited_)
+    {
+      earliest = std::max(earliest, next_rate_time_);
+
+      if ((setting_.stall_interval_.count() > 0) && (setting_.stall_duration_.count() > 0))
+      {
+        const auto phase = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_time_) % std::chrono::duration_cast<std::chrono::nanoseconds>(setting_.stall_interval_);
+        if (phase < setting_.stall_duration_)
+          earliest = std::max(earliest, now + (setting_.stall_duration_ - phase));
+      }
+    }
+
+    if (earliest > now)
+    {
+      timer_.expires_at(earliest);
+      timer_.async_wait([me = shared_from_this()](asio::error_code ec)
+                        {
+                          if (ec)
+                            return;
+                          me->writeNext();
+                        });
+      return;
+    }
+
+    Chunk&       chunk = chunks_.front();
+    const size_t size  = std::min(chunk.data_.size() - chunk.position_, max_write_size_);
+
+    asio::async_write(destination_
+                    , asio::buffer(chunk.data_.data() + chunk.position_, size)
+                    , [me = shared_from_this(), size](asio::error_code ec, std::size_t /*length*/)
+                      {
+                        if (ec)
+                        {
+                          me->link_->close();
+                          return;
+                        }
+                        me->written(size);
+                      });
+  }
+
+  void written(size_t size)
+  {
+    if (limited_ && (setting_.rate_bytes_per_second_ > 0))
+    {
+      const auto transmission_time = std::chrono::nanoseconds(static_cast<int64_t>(size * 1000000000ull / setting_.rate_bytes_per_second_));
+      next_rate_time_ = std::max(next_rate_time_, std::chrono::steady_clock::now()) + transmission_time;
+    }
+
+    if (limited_)
+      forwarded_bytes_->fetch_add(size, std::memory_order_relaxed);
+
+    Chunk& chunk = chunks_.front();
+    chunk.position_ += size;
+    if (chunk.position_ >= chunk.data_.size())
+      chunks_.pop_front();
+    buffered_bytes_ -= size;
+
+    if (reading_paused_ && !source_closed_ && (buffered_bytes_ < setting_.link_buffer_bytes_))
+    {
+      reading_paused_ = false;
+      readNext();
+    }
+
+    writeNext();
+  }
+
+private:
+  const std::shared_ptr<Link>                  link_;
+  asio::ip::tcp::socket&                       source_;
+  asio::ip::tcp::socket&                       destination_;
+  const ImpairmentSetting                      setting_;
+  const bool                                   limited_;           /// Whether rate limit and stalls apply to this direction
+  const std::chrono::steady_clock::time_point  start_time_;
+  const std::shared_ptr<std::atomic<uint64_t>> forwarded_bytes_;
+
+  asio::steady_timer                           timer_;
+  std::mt19937_64                              random_engine_;
+  std::vector<char>                            read_buffer_;
+  std::deque<Chunk>                            chunks_;
+  uint64_t                                     buffered_bytes_;
+  std::chrono::steady_clock::time_point        next_rate_time_;
+  bool                                         reading_paused_;
+  bool                                         writing_;
+  bool                                         source_closed_;
+};
+
+////////////////////////////////////////////////
+// ImpairmentProxy
+////////////////////////////////////////////////
+
+ImpairmentProxy::ImpairmentProxy(const std::string& target_address, uint16_t target_port, const ImpairmentSetting& setting)
+  : target_endpoint_(asio::ip::make_address(target_address), target_port)
+  , setting_        (setting)
+  , start_time_     (std::chrono::steady_clock::now())
+  , acceptor_       (io_context_, asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0))
+  , forwarded_bytes_(std::make_shared<std::atomic<uint64_t>>(0))
+{
+  acceptClient();
+  thread_ = std::thread([this]() { io_context_.run(); });
+}
+
+ImpairmentProxy::~ImpairmentProxy()
+{
+  io_context_.stop();
+  thread_.join();
+}
+
+uint16_t ImpairmentProxy::getPort() const
+{
+  return acceptor_.local_endpoint().port();
+}
+
+uint64_t ImpairmentProxy::getForwardedBytes() const
+{
+  return forwarded_bytes_->load(std::memory_order_relaxed);
+}
+
+void ImpairmentProxy::acceptClient()
+{
+  auto link = std::make_shared<Link>(io_context_);
+
+  acceptor_.async_accept(link->client_socket_
+                        , [this, link](asio::error_code ec)
+                          {
+                            if (ec)
+                              return;
+
+                            link->target_socket_.async_connect(target_endpoint_
+                                                              , [this, link](asio::error_code connect_ec)
+                                                                {
+                                                                  if (connect_ec)
+                                                                  {
+                                                                    link->close();
+                                                                    return;
+                                                                  }
+
+                                                                  asio::error_code nodelay_ec;
+                                                                  link->client_socket_.set_option(asio::ip::tcp::no_delay(true), nodelay_ec);
+                                                                  link->target_socket_.set_option(asio::ip::tcp::no_delay(true), nodelay_ec);
+
+                                                                  std::make_shared<Pipe>(link, link->target_socket_, link->client_socket_, setting_, true,  start_time_, forwarded_bytes_)->start();
+                                                                  std::make_shared<Pipe>(link, link->client_socket_, link->target_socket_, setting_, false, start_time_, forwarded_bytes_)->start();
+                                                                });
+
+                            acceptClient();
+                          });
+}
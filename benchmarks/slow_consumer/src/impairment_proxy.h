@@ -0,0 +1,72 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <asio.hpp>
+
+struct ImpairmentSetting
+{
+  uint64_t                  rate_bytes_per_second_ = 0;                               /// Bandwidth from the publisher to the subscriber. 0 means unlimited.
+  std::chrono::microseconds delay_                 = std::chrono::microseconds(0);    /// One-way delay, applied in both directions
+  std::chrono::microseconds jitter_                = std::chrono::microseconds(0);    /// Maximum additional random delay. Data is never reordered.
+  std::chrono::milliseconds stall_interval_        = std::chrono::milliseconds(0);    /// Time between the starts of two stalls. 0 means no stalls.
+  std::chrono::milliseconds stall_duration_        = std::chrono::milliseconds(0);    /// Time the link does not forward any data from the publisher to the subscriber
+  uint64_t                  link_buffer_bytes_     = 4 * 1024 * 1024;                 /// Data in flight on the link. If exceeded, the proxy stops reading, so TCP pushes back to the sender.
+};
+
+/**
+ * @brief TCP forwarder that simulates a slow or unreliable network link on localhost
+ *
+ * The proxy listens on a local port. For each connection it opens a
+ * connection to the target (e.g. a Publisher) and forwards all data in both
+ * directions. Data from the target to the client (e.g. a Subscriber) is
+ * limited in rate and stalled periodically. Both directions are delayed.
+ *
+ * The proxy runs its own io thread, which is stopped by the destructor.
+ */
+class ImpairmentProxy
+{
+public:
+  ImpairmentProxy(const std::string& target_address, uint16_t target_port, const ImpairmentSetting& setting);
+  ~ImpairmentProxy();
+
+  // Copy
+  ImpairmentProxy(const ImpairmentProxy&)            = delete;
+  ImpairmentProxy& operator=(const ImpairmentProxy&) = delete;
+
+  // Move
+  ImpairmentProxy& operator=(ImpairmentProxy&&)      = delete;
+  ImpairmentProxy(ImpairmentProxy&&)                 = delete;
+
+public:
+  // Port the proxy listens on (on 127.0.0.1)
+  uint16_t getPort() const;
+
+  // Bytes forwarded from the target to the clients
+  uint64_t getForwardedBytes() const;
+
+private:
+  class Link;
+  class Pipe;
+
+  void acceptClient();
+
+private:
+  const asio::ip::tcp::endpoint         target_endpoint_;
+  const ImpairmentSetting               setting_;
+  const std::chrono::steady_clock::time_point start_time_;        /// Stalls are aligned to this time
+
+  asio::io_context                      io_context_;
+  asio::ip::tcp::acceptor               acceptor_;
+  std::shared_ptr<std::atomic<uint64_t>> forwarded_bytes_;
+  std::thread                           thread_;
+};
@@ -0,0 +1,439 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// Slow consumer benchmark on localhost
+//
+// A publisher sends at a fixed rate to two subscribers: a fast one that is
+// connected directly and a slow one. The slow subscriber is either connected
+// through an ImpairmentProxy that simulates a slow or unreliable link, or it
+// is throttled by an expensive callback. For each profile and send mode the
+// benchmark reports how long send() takes, what both subscribers have
+// received and dropped and the latency of the slow subscriber. This shows
+// whether the queueing and drop policies of the publisher keep the fast
+// subscriber unaffected by the slow one.
+//
+// Profiles:
+//   direct         No impairment (reference)
+//   lan            Proxy without impairment
+//   wan            10 MB/s, 20 ms delay, 5 ms jitter
+//   narrow         1 MB/s
+//   stalls         The link stalls for 200 ms every second
+//   slow_callback  Direct connection, but each callback takes 1 ms
+//   custom         Set by --rate-bytes, --delay-us, --jitter-us,
+//                  --stall-interval-ms, --stall-duration-ms, --callback-us
+//
+// Results are printed to stdout as CSV (default) or as one JSON object per
+// line. Progress and errors go to stderr.
+//
+// Usage:
+//   slow_consumer [--profiles direct,lan,...] [--modes best_effort,reliable]
+//                 [--callbacks async,sync] [--size 1024] [--rate-hz 2000]
+//                 [--duration-ms 3000] [--eviction-ms 0] [--format csv|json]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "impairment_proxy.h"
+
+namespace
+{
+  struct Profile
+  {
+    std::string               name;
+    bool                      use_proxy     = false;
+    ImpairmentSetting         impairment;
+    std::chrono::microseconds callback_cost = std::chrono::microseconds(0);
+  };
+
+  struct Options
+  {
+    std::vector<std::string>  profiles       = { "direct", "lan", "wan", "narrow", "stalls", "slow_callback" };
+    std::vector<std::string>  modes          = { "best_effort", "reliable" };
+    std::vector<std::string>  callback_modes = { "async" };
+    size_t                    size           = 1024;
+    double                    rate_hz        = 2000.0;
+    std::chrono::milliseconds duration       = std::chrono::milliseconds(3000);
+    std::chrono::milliseconds eviction       = std::chrono::milliseconds(0);
+    Profile                   custom;
+    bool                      json           = false;
+  };
+
+  struct Result
+  {
+    std::string profile;
+    std::string mode;
+    std::string callback_mode;
+    uint64_t    sent              = 0;
+    double      send_p99_us       = 0.0;
+    double      send_max_us       = 0.0;
+    uint64_t    fast_received     = 0;
+    uint64_t    slow_received     = 0;
+    double      slow_p50_ms       = 0.0;
+    double      slow_p99_ms       = 0.0;
+    double      slow_max_ms       = 0.0;
+    double      forwarded_mb      = 0.0;
+  };
+
+  // Records the latency of each message. The callback of a subscriber is never
+  // executed concurrently, so the mutex is only needed for reading the results.
+  struct Receiver
+  {
+    std::mutex            mutex;
+    std::vector<int64_t>  latencies_ns;
+    std::atomic<uint64_t> received { 0 };
+  };
+
+  const tcp_pubsub::logger::logger_t warnings_only_logger
+        = [](const tcp_pubsub::logger::LogLevel log_level, const std::string& message)
+          {
+            if (log_level >= tcp_pubsub::logger::LogLevel::Warning)
+              std::cerr << "[TCP ps] " + message + "\n";
+          };
+
+  int64_t steadyNowNs()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  template <typename T>
+  std::vector<T> parseList(const std::string& list, T (*parse)(const std::string&))
+  {
+    std::vector<T>     values;
+    std::stringstream  ss(list);
+    std::string        item;
+    while (std::getline(ss, item, ','))
+    {
+      if (!item.empty())
+        values.push_back(parse(item));
+    }
+    return values;
+  }
+
+  std::string parseString(const std::string& s) { return s; }
+
+  bool makeProfile(const std::string& name, const Options& options, Profile& profile)
+  {
+    profile      = Profile();
+    profile.name = name;
+
+    if (name == "direct")
+    {
+    }
+    else if (name == "lan")
+    {
+      profile.use_proxy = true;
+    }
+    else if (name == "wan")
+    {
+      profile.use_proxy                         = true;
+      profile.impairment.rate_bytes_per_second_ = 10 * 1024 * 1024;
+      profile.impairment.delay_                 = std::chrono::milliseconds(20);
+      profile.impairment.jitter_                = std::chrono::milliseconds(5);
+    }
+    else if (name == "narrow")
+    {
+      profile.use_proxy                         = true;
+      profile.impairment.rate_bytes_per_second_ = 1024 * 1024;
+    }
+    else if (name == "stalls")
+    {
+      profile.use_proxy                         = true;
+      profile.impairment.stall_interval_        = std::chrono::milliseconds(1000);
+      profile.impairment.stall_duration_        = std::chrono::milliseconds(200);
+    }
+    else if (name == "slow_callback")
+    {
+      profile.callback_cost                     = std::chrono::milliseconds(1);
+    }
+    else if (name == "custom")
+    {
+      profile      = options.custom;
+      profile.name = name;
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+
+  bool parseOptions(int argc, char** argv, Options& options)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg   = argv[i];
+      const bool        has_value = (i + 1 < argc);
+
+      if      ((arg == "--profiles")          && has_value) options.profiles                                  = parseList(argv[++i], parseString);
+      else if ((arg == "--modes")             && has_value) options.modes                                     = parseList(argv[++i], parseString);
+      else if ((arg == "--callbacks")         && has_value) options.callback_modes                            = parseList(argv[++i], parseString);
+      else if ((arg == "--size")              && has_value) options.size                                      = static_cast<size_t>(std::stoull(argv[++i]));
+      else if ((arg == "--rate-hz")           && has_value) options.rate_hz                                   = std::stod(argv[++i]);
+      else if ((arg == "--duration-ms")       && has_value) options.duration                                  = std::chrono::milliseconds(std::stoll(argv[++i]));
+      else if ((arg == "--eviction-ms")       && has_value) options.eviction                                  = std::chrono::milliseconds(std::stoll(argv[++i]));
+      else if ((arg == "--rate-bytes")        && has_value) options.custom.impairment.rate_bytes_per_second_  = std::stoull(argv[++i]);
+      else if ((arg == "--delay-us")          && has_value) options.custom.impairment.delay_                  = std::chrono::microseconds(std::stoll(argv[++i]));
+      else if ((arg == "--jitter-us")         && has_value) options.custom.impairment.jitter_                 = std::chrono::microseconds(std::stoll(argv[++i]));
+      else if ((arg == "--stall-interval-ms") && has_value) options.custom.impairment.stall_interval_         = std::chrono::milliseconds(std::stoll(argv[++i]));
+      else if ((arg == "--stall-duration-ms") && has_value) options.custom.impairment.stall_duration_         = std::chrono::milliseconds(std::stoll(argv[++i]));
+      else if ((arg == "--callback-us")       && has_value) options.custom.callback_cost                      = std::chrono::microseconds(std::stoll(argv[++i]));
+      else if ((arg == "--format")            && has_value) options.json                                      = (std::string(argv[++i]) == "json");
+      else
+      {
+        std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+        return false;
+      }
+    }
+
+    // The custom profile always uses the proxy, unless only the callback is throttled
+    const ImpairmentSetting no_impairment;
+    options.custom.use_proxy = (options.custom.impairment.rate_bytes_per_second_ != no_impairment.rate_bytes_per_second_)
+                            || (options.custom.impairment.delay_                 != no_impairment.delay_)
+                            || (options.custom.impairment.jitter_                != no_impairment.jitter_)
+                            || (options.custom.impairment.stall_interval_        != no_impairment.stall_interval_);
+
+    Profile profile;
+    for (const auto& profile_name : options.profiles)
+    {
+      if (!makeProfile(profile_name, options, profile))
+      {
+        std::cerr << "Unknown profile: " << profile_name << std::endl;
+        return false;
+      }
+    }
+    for (const auto& mode : options.modes)
+    {
+      if ((mode != "best_effort") && (mode != "reliable"))
+      {
+        std::cerr << "Unknown mode: " << mode << std::endl;
+        return false;
+      }
+    }
+    for (const auto& callback_mode : options.callback_modes)
+    {
+      if ((callback_mode != "sync") && (callback_mode != "async"))
+      {
+        std::cerr << "Unknown callback mode: " << callback_mode << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  double percentile(const std::vector<int64_t>& sorted_values, double percentile)
+  {
+    if (sorted_values.empty())
+      return 0.0;
+
+    const size_t index = std::min(sorted_values.size() - 1, static_cast<size_t>(percentile * static_cast<double>(sorted_values.size())));
+    return static_cast<double>(sorted_values[index]);
+  }
+
+  void setLatencyCallback(tcp_pubsub::Subscriber& subscriber, Receiver& receiver, std::chrono::microseconds callback_cost, bool synchronous)
+  {
+    subscriber.setCallback([&receiver, callback_cost](const tcp_pubsub::CallbackData& callback_data)
+                           {
+                             const int64_t receive_time_ns = steadyNowNs();
+                             int64_t       send_time_ns    = 0;
+                             std::memcpy(&send_time_ns, callback_data.buffer_->data(), sizeof(send_time_ns));
+
+                             {
+                               std::lock_guard<std::mutex> receiver_lock(receiver.mutex);
+                               receiver.latencies_ns.push_back(receive_time_ns - send_time_ns);
+                             }
+                             receiver.received++;
+
+                             // Throttled subscriber
+                             if (callback_cost.count() > 0)
+                               std::this_thread::sleep_for(callback_cost);
+                           }
+                           , synchronous);
+  }
+
+  Result runBenchmark(const Profile& profile, const std::string& mode, const std::string& callback_mode, const Options& options)
+  {
+    Result result;
+    result.profile       = profile.name;
+    result.mode          = mode;
+    result.callback_mode = callback_mode;
+
+    auto executor = std::make_shared<tcp_pubsub::Executor>(4, warnings_only_logger);
+
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_          = (mode == "reliable");
+    reliable_setting.eviction_timeout_ = std::chrono::duration_cast<std::chrono::nanoseconds>(options.eviction).count();
+
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+
+    std::unique_ptr<ImpairmentProxy> proxy;
+    if (profile.use_proxy)
+      proxy = std::make_unique<ImpairmentProxy>("127.0.0.1", publisher.getPort(), profile.impairment);
+
+    Receiver               fast_receiver;
+    Receiver               slow_receiver;
+    tcp_pubsub::Subscriber fast_subscriber(executor);
+    tcp_pubsub::Subscriber slow_subscriber(executor);
+
+    setLatencyCallback(fast_subscriber, fast_receiver, std::chrono::microseconds(0), false);
+    setLatencyCallback(slow_subscriber, slow_receiver, profile.callback_cost, (callback_mode == "sync"));
+
+    fast_subscriber.addSession("127.0.0.1", publisher.getPort());
+    slow_subscriber.addSession("127.0.0.1", (proxy ? proxy->getPort() : publisher.getPort()));
+
+    const auto connect_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((publisher.getSubscriberCount() < 2) && (std::chrono::steady_clock::now() < connect_deadline))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    if (publisher.getSubscriberCount() < 2)
+      std::cerr << "Only " << publisher.getSubscriberCount() << " of 2 subscribers have connected" << std::endl;
+
+    // Give the slow subscriber time to receive the handshake over the delayed link
+    std::this_thread::sleep_for(std::chrono::milliseconds(100) + 2 * std::chrono::duration_cast<std::chrono::milliseconds>(profile.impairment.delay_ + profile.impairment.jitter_));
+
+    std::vector<char>    payload(std::max(options.size, sizeof(int64_t)), 'x');
+    std::vector<int64_t> send_ns;
+
+    const auto period     = std::chrono::nanoseconds(static_cast<int64_t>(1e9 / std::max(options.rate_hz, 1.0)));
+    const auto start      = std::chrono::steady_clock::now();
+    const auto send_until = start + options.duration;
+    auto       next_send  = start;
+
+    while (next_send < send_until)
+    {
+      std::this_thread::sleep_until(next_send);
+
+      const int64_t send_time_ns = steadyNowNs();
+      std::memcpy(payload.data(), &send_time_ns, sizeof(send_time_ns));
+      publisher.send(payload.data(), payload.size());
+      send_ns.push_back(steadyNowNs() - send_time_ns);
+
+      // If send() has blocked, we don't try to catch up
+      next_send = std::max(next_send + period, std::chrono::steady_clock::now());
+    }
+    result.sent = send_ns.size();
+
+    // Let the subscribers drain what is still on the link
+    const auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    uint64_t   last_received  = 0;
+    for (;;)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300) + 2 * std::chrono::duration_cast<std::chrono::milliseconds>(profile.impairment.delay_ + profile.impairment.jitter_ + profile.impairment.stall_duration_));
+
+      const uint64_t received = fast_receiver.received + slow_receiver.received;
+      if ((received == last_received) || (std::chrono::steady_clock::now() > drain_deadline))
+        break;
+      last_received = received;
+    }
+
+    // Cancelling joins the callback threads, so we can safely read the receivers afterwards
+    fast_subscriber.cancel();
+    slow_subscriber.cancel();
+    publisher.cancel();
+
+    result.fast_received = fast_receiver.received;
+    result.slow_received = slow_receiver.received;
+    result.forwarded_mb  = (proxy ? static_cast<double>(proxy->getForwardedBytes()) / (1024.0 * 1024.0) : 0.0);
+
+    std::sort(send_ns.begin(), send_ns.end());
+    result.send_p99_us = percentile(send_ns, 0.99) / 1000.0;
+    result.send_max_us = (send_ns.empty() ? 0.0 : static_cast<double>(send_ns.back()) / 1000.0);
+
+    std::vector<int64_t> slow_latencies_ns;
+    {
+      std::lock_guard<std::mutex> receiver_lock(slow_receiver.mutex);
+      slow_latencies_ns = slow_receiver.latencies_ns;
+    }
+    std::sort(slow_latencies_ns.begin(), slow_latencies_ns.end());
+    result.slow_p50_ms = percentile(slow_latencies_ns, 0.50)  / 1e6;
+    result.slow_p99_ms = percentile(slow_latencies_ns, 0.99)  / 1e6;
+    result.slow_max_ms = (slow_latencies_ns.empty() ? 0.0 : static_cast<double>(slow_latencies_ns.back()) / 1e6);
+
+    return result;
+  }
+
+  void printResult(const Result& result, bool json)
+  {
+    const double sent           = static_cast<double>(std::max<uint64_t>(1, result.sent));
+    const double fast_drop_rate = 1.0 - static_cast<double>(result.fast_received) / sent;
+    const double slow_drop_rate = 1.0 - static_cast<double>(result.slow_received) / sent;
+
+    std::stringstream ss;
+    if (json)
+    {
+      ss << "{\"profile\":\""         << result.profile       << "\""
+         << ",\"mode\":\""            << result.mode          << "\""
+         << ",\"callbacks\":\""       << result.callback_mode << "\""
+         << ",\"sent\":"              << result.sent
+         << ",\"send_p99_us\":"       << result.send_p99_us
+         << ",\"send_max_us\":"       << result.send_max_us
+         << ",\"fast_received\":"     << result.fast_received
+         << ",\"fast_drop_rate\":"    << fast_drop_rate
+         << ",\"slow_received\":"     << result.slow_received
+         << ",\"slow_drop_rate\":"    << slow_drop_rate
+         << ",\"slow_p50_ms\":"       << result.slow_p50_ms
+         << ",\"slow_p99_ms\":"       << result.slow_p99_ms
+         << ",\"slow_max_ms\":"       << result.slow_max_ms
+         << ",\"forwarded_mb\":"      << result.forwarded_mb
+         << "}";
+    }
+    else
+    {
+      ss << result.profile        << ","
+         << result.mode           << ","
+         << result.callback_mode  << ","
+         << result.sent           << ","
+         << result.send_p99_us    << ","
+         << result.send_max_us    << ","
+         << result.fast_received  << ","
+         << fast_drop_rate        << ","
+         << result.slow_received  << ","
+         << slow_drop_rate        << ","
+         << result.slow_p50_ms    << ","
+         << result.slow_p99_ms    << ","
+         << result.slow_max_ms    << ","
+         << result.forwarded_mb;
+    }
+    std::cout << ss.str() << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+    return 1;
+
+  if (!options.json)
+    std::cout << "profile,mode,callbacks,sent,send_p99_us,send_max_us,fast_received,fast_drop_rate,slow_received,slow_drop_rate,slow_p50_ms,slow_p99_ms,slow_max_ms,forwarded_mb" << std::endl;
+
+  for (const auto& profile_name : options.profiles)
+  {
+    Profile profile;
+    makeProfile(profile_name, options, profile);
+
+    for (const auto& mode : options.modes)
+    {
+      for (const auto& callback_mode : options.callback_modes)
+      {
+        std::cerr << "Running " << profile_name << " " << mode << " callbacks=" << callback_mode << std::endl;
+        printResult(runBenchmark(profile, mode, callback_mode, options), options.json);
+      }
+    }
+  }
+
+  return 0;
+}
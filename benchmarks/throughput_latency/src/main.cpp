@@ -0,0 +1,318 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// Throughput and latency benchmark over loopback
+//
+// Sweeps message size, subscriber count, executor threads and send mode. For
+// each combination a publisher sends as fast as possible for a fixed time and
+// all subscribers measure the latency of each message they receive. The
+// results are printed to stdout as CSV (default) or as one JSON object per
+// line, so runs can be compared by scripts. Progress and errors go to stderr.
+//
+// Usage:
+//   throughput_latency [--sizes 64,1024,...] [--subscribers 1,4] [--threads 1,4]
+//                      [--modes best_effort,reliable] [--duration-ms 1000]
+//                      [--format csv|json]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+namespace
+{
+  struct Options
+  {
+    std::vector<size_t>      sizes;
+    std::vector<size_t>      subscriber_counts = { 1, 4 };
+    std::vector<size_t>      thread_counts     = { 1, 4 };
+    std::vector<std::string> modes             = { "best_effort", "reliable" };
+    std::chrono::milliseconds duration         = std::chrono::milliseconds(1000);
+    bool                     json              = false;
+  };
+
+  struct Result
+  {
+    std::string mode;
+    size_t      message_size     = 0;
+    size_t      subscriber_count = 0;
+    size_t      thread_count     = 0;
+    uint64_t    messages_sent    = 0;
+    uint64_t    messages_received= 0;                      // Sum over all subscribers
+    double      seconds          = 0.0;
+    double      cpu_seconds      = 0.0;
+    double      p50_us           = 0.0;
+    double      p99_us           = 0.0;
+    double      p999_us          = 0.0;
+  };
+
+  // Each subscriber records into its own list, so the callbacks don't contend
+  struct LatencyRecorder
+  {
+    std::vector<int64_t>  latencies_ns;
+    std::atomic<uint64_t> received { 0 };
+    std::atomic<int64_t>  last_receive_time_ns { 0 };
+  };
+
+  const tcp_pubsub::logger::logger_t warnings_only_logger
+        = [](const tcp_pubsub::logger::LogLevel log_level, const std::string& message)
+          {
+            if (log_level >= tcp_pubsub::logger::LogLevel::Warning)
+              std::cerr << "[TCP ps] " + message + "\n";
+          };
+
+  int64_t steadyNowNs()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  template <typename T>
+  std::vector<T> parseList(const std::string& list, T (*parse)(const std::string&))
+  {
+    std::vector<T>     values;
+    std::stringstream  ss(list);
+    std::string        item;
+    while (std::getline(ss, item, ','))
+    {
+      if (!item.empty())
+        values.push_back(parse(item));
+    }
+    return values;
+  }
+
+  size_t      parseSize  (const std::string& s) { return static_cast<size_t>(std::stoull(s)); }
+  std::string parseString(const std::string& s) { return s; }
+
+  bool parseOptions(int argc, char** argv, Options& options)
+  {
+    // 64 B to 64 MB in steps of 4
+    for (size_t size = 64; size <= 64 * 1024 * 1024; size *= 4)
+      options.sizes.push_back(size);
+
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg   = argv[i];
+      const bool        has_value = (i + 1 < argc);
+
+      if      ((arg == "--sizes")       && has_value) options.sizes             = parseList(argv[++i], parseSize);
+      else if ((arg == "--subscribers") && has_value) options.subscriber_counts = parseList(argv[++i], parseSize);
+      else if ((arg == "--threads")     && has_value) options.thread_counts     = parseList(argv[++i], parseSize);
+      else if ((arg == "--modes")       && has_value) options.modes             = parseList(argv[++i], parseString);
+      else if ((arg == "--duration-ms") && has_value) options.duration          = std::chrono::milliseconds(std::stoll(argv[++i]));
+      else if ((arg == "--format")      && has_value) options.json              = (std::string(argv[++i]) == "json");
+      else
+      {
+        std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+        return false;
+      }
+    }
+
+    for (const auto& mode : options.modes)
+    {
+      if ((mode != "best_effort") && (mode != "reliable"))
+      {
+        std::cerr << "Unknown mode: " << mode << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  double percentileUs(const std::vector<int64_t>& sorted_latencies_ns, double percentile)
+  {
+    if (sorted_latencies_ns.empty())
+      return 0.0;
+
+    const size_t index = std::min(sorted_latencies_ns.size() - 1, static_cast<size_t>(percentile * static_cast<double>(sorted_latencies_ns.size())));
+    return static_cast<double>(sorted_latencies_ns[index]) / 1000.0;
+  }
+
+  Result runBenchmark(const std::string& mode, size_t message_size, size_t subscriber_count, size_t thread_count, std::chrono::milliseconds duration)
+  {
+    Result result;
+    result.mode             = mode;
+    result.message_size     = message_size;
+    result.subscriber_count = subscriber_count;
+    result.thread_count     = thread_count;
+
+    auto executor = std::make_shared<tcp_pubsub::Executor>(thread_count, warnings_only_logger);
+
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_ = (mode == "reliable");
+
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+
+    // Each queued message is a copy, so we limit the window to roughly 256 MB
+    tcp_pubsub::SubscriberFlowControlSetting flow_control_setting;
+    flow_control_setting.credit_window_messages_ = std::max<uint64_t>(2, std::min<uint64_t>(64, (256 * 1024 * 1024) / message_size));
+
+    std::vector<std::unique_ptr<LatencyRecorder>>        recorders;
+    std::vector<std::unique_ptr<tcp_pubsub::Subscriber>> subscribers;
+    for (size_t i = 0; i < subscriber_count; i++)
+    {
+      recorders.push_back(std::make_unique<LatencyRecorder>());
+      subscribers.push_back(std::make_unique<tcp_pubsub::Subscriber>(executor, flow_control_setting));
+
+      LatencyRecorder* recorder = recorders.back().get();
+      subscribers.back()->setCallback([recorder](const tcp_pubsub::CallbackData& callback_data)
+                                      {
+                                        const int64_t receive_time_ns = steadyNowNs();
+                                        int64_t       send_time_ns    = 0;
+                                        std::memcpy(&send_time_ns, callback_data.buffer_->data(), sizeof(send_time_ns));
+
+                                        recorder->latencies_ns.push_back(receive_time_ns - send_time_ns);
+                                        recorder->received++;
+                                        recorder->last_receive_time_ns = receive_time_ns;
+                                      });
+      subscribers.back()->addSession("127.0.0.1", publisher.getPort());
+    }
+
+    // Wait for all subscribers to connect
+    const auto connect_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((publisher.getSubscriberCount() < subscriber_count) && (std::chrono::steady_clock::now() < connect_deadline))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    if (publisher.getSubscriberCount() < subscriber_count)
+      std::cerr << "Only " << publisher.getSubscriberCount() << " of " << subscriber_count << " subscribers have connected" << std::endl;
+
+    std::vector<char> payload(std::max(message_size, sizeof(int64_t)), 'x');
+
+    const std::clock_t cpu_start   = std::clock();
+    const auto         start       = std::chrono::steady_clock::now();
+    const auto         send_until  = start + duration;
+
+    while (std::chrono::steady_clock::now() < send_until)
+    {
+      const int64_t send_time_ns = steadyNowNs();
+      std::memcpy(payload.data(), &send_time_ns, sizeof(send_time_ns));
+      publisher.send(payload.data(), payload.size());
+      result.messages_sent++;
+    }
+
+    // Let the subscribers drain what is still in flight
+    const auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    uint64_t   last_received  = 0;
+    for (;;)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+      uint64_t received = 0;
+      for (const auto& recorder : recorders)
+        received += recorder->received;
+
+      if ((received == last_received) || (std::chrono::steady_clock::now() > drain_deadline))
+        break;
+      last_received = received;
+    }
+
+    const std::clock_t cpu_end = std::clock();
+
+    // The measurement ends with the last message received, so the time spent
+    // waiting for the subscribers to drain does not count.
+    int64_t end_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(send_until.time_since_epoch()).count();
+    for (const auto& recorder : recorders)
+      end_ns = std::max<int64_t>(end_ns, recorder->last_receive_time_ns);
+    const auto end = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(end_ns));
+
+    // Cancelling joins the callback threads, so we can safely read the recorders afterwards
+    for (auto& subscriber : subscribers)
+      subscriber->cancel();
+    publisher.cancel();
+
+    std::vector<int64_t> latencies_ns;
+    for (const auto& recorder : recorders)
+      latencies_ns.insert(latencies_ns.end(), recorder->latencies_ns.begin(), recorder->latencies_ns.end());
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+
+    result.messages_received = latencies_ns.size();
+    result.seconds           = std::chrono::duration<double>(end - start).count();
+    result.cpu_seconds       = static_cast<double>(cpu_end - cpu_start) / CLOCKS_PER_SEC;
+    result.p50_us            = percentileUs(latencies_ns, 0.50);
+    result.p99_us            = percentileUs(latencies_ns, 0.99);
+    result.p999_us           = percentileUs(latencies_ns, 0.999);
+
+    return result;
+  }
+
+  void printResult(const Result& result, bool json)
+  {
+    // Throughput is given per subscriber, i.e. what each subscriber has received on average
+    const double received_per_subscriber = static_cast<double>(result.messages_received) / static_cast<double>(std::max<size_t>(1, result.subscriber_count));
+    const double messages_per_second     = (result.seconds > 0.0 ? received_per_subscriber / result.seconds : 0.0);
+    const double megabytes_per_second    = messages_per_second * static_cast<double>(result.message_size) / (1024.0 * 1024.0);
+    const double cpu_us_per_message      = (result.messages_received > 0 ? result.cpu_seconds * 1e6 / static_cast<double>(result.messages_received) : 0.0);
+
+    std::stringstream ss;
+    if (json)
+    {
+      ss << "{\"mode\":\""              << result.mode              << "\""
+         << ",\"message_size\":"        << result.message_size
+         << ",\"subscribers\":"         << result.subscriber_count
+         << ",\"threads\":"             << result.thread_count
+         << ",\"messages_sent\":"       << result.messages_sent
+         << ",\"messages_received\":"   << result.messages_received
+         << ",\"messages_per_second\":" << messages_per_second
+         << ",\"megabytes_per_second\":"<< megabytes_per_second
+         << ",\"cpu_us_per_message\":"  << cpu_us_per_message
+         << ",\"p50_us\":"              << result.p50_us
+         << ",\"p99_us\":"              << result.p99_us
+         << ",\"p999_us\":"             << result.p999_us
+         << "}";
+    }
+    else
+    {
+      ss << result.mode              << ","
+         << result.message_size      << ","
+         << result.subscriber_count  << ","
+         << result.thread_count      << ","
+         << result.messages_sent     << ","
+         << result.messages_received << ","
+         << messages_per_second      << ","
+         << megabytes_per_second     << ","
+         << cpu_us_per_message       << ","
+         << result.p50_us            << ","
+         << result.p99_us            << ","
+         << result.p999_us;
+    }
+    std::cout << ss.str() << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+    return 1;
+
+  if (!options.json)
+    std::cout << "mode,message_size,subscribers,threads,messages_sent,messages_received,messages_per_second,megabytes_per_second,cpu_us_per_message,p50_us,p99_us,p999_us" << std::endl;
+
+  for (const auto& mode : options.modes)
+  {
+    for (size_t thread_count : options.thread_counts)
+    {
+      for (size_t subscriber_count : options.subscriber_counts)
+      {
+        for (size_t message_size : options.sizes)
+        {
+          std::cerr << "Running " << mode << " size=" << message_size << " subscribers=" << subscriber_count << " threads=" << thread_count << std::endl;
+          printResult(runBenchmark(mode, message_size, subscriber_count, thread_count, options.duration), options.json);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
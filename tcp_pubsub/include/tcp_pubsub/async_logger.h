@@ -0,0 +1,102 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <memory>
+
+#include <stdint.h>
+
+#include "tcp_pubsub_logger.h"
+
+#include <tcp_pubsub/tcp_pubsub_version.h>
+#include <tcp_pubsub/tcp_pubsub_export.h>
+
+namespace tcp_pubsub
+{
+  struct AsyncLoggerSetting {
+    size_t   capacity_                = 4096;               /// Number of messages the ring buffer can hold. Rounded up to a power of two. Messages logged while the buffer is full are dropped and counted.
+    size_t   max_repetitions_         = 5;                  /// How often the same message (same level and text) is passed to the sink per repetition window. Further repetitions are suppressed and summarized once the window has passed. 0 disables the rate limit.
+    int64_t  repetition_window_       = 1000000000;         /// Length of the repetition window in nanoseconds
+  };
+
+  // Foward-declare implementation
+  class AsyncLogger_Impl;
+
+  /**
+   * @brief A log function that moves the actual logging off the io threads
+   *
+   * The log function returned by getLogFunction() only copies the message
+   * into a fixed-size record of a lock-free ring buffer. A background thread
+   * drains the buffer and passes the messages to the sink, e.g. the
+   * default_logger that writes to the console. Thus, a slow console does not
+   * stall the Executor's threads.
+   *
+   * Messages are truncated to about 240 characters. If the ring buffer is
+   * full, messages are dropped and counted; the background thread reports
+   * the number of dropped messages as a Warning. Repetitions of the same
+   * message (e.g. while a subscriber keeps failing to reconnect) are
+   * rate-limited, see AsyncLoggerSetting.
+   *
+   * Usage:
+   *
+   *   auto async_logger = std::make_shared<tcp_pubsub::AsyncLogger>();
+   *   auto executor     = std::make_shared<tcp_pubsub::Executor>(4, async_logger->getLogFunction());
+   *
+   * The log function stays valid after the AsyncLogger has been destroyed.
+   * Messages logged after that point are discarded.
+   */
+  class AsyncLogger
+  {
+  public:
+    /**
+     * @brief Creates a new asynchronous logger and starts its background thread
+     *
+     * @param[in] sink
+     *              The log function that the background thread passes the messages to
+     *
+     * @param[in] setting
+     *              Size of the ring buffer and rate limit of repeated messages
+     */
+    TCP_PUBSUB_EXPORT AsyncLogger(const logger::logger_t& sink = logger::default_logger, const AsyncLoggerSetting& setting = AsyncLoggerSetting());
+
+    /**
+     * @brief Passes all pending messages to the sink and stops the background thread
+     */
+    TCP_PUBSUB_EXPORT ~AsyncLogger();
+
+    // Copy
+    TCP_PUBSUB_EXPORT AsyncLogger(const AsyncLogger&)            = delete;
+    TCP_PUBSUB_EXPORT AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // Move
+    TCP_PUBSUB_EXPORT AsyncLogger& operator=(AsyncLogger&&)      = default;
+    TCP_PUBSUB_EXPORT AsyncLogger(AsyncLogger&&)                 = default;
+
+  public:
+    /**
+     * @brief Returns the log function that shall be passed to the Executor
+     *
+     * The log function never blocks and is thread-safe.
+     */
+    TCP_PUBSUB_EXPORT logger::logger_t getLogFunction() const;
+
+    /**
+     * @brief Blocks until all messages logged so far have been passed to the sink
+     */
+    TCP_PUBSUB_EXPORT void flush();
+
+    /**
+     * @brief Returns the number of messages dropped because the ring buffer was full
+     */
+    TCP_PUBSUB_EXPORT uint64_t getDroppedCount() const;
+
+    /**
+     * @brief Returns the number of messages suppressed by the rate limit
+     */
+    TCP_PUBSUB_EXPORT uint64_t getSuppressedCount() const;
+
+  private:
+    std::shared_ptr<AsyncLogger_Impl> async_logger_impl_;
+  };
+}
@@ -19,5 +19,6 @@ namespace tcp_pubsub
     // we use this struct to improve API stability.
 
     std::shared_ptr<std::vector<char>> buffer_;
+    uint64_t                           sequence_number_ = 0;   /// Number of the message in its publisher, starting at 1. 0 if the publisher does not send sequence numbers.
   };
 }
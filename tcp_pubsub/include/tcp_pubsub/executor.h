@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <memory>
 
@@ -56,6 +57,63 @@ namespace tcp_pubsub
     TCP_PUBSUB_EXPORT Executor& operator=(Executor&&)      = default;
     TCP_PUBSUB_EXPORT Executor(Executor&&)                 = default;
 
+  public:
+    /**
+     * @brief Sets the minimal level of messages passed to the log function
+     *
+     * Messages below this level are not even formatted, so disabled debug
+     * messages cost (almost) nothing. The level can be changed at any time
+     * and applies to all Publishers and Subscribers using this Executor.
+     *
+     * By default, Debug builds of tcp_pubsub log everything and Release
+     * builds log Info and above.
+     *
+     * This function is thread-safe.
+     *
+     * @param[in] log_level
+     *              The minimal level that shall be logged
+     */
+    TCP_PUBSUB_EXPORT void             setLogLevel(logger::LogLevel log_level);
+
+    /**
+     * @brief Returns the minimal level of messages passed to the log function
+     */
+    TCP_PUBSUB_EXPORT logger::LogLevel getLogLevel() const;
+
+    /**
+     * @brief Returns the statistics of all Publishers and Subscribers in the Prometheus text format
+     *
+     * The statistics contain the number of messages and bytes, dropped
+     * messages, reconnects, queue depths and latency histograms of each
+     * Publisher and Subscriber using this Executor. Publishers are labeled
+     * with their local endpoint, Subscribers with an id that is also used in
+     * their log messages.
+     *
+     * Latency histograms are only filled, if tcp_pubsub has been built with
+     * TCP_PUBSUB_ENABLE_LATENCY_HISTOGRAMS.
+     *
+     * This function is thread-safe.
+     */
+    TCP_PUBSUB_EXPORT std::string      getPrometheusStatistics() const;
+
+    /**
+     * @brief Periodically writes the statistics to a file
+     *
+     * The file is replaced each interval with the output of
+     * getPrometheusStatistics(), e.g. for the node_exporter textfile
+     * collector. It is written to a temporary file next to it first and then
+     * renamed, so readers never see a partially written file.
+     *
+     * This function is thread-safe.
+     *
+     * @param[in] path
+     *              The file to write. An empty path stops writing.
+     *
+     * @param[in] interval
+     *              Time between two writes. 0 stops writing.
+     */
+    TCP_PUBSUB_EXPORT void             setStatisticsFile(const std::string& path, std::chrono::milliseconds interval);
+
   private:
     friend ::tcp_pubsub::Publisher_Impl;
     friend ::tcp_pubsub::Subscriber_Impl;
@@ -0,0 +1,70 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Copy of a latency histogram
+   *
+   * Latencies are recorded into log-linear buckets, i.e. each power of two is
+   * split into 32 buckets of equal width. Each value is therefore known with
+   * a relative error of at most about 3%, no matter whether it is a few
+   * microseconds or several seconds.
+   *
+   * Histograms are only recorded, if tcp_pubsub has been built with
+   * TCP_PUBSUB_ENABLE_LATENCY_HISTOGRAMS. Otherwise they are always empty.
+   */
+  struct LatencyHistogramSnapshot
+  {
+    uint64_t                                  count_  = 0;  /// Number of recorded values
+    int64_t                                   sum_ns_ = 0;  /// Sum of all recorded values
+    int64_t                                   max_ns_ = 0;  /// Largest recorded value
+    std::vector<std::pair<int64_t, uint64_t>> buckets_;     /// Upper bound (inclusive, in nanoseconds) and count of each non-empty bucket, in ascending order
+
+    /// Returns the smallest bucket bound at or below which the given fraction
+    /// (0.0 ... 1.0) of all values lies, e.g. percentileNs(0.99) for the p99.
+    int64_t percentileNs(double fraction) const
+    {
+      if (count_ == 0)
+        return 0;
+
+      uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(count_) + 0.5);
+      if (target < 1)      target = 1;
+      if (target > count_) target = count_;
+
+      uint64_t seen = 0;
+      for (const auto& bucket : buckets_)
+      {
+        seen += bucket.second;
+        if (seen >= target)
+          return (bucket.first < max_ns_ ? bucket.first : max_ns_);
+      }
+      return max_ns_;
+    }
+
+    int64_t meanNs() const
+    {
+      return (count_ > 0 ? sum_ns_ / static_cast<int64_t>(count_) : 0);
+    }
+  };
+
+  struct SubscriberSessionStatistics
+  {
+    LatencyHistogramSnapshot header_to_payload_;    /// From receiving the first header byte until the payload is complete
+    LatencyHistogramSnapshot payload_to_callback_;  /// From the complete payload until the callback is invoked. For asynchronous callbacks, this ends when the message is handed to the callback thread.
+  };
+
+  struct PublisherSessionStatistics
+  {
+    std::string              remote_endpoint_;      /// Address and port of the subscriber
+    LatencyHistogramSnapshot publish_to_write_;     /// From the send() call until the message has been written to the socket. Messages that have been dropped in favor of newer ones and the transient local history are not recorded.
+  };
+}
@@ -8,9 +8,12 @@
 #include <memory>
 #include <string>
 #include <chrono>
+#include <functional>
 #include <vector>
 
 #include "executor.h"
+#include "latency_statistics.h"
+#include "rpc.h"
 
 #include <tcp_pubsub/tcp_pubsub_version.h>
 #include <tcp_pubsub/tcp_pubsub_export.h>
@@ -20,6 +23,21 @@ namespace tcp_pubsub
   struct PublisherTransientLocalSetting {
     uint32_t buffer_max_count_ = 0;
     int64_t lifespan_ = 0;
+    uint64_t buffer_max_bytes_ = 0;                         /// Maximum sum of the sizes of all samples in the history. If exceeded, the oldest samples are dropped. 0 means unlimited.
+
+    uint64_t replay_max_bytes_per_second_ = 0;              /// Maximum rate at which the history is sent to a late-joining subscriber, measured over a sliding window of 1 second. 0 means unlimited.
+
+    bool        keyed_ = false;                             /// If true, the history only keeps the latest sample per key (see send() with key). buffer_max_count_ then is the maximum number of keys.
+
+    std::string journal_path_;                              /// If set, the history is also appended to a memory-mapped journal file at this path and restored from it when a publisher is created
+    uint64_t    journal_size_bytes_ = 64 * 1024 * 1024;     /// Size of the journal's data segment. Samples larger than this are not journaled.
+  };
+
+  struct PublisherReliableSetting {
+    bool    enabled_          = false;                      /// If true, messages are never dropped. Each subscriber grants credit for a window of messages and send() blocks while the window of any subscriber is exhausted.
+    int64_t eviction_timeout_ = 0;                          /// Time (in nanoseconds) send() waits for the subscribers to make room in their windows. The timeout applies to the entire call, not to each subscriber. Subscribers that do not drain in time are disconnected. 0 means send() waits indefinitely.
+    uint64_t max_credit_window_messages_ = 1024;            /// Upper limit for the credit window a subscriber may ask for. Each subscriber's queue never holds more messages.
+    uint64_t max_credit_window_bytes_    = 64 * 1024 * 1024;/// Upper limit for the bytes (header + payload) in the credit window a subscriber may ask for. Each subscriber's queue never holds more bytes, unless a single message is larger. 0 means unlimited.
   };
 
   class Publisher_Impl;
@@ -42,6 +60,10 @@ namespace tcp_pubsub
    *   one. If messages are provided faster than the link speed can handle, only
    *   the last message is kept and other messages will be dropped.
    *
+   * A reliable publisher (see PublisherReliableSetting) instead queues each
+   * message for each subscriber, up to the credit window the subscriber has
+   * granted. send() blocks while a subscriber's queue is full.
+   *
    */
   class Publisher
   {
@@ -106,6 +128,22 @@ namespace tcp_pubsub
      */
     TCP_PUBSUB_EXPORT Publisher(const std::shared_ptr<Executor> &executor, const PublisherTransientLocalSetting &, uint16_t port = 0);
 
+    /**
+     * @brief Creates a new publisher that may be reliable
+     *
+     * Same as Publisher(executor, transient_local_setting, address, port), but
+     * additionally takes a PublisherReliableSetting.
+     */
+    TCP_PUBSUB_EXPORT Publisher(const std::shared_ptr<Executor> &executor, const PublisherTransientLocalSetting &, const PublisherReliableSetting &, const std::string &address, uint16_t port);
+
+    /**
+     * @brief Creates a new publisher that may be reliable
+     *
+     * Same as Publisher(executor, transient_local_setting, port), but
+     * additionally takes a PublisherReliableSetting.
+     */
+    TCP_PUBSUB_EXPORT Publisher(const std::shared_ptr<Executor> &executor, const PublisherTransientLocalSetting &, const PublisherReliableSetting &, uint16_t port = 0);
+
     // Copy
     TCP_PUBSUB_EXPORT Publisher(const Publisher&)            = default;
     TCP_PUBSUB_EXPORT Publisher& operator=(const Publisher&) = default;
@@ -142,6 +180,18 @@ namespace tcp_pubsub
      */
     TCP_PUBSUB_EXPORT size_t             getSubscriberCount() const;
 
+    /**
+     * @brief Get the latency statistics of all subscriber connections
+     * 
+     * The histograms are only recorded, if tcp_pubsub has been built with
+     * TCP_PUBSUB_ENABLE_LATENCY_HISTOGRAMS. Otherwise they are empty.
+     * 
+     * This method is thread-safe
+     * 
+     * @return One element for each active subscriber
+     */
+    TCP_PUBSUB_EXPORT std::vector<PublisherSessionStatistics> getSessionStatistics() const;
+
     /**
      * @brief Check whether the publisher is running
      * 
@@ -219,6 +269,10 @@ namespace tcp_pubsub
      *     buffer will be dropped. tcp_pubsub will always assume that the last
      *     element is the only important one.
      * 
+     * For a reliable publisher, no element is dropped. Each element is queued
+     * for each subscriber instead, and this function blocks while the credit
+     * window of any subscriber is exhausted (see PublisherReliableSetting).
+     * 
      * If there are no active subscriptions, this function returns immediatelly
      * without doing anything. You don't need to check with getSubsriberCount()
      * in that case.
@@ -232,6 +286,151 @@ namespace tcp_pubsub
      */
     TCP_PUBSUB_EXPORT bool send(const std::vector<std::pair<const char* const, const size_t>>& buffers) const;
 
+    /**
+     * @brief Send keyed data to all subscribers
+     * 
+     * Works like send(const char* const data, size_t size), but additionally
+     * tags the data with a key. See send(key, std::vector buffers).
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] key
+     *              The key the data belongs to (e.g. an entity ID)
+     * 
+     * @param[in] data
+     *              Pointer to the data to send
+     * 
+     * @param[in] size
+     *              Size of the data to send in number-of-bytes
+     * 
+     * @return Whether sending has been successfull (i.e. the publisher is running)
+     */
+    TCP_PUBSUB_EXPORT bool send(uint64_t key, const char* const data, size_t size) const;
+
+    /**
+     * @brief Send keyed data to all subscribers
+     * 
+     * Works like send(std::vector buffers), but additionally tags the data
+     * with a key. The key is not transmitted to the subscribers. It is only
+     * used for the transient local history:
+     * 
+     *   - If the publisher has been created with a keyed transient local
+     *     setting, the history only keeps the latest data of each key. Late
+     *     joining subscribers will receive one message per key, ordered by the
+     *     time the keys have been updated. Data sent without a key is not
+     *     kept in a keyed history.
+     * 
+     *   - Otherwise, the key is ignored.
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] key
+     *              The key the data belongs to (e.g. an entity ID)
+     * 
+     * @param[in] buffers
+     *              List of (sub-)buffers to send to all subscribers
+     * 
+     * @return True if sending was successfull (i.e. the publisher is running)
+     */
+    TCP_PUBSUB_EXPORT bool send(uint64_t key, const std::vector<std::pair<const char* const, const size_t>>& buffers) const;
+
+    /**
+     * @brief Send data with a sequence number chosen by you
+     * 
+     * Works like send(std::vector buffers), but the message gets the given
+     * sequence number instead of the next one counted by this publisher.
+     * 
+     * Use this for redundant publishers of the same stream: If all of them
+     * stamp each message with the same number (e.g. the number of the message
+     * in its source), a Subscriber with deduplication connected to all of them
+     * (see Subscriber::setDeduplication()) receives each message once. The
+     * publisher's own count only advances while subscribers are connected,
+     * so it cannot be used to match messages of different publishers.
+     * 
+     * Sequence numbers must be greater than 0 and increase with every message.
+     * Subscribers drop messages with a number that is not greater than the
+     * last one they have received (see
+     * SubscriberReplaySetting::resume_on_reconnect_). Do not mix this with
+     * the other send functions.
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] sequence_number
+     *              The sequence number of the message
+     * 
+     * @param[in] buffers
+     *              List of (sub-)buffers to send to all subscribers
+     * 
+     * @return True if sending was successfull (i.e. the publisher is running)
+     */
+    TCP_PUBSUB_EXPORT bool sendWithSequenceNumber(uint64_t sequence_number, const std::vector<std::pair<const char* const, const size_t>>& buffers) const;
+
+    /**
+     * @brief Send data that is written directly into the internal buffer
+     * 
+     * Works like send(const char* const data, size_t size), but instead of
+     * copying the data from your memory, the writer is handed the internal
+     * buffer to fill. This saves a copy, if you would otherwise have to
+     * serialize your data to a temporary buffer first.
+     * 
+     * The writer is called synchronously, before this function returns, and
+     * only if the data is actually sent or stored in the transient local
+     * history. If there are no active subscriptions, your data does not even
+     * have to be serialized.
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] size
+     *              Size of the data to send in number-of-bytes
+     * 
+     * @param[in] writer
+     *              Function (data, size)->void that writes exactly size bytes
+     *              to data. The pointer must not be used after the writer has
+     *              returned.
+     * 
+     * @return Whether sending has been successfull (i.e. the publisher is running)
+     */
+    TCP_PUBSUB_EXPORT bool sendInPlace(size_t size, const std::function<void(char* data, size_t size)>& writer) const;
+
+    /**
+     * @brief Send keyed data that is written directly into the internal buffer
+     * 
+     * Works like sendInPlace(size, writer), but additionally tags the data
+     * with a key. See send(key, std::vector buffers).
+     * 
+     * This method is thread-safe.
+     */
+    TCP_PUBSUB_EXPORT bool sendInPlace(uint64_t key, size_t size, const std::function<void(char* data, size_t size)>& writer) const;
+
+    /**
+     * @brief Set the handler for requests of subscribers
+     * 
+     * Subscribers can send requests over their existing connection (see
+     * SubscriberSession::call()). Each request is passed to the handler
+     * together with a responder that sends the response back to the
+     * subscriber that has sent the request.
+     * 
+     * The handler is executed in the asio thread. Requests of one subscriber
+     * are handled one after another, in the order they have been sent. The
+     * handler should therefore return quickly. It does not have to respond
+     * right away, though: You can keep the responder (and the request buffer)
+     * and respond later from any thread. So responses may be sent in a
+     * different order than the requests have been received.
+     * 
+     * Responses are sent before any queued data and do not count against the
+     * credit of reliable subscribers.
+     * 
+     * Requests received while no handler is set are answered with
+     * RpcResponse::Status::NoHandler.
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] rpc_handler
+     *              Function (request, respond)->void. Set to nullptr to
+     *              remove the handler.
+     */
+    TCP_PUBSUB_EXPORT void setRpcHandler(const RpcHandler& rpc_handler);
+
     /**
      * @brief Close all connections
      * 
@@ -0,0 +1,45 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "callback_data.h"
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Response to a request sent with SubscriberSession::call()
+   */
+  struct RpcResponse
+  {
+    enum class Status
+    {
+      Ok,               /// The publisher has responded. The response is in buffer_.
+      NoHandler,        /// The publisher does not have an RPC handler
+      ConnectionLost,   /// The connection has been lost (or the session has been canceled) before the response has been received. The publisher may or may not have handled the request.
+      Timeout,          /// No response has been received within the timeout of SubscriberSession::call()
+    };
+
+    Status                             status_ = Status::ConnectionLost;
+    std::shared_ptr<std::vector<char>> buffer_;   /// The response payload. Only set, if status_ is Ok.
+  };
+
+  /**
+   * @brief Sends the response to one request
+   *
+   * May be called from any thread, also after the RpcHandler has returned.
+   * Only the first call sends a response. Returns false, if no response has
+   * been sent (i.e. the connection is gone or a response has already been
+   * sent).
+   */
+  using RpcResponder = std::function<bool(const char* data, size_t size)>;
+
+  /**
+   * @brief Handles requests on a publisher, see Publisher::setRpcHandler()
+   */
+  using RpcHandler   = std::function<void(const CallbackData& request, const RpcResponder& respond)>;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Serialization trait used by TypedPublisher and TypedSubscriber
+   *
+   * Specialize this template for your own types. A serializer either views
+   * received messages in place (zero_copy = true) or deserializes them into a
+   * new value (zero_copy = false):
+   *
+   *   template <>
+   *   struct Serializer<MyType>
+   *   {
+   *     static constexpr bool zero_copy = false;
+   *
+   *     // Exact number of bytes serialize() will write
+   *     static size_t size(const MyType& value);
+   *
+   *     // Writes the value to data, which has room for exactly size(value) bytes
+   *     static void serialize(const MyType& value, char* data, size_t size);
+   *
+   *     // Returns false, if the data is not a valid MyType
+   *     static bool deserialize(const char* data, size_t size, MyType& value);
+   *   };
+   *
+   * A zero_copy serializer provides view() instead of deserialize():
+   *
+   *     // Returns nullptr, if the data is not a valid MyType
+   *     static const MyType* view(const char* data, size_t size);
+   *
+   * Serializers are provided for trivially copyable types (zero copy),
+   * std::string and std::vector of trivially copyable types.
+   */
+  template <typename T, typename Enable = void>
+  struct Serializer;
+
+  /**
+   * @brief Sends trivially copyable types as they are in memory
+   *
+   * Received messages are not copied, but viewed in place. This is only
+   * meaningful, if publisher and subscriber agree on the memory layout of T
+   * (i.e. same struct definition, compiler settings and endianness), and T
+   * does not contain pointers.
+   */
+  template <typename T>
+  struct Serializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+  {
+    // Received buffers are allocated with operator new, so they are aligned
+    // for all fundamental types.
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types cannot be viewed in place");
+
+    static constexpr bool zero_copy = true;
+
+    static size_t size(const T& /*value*/)
+    {
+      return sizeof(T);
+    }
+
+    static void serialize(const T& value, char* data, size_t /*size*/)
+    {
+      std::memcpy(data, &value, sizeof(T));
+    }
+
+    static const T* view(const char* data, size_t size)
+    {
+      return (size == sizeof(T) ? reinterpret_cast<const T*>(data) : nullptr);
+    }
+  };
+
+  template <>
+  struct Serializer<std::string>
+  {
+    static constexpr bool zero_copy = false;
+
+    static size_t size(const std::string& value)
+    {
+      return value.size();
+    }
+
+    static void serialize(const std::string& value, char* data, size_t size)
+    {
+      std::memcpy(data, value.data(), size);
+    }
+
+    static bool deserialize(const char* data, size_t size, std::string& value)
+    {
+      value.assign(data, size);
+      return true;
+    }
+  };
+
+  template <typename T>
+  struct Serializer<std::vector<T>, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+  {
+    static constexpr bool zero_copy = false;
+
+    static size_t size(const std::vector<T>& value)
+    {
+      return value.size() * sizeof(T);
+    }
+
+    static void serialize(const std::vector<T>& value, char* data, size_t size)
+    {
+      std::memcpy(data, value.data(), size);
+    }
+
+    static bool deserialize(const char* data, size_t size, std::vector<T>& value)
+    {
+      if ((size % sizeof(T)) != 0)
+        return false;
+
+      value.resize(size / sizeof(T));
+      if (size > 0)
+        std::memcpy(value.data(), data, size);
+      return true;
+    }
+  };
+}
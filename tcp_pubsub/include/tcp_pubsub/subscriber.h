@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <chrono>
+#include <functional>
 #include <string>
 
 #include "executor.h"
@@ -18,6 +19,58 @@
 
 namespace tcp_pubsub
 {
+  /**
+   * @brief Transient local history a SubscriberSession requests when connecting
+   *
+   * The publisher only keeps a history if it has been created with a
+   * PublisherTransientLocalSetting. Publishers of older versions ignore the
+   * request and always send their entire history.
+   */
+  struct SubscriberReplaySetting {
+    enum class Mode
+    {
+      All,                  /// The entire history
+      None,                 /// No history, only live data
+      LastN,                /// The last count_ messages
+      SinceTime,            /// All messages that have been published at or after since_
+      AfterSequenceNumber,  /// All messages with a sequence number greater than sequence_number_ (see CallbackData::sequence_number_)
+    };
+
+    Mode                                  mode_            = Mode::All;
+    uint64_t                              count_           = 0;
+    std::chrono::system_clock::time_point since_;
+    uint64_t                              sequence_number_ = 0;
+
+    /// When reconnecting after a connection loss, only request the messages
+    /// published after the last one received, so nothing is lost or received
+    /// twice, as long as the publisher's history still holds them. Messages
+    /// whose sequence number is not greater than the last one received are
+    /// dropped as duplicates.
+    bool                                  resume_on_reconnect_ = true;
+  };
+
+  /**
+   * @brief Credit a Subscriber grants to reliable publishers
+   *
+   * A reliable publisher (see PublisherReliableSetting) never sends more
+   * messages than the subscriber has granted credit for. Credit for a message
+   * is returned once the callback has processed it, so a slow callback slows
+   * down the publisher instead of losing messages.
+   *
+   * Publishers that are not reliable ignore the window. They can limit the
+   * rate instead: They send at most max_messages_per_second_ messages, i.e.
+   * only the latest message of each interval. Messages are dropped by the
+   * publisher, before they are sent, so this saves bandwidth and CPU on both
+   * sides. Reliable publishers and publishers of older versions ignore the
+   * rate. The rate can be changed for each session with
+   * SubscriberSession::setMaxRate().
+   */
+  struct SubscriberFlowControlSetting {
+    uint64_t credit_window_messages_ = 64;                  /// Maximum number of messages a reliable publisher may send ahead of the callback
+    uint64_t credit_window_bytes_    = 0;                   /// Maximum number of bytes (header + payload) a reliable publisher may send ahead of the callback. 0 means unlimited.
+    double   max_messages_per_second_ = 0.0;                /// Maximum rate at which a publisher that is not reliable sends live messages. 0 means unlimited. The transient local history is not limited by this.
+  };
+
   class Subscriber_Impl;
 
   /**
@@ -39,6 +92,10 @@ namespace tcp_pubsub
    *   arrive too fast and the callback cannot process them, messages are being
    *   dropped, so your callback will always receive the latest data available.
    * 
+   * Messages of reliable publishers (see PublisherReliableSetting) are never
+   * dropped. They are queued instead, and the publisher does not send more
+   * than the credit window (see SubscriberFlowControlSetting) allows.
+   * 
    * All SubscriberSessions will share the same 1-message queue. It is assumend,
    * that the SubscriberSessions that are created in the same Subscriber are of
    * same "type" (whatever that means for you).
@@ -62,6 +119,21 @@ namespace tcp_pubsub
      */
     TCP_PUBSUB_EXPORT Subscriber(const std::shared_ptr<Executor>& executor);
 
+    /**
+     * @brief creates a new Subscriber with a custom credit window
+     *
+     * Same as Subscriber(executor), but the given credit window is granted to
+     * reliable publishers instead of the default one.
+     *
+     * @param[in] executor
+     *              The (global) executor that shall execute the workload and be
+     *              used for logging.
+     *
+     * @param[in] flow_control_setting
+     *              The credit window granted to reliable publishers
+     */
+    TCP_PUBSUB_EXPORT Subscriber(const std::shared_ptr<Executor>& executor, const SubscriberFlowControlSetting& flow_control_setting);
+
     // Copy
     TCP_PUBSUB_EXPORT Subscriber(const Subscriber&)            = default;
     TCP_PUBSUB_EXPORT Subscriber& operator=(const Subscriber&) = default;
@@ -109,6 +181,33 @@ namespace tcp_pubsub
      */
     TCP_PUBSUB_EXPORT std::shared_ptr<SubscriberSession>              addSession(const std::string& address, uint16_t port, int max_reconnection_attempts = -1);
 
+    /**
+     * @brief Add a new connection to a publisher and request a part of its history
+     *
+     * Same as addSession(address, port, max_reconnection_attempts), but the
+     * publisher only sends the part of its transient local history that is
+     * requested by the replay_setting.
+     *
+     * This function is thread-safe.
+     *
+     * @param[in] address
+     *              IP or Hostname of the publisher
+     *
+     * @param[in] port
+     *              Port the publisher is listening on
+     *
+     * @param[in] replay_setting
+     *              The part of the publisher's transient local history that
+     *              shall be sent after connecting
+     *
+     * @param[in] max_reconnection_attempts
+     *              How often the Session will try to reconnect in case of an
+     *              issue. A negative value means infinite reconnection attemps.
+     *
+     * @return A shared pointer to the session. You don't need to store it.
+     */
+    TCP_PUBSUB_EXPORT std::shared_ptr<SubscriberSession>              addSession(const std::string& address, uint16_t port, const SubscriberReplaySetting& replay_setting, int max_reconnection_attempts = -1);
+
     /**
      * @brief Get a list of all Sessions.
      * 
@@ -162,6 +261,92 @@ namespace tcp_pubsub
      */
     TCP_PUBSUB_EXPORT void clearCallback();
 
+    /**
+     * @brief Deliver each message only once, even if several sessions receive it
+     * 
+     * Use this to connect to redundant publishers of the same stream, i.e.
+     * publishers that stamp the same messages with the same sequence numbers
+     * (see Publisher::sendWithSequenceNumber()). Add one session for each
+     * publisher. The first copy of a message that arrives is passed on, and
+     * every further copy of it is dropped before it reaches the callback. A
+     * message that arrives late is still passed on, as long as it is not
+     * more than 4096 numbers behind the greatest one passed on so far.
+     * Messages without a sequence number are always passed on.
+     * 
+     * As all sessions receive all the time, there is no switch-over: if a
+     * publisher fails, the messages simply arrive from the others, without a
+     * gap.
+     * 
+     * Enabling deduplication again forgets the sequence numbers received so
+     * far, e.g. when the stream starts counting from the beginning. They are
+     * also forgotten when a session reconnects to a different publisher
+     * instance, e.g. a restarted publisher.
+     * 
+     * This function is thread-safe
+     * 
+     * @param enabled
+     *              Whether messages shall be deduplicated
+     */
+    TCP_PUBSUB_EXPORT void setDeduplication(bool enabled);
+
+    /**
+     * @brief Keep received data for take(), tryTake() and waitFor() instead of calling a callback
+     * 
+     * Replaces any callback. No thread is created. Just like with an
+     * asynchronous callback, only the latest message is kept, i.e. a message
+     * that has not been taken before the next one arrives is dropped.
+     * Messages of reliable publishers are queued instead and the publisher
+     * may send the next one once a message has been taken.
+     * 
+     * The optional handler is called when data becomes available, i.e. when
+     * nothing could be taken before. It is not called again for messages that
+     * replace data that has not been taken yet. Use it to wake up your own
+     * scheduler, if it consumes data from many subscribers. The handler is
+     * executed by the Executor's thread-pool, so it must be cheap and must not
+     * take data itself.
+     * 
+     * Calling setCallback() ends the pull mode.
+     * 
+     * This function is thread-safe
+     * 
+     * @param data_available_handler
+     *              Optional function that is called when data becomes available
+     */
+    TCP_PUBSUB_EXPORT void setPullMode(const std::function<void()>& data_available_handler = nullptr);
+
+    /**
+     * @brief Takes the next message, waiting until one is available
+     * 
+     * Only available in pull mode (see setPullMode()). Returns an empty
+     * CallbackData (i.e. buffer_ == nullptr), if the pull mode is ended or the
+     * Subscriber is canceled while waiting.
+     * 
+     * This function is thread-safe
+     */
+    TCP_PUBSUB_EXPORT CallbackData take();
+
+    /**
+     * @brief Takes the next message, if one is available
+     * 
+     * Only available in pull mode (see setPullMode()). Returns an empty
+     * CallbackData (i.e. buffer_ == nullptr), if no message is available.
+     * 
+     * This function is thread-safe
+     */
+    TCP_PUBSUB_EXPORT CallbackData tryTake();
+
+    /**
+     * @brief Takes the next message, waiting at most the given time
+     * 
+     * Only available in pull mode (see setPullMode()). Returns an empty
+     * CallbackData (i.e. buffer_ == nullptr), if no message has been
+     * available before the timeout, or if the pull mode is ended or the
+     * Subscriber is canceled while waiting.
+     * 
+     * This function is thread-safe
+     */
+    TCP_PUBSUB_EXPORT CallbackData waitFor(std::chrono::nanoseconds timeout);
+
     /**
      * @brief Shuts down the Subscriber and all Sessions
      * 
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 #include <stdint.h>
@@ -10,6 +12,9 @@
 #include <tcp_pubsub/tcp_pubsub_version.h>
 #include <tcp_pubsub/tcp_pubsub_export.h>
 
+#include "latency_statistics.h"
+#include "rpc.h"
+
 namespace tcp_pubsub
 {
   // Forward-declare Implementation
@@ -78,6 +83,92 @@ namespace tcp_pubsub
      */
     TCP_PUBSUB_EXPORT bool        isConnected() const;
 
+    /**
+     * @brief Get the latency statistics of this Session
+     * 
+     * The histograms are only recorded, if tcp_pubsub has been built with
+     * TCP_PUBSUB_ENABLE_LATENCY_HISTOGRAMS. Otherwise they are empty.
+     * 
+     * @return Latency histograms of all messages received so far
+     */
+    TCP_PUBSUB_EXPORT SubscriberSessionStatistics getStatistics() const;
+
+    /**
+     * @brief Changes the maximum rate at which the publisher sends messages
+     * 
+     * Overrides SubscriberFlowControlSetting::max_messages_per_second_ for
+     * this session. The publisher then sends only the latest message of each
+     * interval. The rate is also kept when reconnecting.
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] max_messages_per_second
+     *              Maximum number of messages per second. 0 means unlimited.
+     */
+    TCP_PUBSUB_EXPORT void        setMaxRate(double max_messages_per_second);
+
+    /**
+     * @brief Sends a request to the publisher and waits for the response
+     * 
+     * The request is sent over the existing connection and handled by the
+     * RpcHandler of the publisher (see Publisher::setRpcHandler()). See
+     * callAsync() for details.
+     * 
+     * Do not call this from a callback of the same executor, as the response
+     * is received by the executor.
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] data
+     *              Pointer to the request
+     * 
+     * @param[in] size
+     *              Size of the request in number-of-bytes
+     * 
+     * @param[in] timeout
+     *              Maximum time to wait for the response. 0 means to wait
+     *              until the response has been received or the connection is
+     *              lost. The request is not withdrawn after a timeout, so the
+     *              publisher may still handle it.
+     * 
+     * @return The response
+     */
+    TCP_PUBSUB_EXPORT RpcResponse call(const char* data, size_t size, std::chrono::nanoseconds timeout = std::chrono::nanoseconds(0));
+
+    /**
+     * @brief Sends a request to the publisher
+     * 
+     * The request is copied and sent over the existing connection. Each
+     * request gets its own correlation id, so you can send several requests
+     * without waiting for the responses. The publisher may respond in any
+     * order.
+     * 
+     * Requests made while the session is not connected are sent once the
+     * connection has been established. When the connection is lost, all
+     * requests that have been sent but not answered yet fail with
+     * RpcResponse::Status::ConnectionLost. They are not sent again.
+     * 
+     * The callback is executed in the asio thread, so it must be cheap. It is
+     * called exactly once, if this function returns true.
+     * 
+     * Publishers of older versions ignore requests, so the callback is only
+     * called when the connection is lost.
+     * 
+     * This method is thread-safe.
+     * 
+     * @param[in] data
+     *              Pointer to the request
+     * 
+     * @param[in] size
+     *              Size of the request in number-of-bytes
+     * 
+     * @param[in] callback
+     *              Function that is called with the response
+     * 
+     * @return False, if the session has been canceled. The callback is not called then.
+     */
+    TCP_PUBSUB_EXPORT bool callAsync(const char* data, size_t size, const std::function<void(const RpcResponse& response)>& callback);
+
   private:
     std::shared_ptr<SubscriberSession_Impl> subscriber_session_impl_;
   };
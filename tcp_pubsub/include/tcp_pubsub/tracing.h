@@ -0,0 +1,59 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <string>
+
+#include <tcp_pubsub/tcp_pubsub_version.h>
+#include <tcp_pubsub/tcp_pubsub_export.h>
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Message lifecycle tracing
+   *
+   * If tcp_pubsub has been built with the CMake option
+   * TCP_PUBSUB_ENABLE_TRACING, each message leaves a trace point at the
+   * following stages:
+   *
+   *   Publisher:   publish (entry of send()), buffer filled, enqueue (into a
+   *                session), write (from start to completion)
+   *   Subscriber:  receive header, receive payload, callback (from start to
+   *                end)
+   *
+   * Each trace point records a timestamp and the sequence number of the
+   * message into a ring buffer of the thread that passed the trace point.
+   * Each ring buffer keeps the latest 65536 trace points of its thread.
+   * Without the CMake option, the trace points are not compiled in and the
+   * functions below return empty traces.
+   *
+   * The trace can be dumped in the Chrome trace event format, which can be
+   * opened by chrome://tracing or https://ui.perfetto.dev. Trace points
+   * recorded while dumping or clearing may be missing or inconsistent.
+   */
+  namespace tracing
+  {
+    /**
+     * @brief Returns whether tcp_pubsub has been built with trace points
+     */
+    TCP_PUBSUB_EXPORT bool isEnabled();
+
+    /**
+     * @brief Returns all recorded trace points as Chrome trace JSON
+     */
+    TCP_PUBSUB_EXPORT std::string toChromeTraceJson();
+
+    /**
+     * @brief Writes all recorded trace points as Chrome trace JSON to a file
+     *
+     * @return True if the file could be written
+     */
+    TCP_PUBSUB_EXPORT bool writeChromeTraceJson(const std::string& file_path);
+
+    /**
+     * @brief Discards all recorded trace points
+     */
+    TCP_PUBSUB_EXPORT void clear();
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+
+#include "publisher.h"
+#include "serializer.h"
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Publisher that sends values of type T
+   *
+   * Values are converted to bytes by the SerializerT trait (see Serializer).
+   * They are serialized directly into the buffer that is sent to the
+   * subscribers, so no temporary buffer is needed. Values of trivially
+   * copyable types are copied from their memory as they are.
+   *
+   * If there are no active subscriptions (and no transient local history),
+   * values are not serialized at all.
+   *
+   * This is a header-only wrapper around Publisher. All thread-safety
+   * guarantees of the Publisher apply.
+   */
+  template <typename T, typename SerializerT = Serializer<T>>
+  class TypedPublisher
+  {
+  public:
+    /**
+     * @brief Creates a new publisher
+     *
+     * Takes the same arguments as Publisher.
+     */
+    template <typename... Args>
+    explicit TypedPublisher(const std::shared_ptr<Executor>& executor, Args&&... args)
+      : publisher_(executor, std::forward<Args>(args)...)
+    {}
+
+  public:
+    /**
+     * @brief Send a value to all subscribers
+     *
+     * See Publisher::send() for details.
+     *
+     * @return Whether sending has been successfull (i.e. the publisher is running)
+     */
+    bool send(const T& value) const
+    {
+      return publisher_.sendInPlace(SerializerT::size(value)
+                                  , [&value](char* data, size_t size) { SerializerT::serialize(value, data, size); });
+    }
+
+    /**
+     * @brief Send a keyed value to all subscribers
+     *
+     * See Publisher::send(key, buffers) for details.
+     *
+     * @return Whether sending has been successfull (i.e. the publisher is running)
+     */
+    bool send(uint64_t key, const T& value) const
+    {
+      return publisher_.sendInPlace(key
+                                  , SerializerT::size(value)
+                                  , [&value](char* data, size_t size) { SerializerT::serialize(value, data, size); });
+    }
+
+    uint16_t getPort()            const { return publisher_.getPort(); }
+    size_t   getSubscriberCount() const { return publisher_.getSubscriberCount(); }
+    bool     isRunning()          const { return publisher_.isRunning(); }
+    void     cancel()                   { publisher_.cancel(); }
+
+    // The untyped publisher, e.g. for getSessionStatistics()
+    const Publisher& publisher() const  { return publisher_; }
+    Publisher&       publisher()        { return publisher_; }
+
+  private:
+    Publisher publisher_;
+  };
+}
@@ -0,0 +1,130 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "subscriber.h"
+#include "serializer.h"
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Subscriber that receives values of type T
+   *
+   * Received messages are converted by the SerializerT trait (see
+   * Serializer). Values of trivially copyable types are not copied, but
+   * viewed in place in the receive buffer. The reference passed to the
+   * callback is valid until the callback returns, or as long as you keep the
+   * buffer_ of the CallbackData.
+   *
+   * Other types are deserialized into a value that is reused for the next
+   * message, so e.g. a std::string keeps its capacity. The value is only
+   * valid until the callback returns.
+   *
+   * Messages that cannot be converted (e.g. because of a size mismatch) are
+   * not passed to the callback. They are counted, see getInvalidMessageCount().
+   *
+   * This is a header-only wrapper around Subscriber. All thread-safety
+   * guarantees of the Subscriber apply.
+   */
+  template <typename T, typename SerializerT = Serializer<T>>
+  class TypedSubscriber
+  {
+  public:
+    /**
+     * @brief Creates a new subscriber
+     *
+     * Takes the same arguments as Subscriber.
+     */
+    template <typename... Args>
+    explicit TypedSubscriber(const std::shared_ptr<Executor>& executor, Args&&... args)
+      : subscriber_      (executor, std::forward<Args>(args)...)
+      , invalid_messages_(std::make_shared<std::atomic<uint64_t>>(0))
+    {}
+
+  public:
+    /**
+     * @brief Connects to a publisher
+     *
+     * Takes the same arguments as Subscriber::addSession().
+     */
+    template <typename... Args>
+    std::shared_ptr<SubscriberSession> addSession(Args&&... args)
+    {
+      return subscriber_.addSession(std::forward<Args>(args)...);
+    }
+
+    std::vector<std::shared_ptr<SubscriberSession>> getSessions() const
+    {
+      return subscriber_.getSessions();
+    }
+
+    /**
+     * @brief Sets the callback that is called for each received value
+     *
+     * See Subscriber::setCallback() for details on synchronous and
+     * asynchronous execution.
+     */
+    void setCallback(const std::function<void(const T& value, const CallbackData& callback_data)>& callback_function, bool synchronous_execution = false)
+    {
+      subscriber_.setCallback(makeCallback(callback_function, invalid_messages_, std::integral_constant<bool, SerializerT::zero_copy>())
+                            , synchronous_execution);
+    }
+
+    void clearCallback() { subscriber_.clearCallback(); }
+    void cancel()        { subscriber_.cancel(); }
+
+    /**
+     * @brief Returns the number of messages that could not be converted to T
+     */
+    uint64_t getInvalidMessageCount() const
+    {
+      return invalid_messages_->load(std::memory_order_relaxed);
+    }
+
+    // The untyped subscriber
+    const Subscriber& subscriber() const { return subscriber_; }
+    Subscriber&       subscriber()       { return subscriber_; }
+
+  private:
+    using TypedCallback = std::function<void(const T& value, const CallbackData& callback_data)>;
+
+    // View the value in place
+    static std::function<void(const CallbackData&)> makeCallback(const TypedCallback& callback_function, const std::shared_ptr<std::atomic<uint64_t>>& invalid_messages, std::true_type /*zero_copy*/)
+    {
+      return [callback_function, invalid_messages](const CallbackData& callback_data)
+             {
+               const T* value = (callback_data.buffer_ ? SerializerT::view(callback_data.buffer_->data(), callback_data.buffer_->size()) : nullptr);
+               if (value != nullptr)
+                 callback_function(*value, callback_data);
+               else
+                 invalid_messages->fetch_add(1, std::memory_order_relaxed);
+             };
+    }
+
+    // Deserialize into a value that is reused. Callbacks of a subscriber
+    // never run concurrently, so the value does not need to be protected.
+    static std::function<void(const CallbackData&)> makeCallback(const TypedCallback& callback_function, const std::shared_ptr<std::atomic<uint64_t>>& invalid_messages, std::false_type /*zero_copy*/)
+    {
+      return [callback_function, invalid_messages, value = std::make_shared<T>()](const CallbackData& callback_data)
+             {
+               if (callback_data.buffer_ && SerializerT::deserialize(callback_data.buffer_->data(), callback_data.buffer_->size(), *value))
+                 callback_function(*value, callback_data);
+               else
+                 invalid_messages->fetch_add(1, std::memory_order_relaxed);
+             };
+    }
+
+  private:
+    Subscriber                             subscriber_;
+    std::shared_ptr<std::atomic<uint64_t>> invalid_messages_;
+  };
+}
@@ -0,0 +1,39 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include <tcp_pubsub/async_logger.h>
+
+#include "async_logger_impl.h"
+
+namespace tcp_pubsub
+{
+  AsyncLogger::AsyncLogger(const logger::logger_t& sink, const AsyncLoggerSetting& setting)
+    : async_logger_impl_(std::make_shared<AsyncLogger_Impl>(sink, setting))
+  {
+    async_logger_impl_->start();
+  }
+
+  AsyncLogger::~AsyncLogger()
+  {
+    if (async_logger_impl_)
+      async_logger_impl_->stop();
+  }
+
+  logger::logger_t AsyncLogger::getLogFunction() const
+  {
+    const std::shared_ptr<AsyncLogger_Impl> async_logger_impl = async_logger_impl_;
+    return [async_logger_impl](const logger::LogLevel log_level, const std::string& message)
+            {
+              async_logger_impl->push(log_level, message);
+            };
+  }
+
+  void AsyncLogger::flush()
+    { async_logger_impl_->flush(); }
+
+  uint64_t AsyncLogger::getDroppedCount() const
+    { return async_logger_impl_->getDroppedCount(); }
+
+  uint64_t AsyncLogger::getSuppressedCount() const
+    { return async_logger_impl_->getSuppressedCount(); }
+}
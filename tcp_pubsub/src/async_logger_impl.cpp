@@ -0,0 +1,278 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "async_logger_impl.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/prctl.h>
+
+namespace tcp_pubsub
+{
+  namespace
+  {
+    size_t ringSize(size_t capacity)
+    {
+      size_t size = 2;
+      while (size < capacity)
+        size <<= 1;
+      return size;
+    }
+  }
+
+  ////////////////////////////////////////////////
+  // Constructor & Destructor
+  ////////////////////////////////////////////////
+
+  AsyncLogger_Impl::AsyncLogger_Impl(const logger::logger_t& sink, const AsyncLoggerSetting& setting)
+    : sink_                   (sink)
+    , setting_                (setting)
+    , ring_mask_              (ringSize(setting.capacity_) - 1)
+    , ring_                   (new Record[ring_mask_ + 1])
+    , enqueue_pos_            (0)
+    , dequeue_pos_            (0)
+    , dropped_count_          (0)
+    , suppressed_count_       (0)
+    , dropped_count_reported_ (0)
+    , last_repetition_sweep_  (std::chrono::steady_clock::now())
+    , stopped_                (false)
+    , flush_requested_pos_    (0)
+    , delivered_pos_          (0)
+  {
+    for (size_t i = 0; i <= ring_mask_; i++)
+      ring_[i].sequence_.store(i, std::memory_order_relaxed);
+  }
+
+  AsyncLogger_Impl::~AsyncLogger_Impl()
+  {
+    stop();
+  }
+
+  void AsyncLogger_Impl::start()
+  {
+    thread_ = std::thread([this]()
+                          {
+                            prctl(PR_SET_NAME, "EcalLogTcpPS", nullptr, nullptr, nullptr);
+                            run();
+                          });
+  }
+
+  void AsyncLogger_Impl::stop()
+  {
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    wakeup_cv_.notify_all();
+
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  ////////////////////////////////////////////////
+  // API
+  ////////////////////////////////////////////////
+
+  void AsyncLogger_Impl::push(logger::LogLevel log_level, const std::string& message)
+  {
+    Record* record = nullptr;
+    size_t  pos    = enqueue_pos_.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      record = &ring_[pos & ring_mask_];
+      const size_t   sequence = record->sequence_.load(std::memory_order_acquire);
+      const intptr_t diff     = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+      if (diff == 0)
+      {
+        // The slot is free. Claim it.
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        // The slot still holds a message of the previous round, i.e. the ring is full
+        dropped_count_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      else
+      {
+        // Another thread has claimed the slot
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    record->log_level_ = log_level;
+    if (message.size() <= MAX_MESSAGE_LENGTH)
+    {
+      std::memcpy(record->text_.data(), message.data(), message.size());
+      record->length_ = static_cast<uint16_t>(message.size());
+    }
+    else
+    {
+      std::memcpy(record->text_.data(), message.data(), MAX_MESSAGE_LENGTH - 3);
+      std::memcpy(record->text_.data() + MAX_MESSAGE_LENGTH - 3, "...", 3);
+      record->length_ = static_cast<uint16_t>(MAX_MESSAGE_LENGTH);
+    }
+
+    record->sequence_.store(pos + 1, std::memory_order_release);
+  }
+
+  void AsyncLogger_Impl::flush()
+  {
+    const size_t target_pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    flush_requested_pos_ = std::max(flush_requested_pos_, target_pos);
+    wakeup_cv_.notify_all();
+    flushed_cv_.wait(lock, [this, target_pos]() { return stopped_ || (delivered_pos_ >= target_pos); });
+  }
+
+  ////////////////////////////////////////////////
+  // Background thread
+  ////////////////////////////////////////////////
+
+  void AsyncLogger_Impl::run()
+  {
+    logger::LogLevel log_level;
+    std::string      message;
+    message.reserve(MAX_MESSAGE_LENGTH);
+
+    for (;;)
+    {
+      while (pop(log_level, message))
+        deliver(log_level, message);
+
+      reportDropped();
+
+      const auto now = std::chrono::steady_clock::now();
+      if (now - last_repetition_sweep_ >= std::chrono::nanoseconds(setting_.repetition_window_))
+      {
+        reportSuppressed(true);
+        last_repetition_sweep_ = now;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      delivered_pos_ = dequeue_pos_.load(std::memory_order_relaxed);
+      flushed_cv_.notify_all();
+
+      if (stopped_)
+        break;
+
+      // Producers don't notify us, so we poll with a short timeout
+      wakeup_cv_.wait_for(lock, std::chrono::milliseconds(10), [this]() { return stopped_ || (flush_requested_pos_ > delivered_pos_); });
+    }
+
+    // Drain what has been logged until the stop and summarize everything
+    while (pop(log_level, message))
+      deliver(log_level, message);
+    reportSuppressed(false);
+    reportDropped();
+  }
+
+  bool AsyncLogger_Impl::pop(logger::LogLevel& log_level, std::string& message)
+  {
+    const size_t pos    = dequeue_pos_.load(std::memory_order_relaxed);
+    Record&      record = ring_[pos & ring_mask_];
+
+    if (record.sequence_.load(std::memory_order_acquire) != pos + 1)
+      return false; // Empty, or a producer is still writing the message
+
+    log_level = record.log_level_;
+    message.assign(record.text_.data(), record.length_);
+
+    // Release the slot for the next round
+    record.sequence_.store(pos + ring_mask_ + 1, std::memory_order_release);
+    dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  void AsyncLogger_Impl::deliver(logger::LogLevel log_level, const std::string& message)
+  {
+    if (setting_.max_repetitions_ == 0)
+    {
+      callSink(log_level, message);
+      return;
+    }
+
+    const auto  now = std::chrono::steady_clock::now();
+    std::string key = message;
+    key.push_back(static_cast<char>(log_level));
+
+    auto repetition_it = repetitions_.find(key);
+    if (repetition_it == repetitions_.end())
+    {
+      repetitions_.emplace(std::move(key), RepetitionState{now, 1, 0});
+      callSink(log_level, message);
+      return;
+    }
+
+    RepetitionState& state = repetition_it->second;
+    if (now - state.window_start_ >= std::chrono::nanoseconds(setting_.repetition_window_))
+    {
+      if (state.suppressed_ > 0)
+        callSink(log_level, "Suppressed " + std::to_string(state.suppressed_) + " repetitions of: " + message);
+
+      state = RepetitionState{now, 0, 0};
+    }
+
+    if (state.count_ < setting_.max_repetitions_)
+    {
+      state.count_++;
+      callSink(log_level, message);
+    }
+    else
+    {
+      state.suppressed_++;
+      suppressed_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void AsyncLogger_Impl::reportSuppressed(bool expired_only)
+  {
+    const auto now = std::chrono::steady_clock::now();
+
+    for (auto repetition_it = repetitions_.begin(); repetition_it != repetitions_.end();)
+    {
+      const RepetitionState& state = repetition_it->second;
+      if (expired_only && (now - state.window_start_ < std::chrono::nanoseconds(setting_.repetition_window_)))
+      {
+        repetition_it++;
+        continue;
+      }
+
+      if (state.suppressed_ > 0)
+      {
+        const std::string&     key       = repetition_it->first;
+        const logger::LogLevel log_level = static_cast<logger::LogLevel>(key.back());
+        callSink(log_level, "Suppressed " + std::to_string(state.suppressed_) + " repetitions of: " + key.substr(0, key.size() - 1));
+      }
+
+      repetition_it = repetitions_.erase(repetition_it);
+    }
+  }
+
+  void AsyncLogger_Impl::reportDropped()
+  {
+    const uint64_t dropped_count = dropped_count_.load(std::memory_order_relaxed);
+    if (dropped_count == dropped_count_reported_)
+      return;
+
+    callSink(logger::LogLevel::Warning, "AsyncLogger: Ring buffer full, dropped " + std::to_string(dropped_count - dropped_count_reported_) + " messages");
+    dropped_count_reported_ = dropped_count;
+  }
+
+  void AsyncLogger_Impl::callSink(logger::LogLevel log_level, const std::string& message)
+  {
+    try
+    {
+      sink_(log_level, message);
+    }
+    catch (...)
+    {
+      // A failing sink must not terminate the background thread
+    }
+  }
+}
@@ -0,0 +1,123 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <tcp_pubsub/async_logger.h>
+
+namespace tcp_pubsub
+{
+  class AsyncLogger_Impl
+  {
+  ////////////////////////////////////////////////
+  // Types
+  ////////////////////////////////////////////////
+  private:
+    static constexpr size_t MAX_MESSAGE_LENGTH = 240;
+
+    // One slot of the ring buffer. The sequence number tells producers and
+    // the consumer whether the slot is free or holds a message of the current
+    // round (bounded MPMC queue as described by Dmitry Vyukov).
+    struct Record
+    {
+      std::atomic<size_t>                   sequence_;
+      logger::LogLevel                      log_level_;
+      uint16_t                              length_;
+      std::array<char, MAX_MESSAGE_LENGTH>  text_;
+    };
+
+    struct RepetitionState
+    {
+      std::chrono::steady_clock::time_point window_start_;
+      size_t                                count_;
+      uint64_t                              suppressed_;
+    };
+
+  ////////////////////////////////////////////////
+  // Constructor & Destructor
+  ////////////////////////////////////////////////
+  public:
+    AsyncLogger_Impl(const logger::logger_t& sink, const AsyncLoggerSetting& setting);
+
+    // Copy
+    AsyncLogger_Impl(const AsyncLogger_Impl&)            = delete;
+    AsyncLogger_Impl& operator=(const AsyncLogger_Impl&) = delete;
+
+    // Move
+    AsyncLogger_Impl& operator=(AsyncLogger_Impl&&)      = delete;
+    AsyncLogger_Impl(AsyncLogger_Impl&&)                 = delete;
+
+    ~AsyncLogger_Impl();
+
+  public:
+    void start();
+    void stop();
+
+  ////////////////////////////////////////////////
+  // API
+  ////////////////////////////////////////////////
+  public:
+    // Copies the message into the ring buffer. Never blocks.
+    void push(logger::LogLevel log_level, const std::string& message);
+
+    void flush();
+
+    uint64_t getDroppedCount()    const { return dropped_count_; }
+    uint64_t getSuppressedCount() const { return suppressed_count_; }
+
+  ////////////////////////////////////////////////
+  // Background thread
+  ////////////////////////////////////////////////
+  private:
+    void run();
+
+    bool pop(logger::LogLevel& log_level, std::string& message);
+    void deliver(logger::LogLevel log_level, const std::string& message);
+    void reportSuppressed(bool expired_only);
+    void reportDropped();
+    void callSink(logger::LogLevel log_level, const std::string& message);
+
+  ////////////////////////////////////////////////
+  // Member variables
+  ////////////////////////////////////////////////
+  private:
+    const logger::logger_t      sink_;
+    const AsyncLoggerSetting    setting_;
+
+    // Ring buffer
+    const size_t                ring_mask_;
+    std::unique_ptr<Record[]>   ring_;
+    std::atomic<size_t>         enqueue_pos_;
+    std::atomic<size_t>         dequeue_pos_;
+
+    // Statistics
+    std::atomic<uint64_t>       dropped_count_;
+    std::atomic<uint64_t>       suppressed_count_;
+    uint64_t                    dropped_count_reported_;                    /// Only accessed by the background thread
+
+    // Rate limit (only accessed by the background thread)
+    std::unordered_map<std::string, RepetitionState> repetitions_;
+    std::chrono::steady_clock::time_point            last_repetition_sweep_;
+
+    // Background thread
+    std::thread                 thread_;
+    std::mutex                  mutex_;
+    std::condition_variable     wakeup_cv_;                                 /// Wakes up the background thread for stopping and flushing. Producers don't notify it, as that would mean locking the mutex.
+    std::condition_variable     flushed_cv_;
+    bool                        stopped_;
+    size_t                      flush_requested_pos_;
+    size_t                      delivered_pos_;
+  };
+}
@@ -0,0 +1,22 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace tcp_pubsub
+{
+#pragma pack(push,1)
+  // This message shall always contain little endian numbers.
+  //
+  // Sent by a subscriber to a reliable publisher after it has consumed
+  // messages. The publisher may send the given amount of additional messages
+  // and bytes (header + payload).
+  struct CreditGrantMessage
+  {
+    uint64_t          messages = 0;
+    uint64_t          bytes    = 0;
+  };
+#pragma pack(pop)
+}
@@ -0,0 +1,68 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "deduplication_window.h"
+
+#include <algorithm>
+
+namespace tcp_pubsub
+{
+  DeduplicationWindow::DeduplicationWindow(size_t window_size)
+    : bits_                    ((std::max(window_size, size_t(64)) + 63) / 64, 0)
+    , window_size_             (bits_.size() * 64)
+    , greatest_sequence_number_(0)
+  {}
+
+  bool DeduplicationWindow::insert(uint64_t sequence_number)
+  {
+    if (sequence_number > greatest_sequence_number_)
+    {
+      // Move the window forward. The bits of the numbers we skip must be
+      // cleared, as they still belong to numbers that left the window.
+      if ((greatest_sequence_number_ == 0) || (sequence_number - greatest_sequence_number_ >= window_size_))
+      {
+        std::fill(bits_.begin(), bits_.end(), 0);
+      }
+      else
+      {
+        for (uint64_t skipped = greatest_sequence_number_ + 1; skipped < sequence_number; skipped++)
+          set(skipped, false);
+      }
+
+      greatest_sequence_number_ = sequence_number;
+      set(sequence_number, true);
+      return false;
+    }
+
+    if (greatest_sequence_number_ - sequence_number >= window_size_)
+      return true;
+
+    if (isSet(sequence_number))
+      return true;
+
+    set(sequence_number, true);
+    return false;
+  }
+
+  void DeduplicationWindow::clear()
+  {
+    std::fill(bits_.begin(), bits_.end(), 0);
+    greatest_sequence_number_ = 0;
+  }
+
+  bool DeduplicationWindow::isSet(uint64_t sequence_number) const
+  {
+    const uint64_t bit = sequence_number % window_size_;
+    return ((bits_[bit / 64] >> (bit % 64)) & 1) != 0;
+  }
+
+  void DeduplicationWindow::set(uint64_t sequence_number, bool value)
+  {
+    const uint64_t bit  = sequence_number % window_size_;
+    const uint64_t mask = uint64_t(1) << (bit % 64);
+    if (value)
+      bits_[bit / 64] |= mask;
+    else
+      bits_[bit / 64] &= ~mask;
+  }
+}
@@ -0,0 +1,47 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Remembers which sequence numbers have been passed on recently
+   *
+   * Redundant publishers do not necessarily deliver the same messages, e.g.
+   * a best-effort session may have dropped a message that another session
+   * still delivers later. Therefore it is not enough to compare a number with
+   * the greatest number seen so far. The window keeps one bit for each of
+   * the last window_size numbers below the greatest one, so a number that
+   * has not been seen before is passed on, even if it arrives late.
+   *
+   * Numbers that are older than the window are treated as duplicates.
+   *
+   * The window is not thread safe.
+   */
+  class DeduplicationWindow
+  {
+  public:
+    explicit DeduplicationWindow(size_t window_size = 4096);
+
+  public:
+    // Returns true, if the number has been inserted before or is too old to
+    // tell. Otherwise, the number is remembered and false is returned.
+    bool insert(uint64_t sequence_number);
+    void clear();
+
+  private:
+    bool isSet(uint64_t sequence_number) const;
+    void set  (uint64_t sequence_number, bool value);
+
+  private:
+    std::vector<uint64_t> bits_;                /// Ring of bits, the bit of a number is at sequence_number % window size
+    uint64_t              window_size_;
+    uint64_t              greatest_sequence_number_;
+  };
+}
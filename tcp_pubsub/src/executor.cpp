@@ -17,4 +17,16 @@ namespace tcp_pubsub
   {
     executor_impl_->stop();
   }
-}
\ No newline at end of file
+
+  void Executor::setLogLevel(logger::LogLevel log_level)
+    { executor_impl_->setLogLevel(log_level); }
+
+  logger::LogLevel Executor::getLogLevel() const
+    { return executor_impl_->getLogLevel(); }
+
+  std::string Executor::getPrometheusStatistics() const
+    { return executor_impl_->getPrometheusStatistics(); }
+
+  void Executor::setStatisticsFile(const std::string& path, std::chrono::milliseconds interval)
+    { executor_impl_->setStatisticsFile(path, interval); }
+}
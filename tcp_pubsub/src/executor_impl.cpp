@@ -4,29 +4,37 @@
 #include "executor_impl.h"
 #include <sys/prctl.h>
 
+#include <cstdio>
+#include <fstream>
+
 namespace tcp_pubsub
 {
   Executor_Impl::Executor_Impl(const logger::logger_t& log_function)
-    : log_(log_function)
+#ifdef NDEBUG
+    : log_level_(std::make_shared<std::atomic<logger::LogLevel>>(logger::LogLevel::Info))
+#else
+    : log_level_(std::make_shared<std::atomic<logger::LogLevel>>(logger::LogLevel::DebugVerbose))
+#endif // NDEBUG
+    , log_(log_function, log_level_)
     , io_service_(std::make_shared<asio::io_service>())
     , dummy_work_(std::make_shared<asio::io_service::work>(*io_service_))
+    , statistics_file_timer_(*io_service_)
+    , statistics_file_interval_(0)
+    , statistics_file_generation_(0)
   {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Executor: Creating Executor.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Executor: Creating Executor.");
 #endif
   }
 
   Executor_Impl::~Executor_Impl()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    std::stringstream ss;
-    ss << std::this_thread::get_id();
-    std::string thread_id = ss.str();
-    log_(logger::LogLevel::DebugVerbose, "Executor: Deleting from thread " + thread_id + "...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Executor: Deleting from thread " + logger::threadIdString() + "...");
 #endif
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Executor: Waiting for IoService threads to shut down...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Executor: Waiting for IoService threads to shut down...");
 #endif
 
     // Detach all threads and clear the thread pool
@@ -40,30 +48,26 @@ namespace tcp_pubsub
     thread_pool_.clear();
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Executor: All IoService threads have shut down successfully.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Executor: All IoService threads have shut down successfully.");
 #endif
 
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Executor: Deleted.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Executor: Deleted.");
 #endif
   }
 
   void Executor_Impl::start(size_t thread_count)
   {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Executor: Starting Executor with " + std::to_string(thread_count) + " threads.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Executor: Starting Executor with " + std::to_string(thread_count) + " threads.");
 #endif
     for (size_t i = 0; i < thread_count; i++)
     {
       thread_pool_.emplace_back([me = shared_from_this(), i]()
                                 {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                                  std::stringstream ss;
-                                  ss << std::this_thread::get_id();
-                                  std::string thread_id = ss.str();
-
-                                  me->log_(logger::LogLevel::Debug, "Executor: IoService::Run() in thread " + thread_id);
+                                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "Executor: IoService::Run() in thread " + logger::threadIdString());
 #endif
 
                                   std::ostringstream thread_comm_name;
@@ -72,7 +76,7 @@ namespace tcp_pubsub
                                   me->io_service_->run();
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                                  me->log_(logger::LogLevel::Debug, "Executor: IoService: Shutdown of thread " + thread_id);
+                                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "Executor: IoService: Shutdown of thread " + logger::threadIdString());
 #endif
                                 });
     }
@@ -81,9 +85,19 @@ namespace tcp_pubsub
   void Executor_Impl::stop()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Executor::stop()");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Executor::stop()");
 #endif
 
+    // Stop writing the statistics file
+    {
+      std::lock_guard<std::mutex> statistics_file_lock(statistics_file_mutex_);
+      statistics_file_generation_++;
+      statistics_file_path_.clear();
+
+      asio::error_code ec;
+      statistics_file_timer_.cancel(ec);
+    }
+
     // Delete the dummy work
     dummy_work_.reset();
 
@@ -96,9 +110,109 @@ namespace tcp_pubsub
     return io_service_;
   }
 
-  logger::logger_t Executor_Impl::logFunction() const
+  logger::Logger Executor_Impl::logFunction() const
   {
     return log_;
   }
 
-}
\ No newline at end of file
+  void Executor_Impl::setLogLevel(logger::LogLevel log_level)
+  {
+    log_level_->store(log_level, std::memory_order_relaxed);
+  }
+
+  logger::LogLevel Executor_Impl::getLogLevel() const
+  {
+    return log_level_->load(std::memory_order_relaxed);
+  }
+
+  ////////////////////////////////////////////////
+  // Statistics
+  ////////////////////////////////////////////////
+
+  StatisticsRegistry& Executor_Impl::statisticsRegistry()
+  {
+    return statistics_registry_;
+  }
+
+  std::string Executor_Impl::getPrometheusStatistics()
+  {
+    return statistics_registry_.toPrometheusText();
+  }
+
+  void Executor_Impl::setStatisticsFile(const std::string& path, std::chrono::milliseconds interval)
+  {
+    std::lock_guard<std::mutex> statistics_file_lock(statistics_file_mutex_);
+
+    statistics_file_generation_++;
+    statistics_file_path_     = path;
+    statistics_file_interval_ = interval;
+
+    {
+      asio::error_code ec;
+      statistics_file_timer_.cancel(ec);
+    }
+
+    if (!statistics_file_path_.empty() && (statistics_file_interval_.count() > 0))
+    {
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Executor: Writing statistics to " + statistics_file_path_ + " every " + std::to_string(statistics_file_interval_.count()) + " ms.");
+#endif
+      scheduleStatisticsFileWrite(statistics_file_generation_);
+    }
+  }
+
+  void Executor_Impl::scheduleStatisticsFileWrite(uint64_t generation)
+  {
+    // Called with statistics_file_mutex_ locked. The handler only holds a weak
+    // reference, as the io_service (which owns the handler) is owned by us.
+    statistics_file_timer_.expires_after(statistics_file_interval_);
+    statistics_file_timer_.async_wait([weak_me = std::weak_ptr<Executor_Impl>(shared_from_this()), generation](asio::error_code ec)
+                                      {
+                                        if (ec)
+                                          return;
+
+                                        auto me = weak_me.lock();
+                                        if (!me)
+                                          return;
+
+                                        std::string path;
+                                        {
+                                          std::lock_guard<std::mutex> statistics_file_lock(me->statistics_file_mutex_);
+                                          if (generation != me->statistics_file_generation_)
+                                            return;
+                                          path = me->statistics_file_path_;
+                                        }
+
+                                        me->writeStatisticsFile(path);
+
+                                        std::lock_guard<std::mutex> statistics_file_lock(me->statistics_file_mutex_);
+                                        if (generation == me->statistics_file_generation_)
+                                          me->scheduleStatisticsFileWrite(generation);
+                                      });
+  }
+
+  void Executor_Impl::writeStatisticsFile(const std::string& path)
+  {
+    const std::string statistics = statistics_registry_.toPrometheusText();
+    const std::string temp_path  = path + ".tmp";
+
+    {
+      std::ofstream file(temp_path, std::ios::out | std::ios::trunc | std::ios::binary);
+      file << statistics;
+      file.close();
+
+      if (!file)
+      {
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "Executor: Failed writing statistics to " + temp_path + ".");
+        return;
+      }
+    }
+
+    // Renaming replaces the file atomically, so readers never see a partial file
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "Executor: Failed replacing statistics file " + path + ".");
+      std::remove(temp_path.c_str());
+    }
+  }
+}
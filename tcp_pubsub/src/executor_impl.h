@@ -8,10 +8,14 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 #include <asio.hpp>
 
 #include "tcp_pubsub_logger_abstraction.h"
+#include "statistics_registry.h"
 
 namespace tcp_pubsub
 {
@@ -34,19 +38,37 @@ namespace tcp_pubsub
     void stop();
 
     std::shared_ptr<asio::io_service> ioService()   const;
-    logger::logger_t                  logFunction() const;
+    logger::Logger                    logFunction() const;
 
+    void                              setLogLevel(logger::LogLevel log_level);
+    logger::LogLevel                  getLogLevel() const;
 
+    StatisticsRegistry&               statisticsRegistry();
+    std::string                       getPrometheusStatistics();
+    void                              setStatisticsFile(const std::string& path, std::chrono::milliseconds interval);
+
+  private:
+    void scheduleStatisticsFileWrite(uint64_t generation);
+    void writeStatisticsFile(const std::string& path);
 
   /////////////////////////////////////////
   // Member variables
   ////////////////////////////////////////
 
   private:
-    const logger::logger_t                  log_;             /// Logger
+    const std::shared_ptr<std::atomic<logger::LogLevel>> log_level_; /// Minimal level that is logged. Shared with all copies of log_.
+    const logger::Logger                    log_;             /// Logger
     std::shared_ptr<asio::io_service>       io_service_;      /// global io service
 
     std::vector<std::thread>                thread_pool_;     /// Asio threadpool executing the io servic
     std::shared_ptr<asio::io_service::work> dummy_work_;      /// Dummy work, so the io_service will never run out of work and shut down, even if there is no publisher or subscriber at the moment
+
+    // Statistics
+    StatisticsRegistry                      statistics_registry_;
+    std::mutex                              statistics_file_mutex_;
+    asio::steady_timer                      statistics_file_timer_;       /// [PROTECTED BY statistics_file_mutex_!]
+    std::string                             statistics_file_path_;        /// [PROTECTED BY statistics_file_mutex_!] File the statistics are written to periodically. Empty if disabled.
+    std::chrono::milliseconds               statistics_file_interval_;    /// [PROTECTED BY statistics_file_mutex_!]
+    uint64_t                                statistics_file_generation_;  /// [PROTECTED BY statistics_file_mutex_!] Incremented by each call to setStatisticsFile(), so a timer of a previous setting does not write anymore
   };
 }
@@ -0,0 +1,124 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "latency_histogram.h"
+
+namespace tcp_pubsub
+{
+  constexpr int    LatencyHistogram::sub_bucket_bits_;
+  constexpr int    LatencyHistogram::max_value_bits_;
+  constexpr size_t LatencyHistogram::bucket_count_;
+
+  LatencyHistogram::LatencyHistogram()
+    : count_ (0)
+    , sum_ns_(0)
+    , max_ns_(0)
+  {
+    for (auto& bucket : buckets_)
+      bucket.store(0, std::memory_order_relaxed);
+  }
+
+  int64_t LatencyHistogram::now()
+  {
+#if (TCP_PUBSUB_LATENCY_HISTOGRAMS_ENABLED)
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    return 0;
+#endif
+  }
+
+  void LatencyHistogram::recordSince(int64_t start_ns)
+  {
+#if (TCP_PUBSUB_LATENCY_HISTOGRAMS_ENABLED)
+    if (start_ns != 0)
+      record(now() - start_ns);
+#else
+    static_cast<void>(start_ns);
+#endif
+  }
+
+  void LatencyHistogram::record(int64_t value_ns)
+  {
+#if (TCP_PUBSUB_LATENCY_HISTOGRAMS_ENABLED)
+    if (value_ns < 0)
+      value_ns = 0;
+
+    buckets_[bucketIndex(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    count_ .fetch_add(1,        std::memory_order_relaxed);
+    sum_ns_.fetch_add(value_ns, std::memory_order_relaxed);
+
+    int64_t max_ns = max_ns_.load(std::memory_order_relaxed);
+    while ((value_ns > max_ns)
+          && !max_ns_.compare_exchange_weak(max_ns, value_ns, std::memory_order_relaxed))
+    {}
+#else
+    static_cast<void>(value_ns);
+#endif
+  }
+
+  void LatencyHistogram::add(const LatencyHistogramSnapshot& snapshot)
+  {
+    // The upper bound of a bucket maps back to the very same bucket
+    for (const auto& bucket : snapshot.buckets_)
+      buckets_[bucketIndex(bucket.first)].fetch_add(bucket.second, std::memory_order_relaxed);
+
+    count_ .fetch_add(snapshot.count_,  std::memory_order_relaxed);
+    sum_ns_.fetch_add(snapshot.sum_ns_, std::memory_order_relaxed);
+
+    int64_t max_ns = max_ns_.load(std::memory_order_relaxed);
+    while ((snapshot.max_ns_ > max_ns)
+          && !max_ns_.compare_exchange_weak(max_ns, snapshot.max_ns_, std::memory_order_relaxed))
+    {}
+  }
+
+  LatencyHistogramSnapshot LatencyHistogram::snapshot() const
+  {
+    LatencyHistogramSnapshot snapshot;
+    snapshot.count_  = count_ .load(std::memory_order_relaxed);
+    snapshot.sum_ns_ = sum_ns_.load(std::memory_order_relaxed);
+    snapshot.max_ns_ = max_ns_.load(std::memory_order_relaxed);
+
+    for (size_t index = 0; index < bucket_count_; index++)
+    {
+      const uint64_t count = buckets_[index].load(std::memory_order_relaxed);
+      if (count > 0)
+        snapshot.buckets_.emplace_back(bucketUpperBound(index), count);
+    }
+
+    return snapshot;
+  }
+
+  size_t LatencyHistogram::bucketIndex(int64_t value_ns)
+  {
+    const uint64_t sub_bucket_count = uint64_t(1) << sub_bucket_bits_;
+    const uint64_t max_value        = (uint64_t(1) << max_value_bits_) - 1;
+
+    uint64_t value = static_cast<uint64_t>(value_ns);
+    if (value > max_value)
+      value = max_value;
+
+    if (value < sub_bucket_count)
+      return static_cast<size_t>(value);
+
+    // Position of the highest bit decides the power of two, the following
+    // sub_bucket_bits_ bits decide the linear bucket within it.
+    int highest_bit = 0;
+    while ((value >> (highest_bit + 1)) != 0)
+      highest_bit++;
+
+    const int shift = highest_bit - sub_bucket_bits_;
+    return static_cast<size_t>(((shift + 1) << sub_bucket_bits_) + ((value >> shift) - sub_bucket_count));
+  }
+
+  int64_t LatencyHistogram::bucketUpperBound(size_t index)
+  {
+    const size_t sub_bucket_count = size_t(1) << sub_bucket_bits_;
+
+    if (index < sub_bucket_count)
+      return static_cast<int64_t>(index);
+
+    const int      shift      = static_cast<int>(index >> sub_bucket_bits_) - 1;
+    const uint64_t sub_bucket = (index & (sub_bucket_count - 1)) + sub_bucket_count;
+    return static_cast<int64_t>(((sub_bucket + 1) << shift) - 1);
+  }
+}
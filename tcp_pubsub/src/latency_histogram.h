@@ -0,0 +1,77 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+#include <tcp_pubsub/latency_statistics.h>
+
+//
+// Recording latencies costs a clock read and an atomic increment per
+// interval, so it has to be enabled explicitly (see the CMake option
+// TCP_PUBSUB_ENABLE_LATENCY_HISTOGRAMS).
+//
+#ifndef TCP_PUBSUB_LATENCY_HISTOGRAMS_ENABLED
+  #define TCP_PUBSUB_LATENCY_HISTOGRAMS_ENABLED 0
+#endif // !TCP_PUBSUB_LATENCY_HISTOGRAMS_ENABLED
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Fixed-size log-linear histogram of latencies in nanoseconds
+   *
+   * Values below 32 ns get a bucket of their own. Above that, each power of
+   * two is split into 32 linear buckets. Values of about 18 minutes and more
+   * end up in the last bucket.
+   *
+   * Recording is a single relaxed atomic increment (plus updating the sum and
+   * the maximum), so any thread can record without locking. Snapshots are not
+   * atomic as a whole, i.e. a value recorded concurrently may be missing from
+   * some of the fields.
+   */
+  class LatencyHistogram
+  {
+  public:
+    LatencyHistogram();
+
+    // Copy
+    LatencyHistogram(const LatencyHistogram&)            = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    // Move
+    LatencyHistogram& operator=(LatencyHistogram&&)      = delete;
+    LatencyHistogram(LatencyHistogram&&)                 = delete;
+
+  public:
+    // Returns the current time for starting an interval. 0 if histograms are disabled.
+    static int64_t now();
+
+    // Records the time since the given start time (see now())
+    void recordSince(int64_t start_ns);
+    void record(int64_t value_ns);
+
+    // Adds all values of the snapshot, e.g. to keep the values of a closed session
+    void add(const LatencyHistogramSnapshot& snapshot);
+
+    LatencyHistogramSnapshot snapshot() const;
+
+  private:
+    static size_t  bucketIndex(int64_t value_ns);
+    static int64_t bucketUpperBound(size_t index);
+
+  private:
+    static constexpr int    sub_bucket_bits_  = 5;                                      /// 32 linear buckets per power of two
+    static constexpr int    max_value_bits_   = 40;                                     /// ~18 minutes
+    static constexpr size_t bucket_count_     = (max_value_bits_ - sub_bucket_bits_ + 1) << sub_bucket_bits_;
+
+    std::array<std::atomic<uint64_t>, bucket_count_> buckets_;
+    std::atomic<uint64_t>                            count_;
+    std::atomic<int64_t>                             sum_ns_;
+    std::atomic<int64_t>                             max_ns_;
+  };
+}
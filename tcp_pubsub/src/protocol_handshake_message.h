@@ -7,11 +7,49 @@
 
 namespace tcp_pubsub
 {
+  enum class ReplayMode : uint8_t
+  {
+    All                 = 0, // The entire transient local history. Subscribers that only send the protocol version get this.
+    None                = 1,
+    LastN               = 2, // The last replay_count messages
+    SinceTime           = 3, // All messages published at or after replay_since_ns
+    AfterSequenceNumber = 4, // All messages with a sequence number greater than replay_sequence_number
+  };
+
 #pragma pack(push,1)
   // This message shall always contain little endian numbers.
+  //
+  // Older subscribers only send the protocol_version. All fields that have
+  // not been sent keep their default values.
   struct ProtocolHandshakeMessage
   {
-    uint8_t           protocol_version     = 0;
+    uint8_t           protocol_version       = 0;
+
+    // Transient local history requested by the subscriber. Ignored by subscribers.
+    ReplayMode        replay_mode            = ReplayMode::All;
+    uint64_t          replay_count           = 0;
+    int64_t           replay_since_ns        = 0;   // System clock, nanoseconds since epoch
+    uint64_t          replay_sequence_number = 0;
+
+    // Request: Publisher instance the replay_sequence_number belongs to (0 if unknown).
+    // Response: Instance id of the publisher. Changes when the publisher is restarted without journal.
+    uint64_t          publisher_instance_id  = 0;
+
+    // Request: Credit window the subscriber grants to reliable publishers. 0 if the subscriber does not send credit.
+    // Response: Credit window the reliable publisher uses. It may be smaller than the requested one.
+    uint64_t          credit_window_messages = 0;
+    uint64_t          credit_window_bytes    = 0;   // 0 means unlimited
+
+    // Response: 1 if the publisher never drops messages and needs credit from the subscriber
+    uint8_t           reliable               = 0;
+
+    // Request: Minimum time between two live messages the subscriber wants to receive. 0 means no limit. Ignored by reliable publishers.
+    uint64_t          min_interval_ns        = 0;
+
+    // 1 if the sender supports TcpHeaders with a sequence_number. All messages
+    // after the handshake use them, if both peers have set this. Older peers
+    // only know the short header and can only read the handshake and payload.
+    uint8_t           sequence_number_header = 0;
   };
 #pragma pack(pop)
 }
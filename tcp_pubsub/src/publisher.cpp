@@ -9,13 +9,21 @@
 namespace tcp_pubsub
 {
   Publisher::Publisher(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting, const std::string& address, uint16_t port)
-    : publisher_impl_(std::make_shared<Publisher_Impl>(executor, transient_local_setting))
+    : Publisher(executor, transient_local_setting, PublisherReliableSetting(), address, port)
+  {}
+
+  Publisher::Publisher(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting, uint16_t port)
+    : Publisher(executor, transient_local_setting, "0.0.0.0", port)
+  {}
+
+  Publisher::Publisher(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting, const PublisherReliableSetting& reliable_setting, const std::string& address, uint16_t port)
+    : publisher_impl_(std::make_shared<Publisher_Impl>(executor, transient_local_setting, reliable_setting))
   {
     publisher_impl_->start(address, port);
   }
 
-  Publisher::Publisher(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting, uint16_t port)
-    : Publisher(executor, transient_local_setting, "0.0.0.0", port)
+  Publisher::Publisher(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting, const PublisherReliableSetting& reliable_setting, uint16_t port)
+    : Publisher(executor, transient_local_setting, reliable_setting, "0.0.0.0", port)
   {}
 
   Publisher::~Publisher()
@@ -27,14 +35,41 @@ namespace tcp_pubsub
   size_t Publisher::getSubscriberCount() const
     { return publisher_impl_->getSubscriberCount(); }
 
+  std::vector<PublisherSessionStatistics> Publisher::getSessionStatistics() const
+    { return publisher_impl_->getSessionStatistics(); }
+
   bool Publisher::isRunning() const
   { return publisher_impl_->isRunning(); }
 
   bool Publisher::send(const char* const data, size_t size) const
-    { return this->send({ {data, size} }); }
+  {
+    const std::pair<const char* const, const size_t> payload(data, size);
+    return publisher_impl_->send(&payload, &payload + 1, false, 0, 0);
+  }
 
   bool Publisher::send(const std::vector<std::pair<const char* const, const size_t>>& payloads) const
-    { return publisher_impl_->send(payloads); }
+    { return publisher_impl_->send(payloads.data(), payloads.data() + payloads.size(), false, 0, 0); }
+
+  bool Publisher::send(uint64_t key, const char* const data, size_t size) const
+  {
+    const std::pair<const char* const, const size_t> payload(data, size);
+    return publisher_impl_->send(&payload, &payload + 1, true, key, 0);
+  }
+
+  bool Publisher::send(uint64_t key, const std::vector<std::pair<const char* const, const size_t>>& payloads) const
+    { return publisher_impl_->send(payloads.data(), payloads.data() + payloads.size(), true, key, 0); }
+
+  bool Publisher::sendWithSequenceNumber(uint64_t sequence_number, const std::vector<std::pair<const char* const, const size_t>>& payloads) const
+    { return publisher_impl_->send(payloads.data(), payloads.data() + payloads.size(), false, 0, sequence_number); }
+
+  bool Publisher::sendInPlace(size_t size, const std::function<void(char* data, size_t size)>& writer) const
+    { return publisher_impl_->sendInPlace(size, writer, false, 0); }
+
+  bool Publisher::sendInPlace(uint64_t key, size_t size, const std::function<void(char* data, size_t size)>& writer) const
+    { return publisher_impl_->sendInPlace(size, writer, true, key); }
+
+  void Publisher::setRpcHandler(const RpcHandler& rpc_handler)
+    { publisher_impl_->setRpcHandler(rpc_handler); }
 
   void Publisher::cancel()
     { publisher_impl_->cancel(); }
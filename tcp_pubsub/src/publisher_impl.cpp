@@ -7,31 +7,91 @@
 #include "portable_endian.h"
 
 #include "executor_impl.h"
+#include "trace_points.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <random>
 
 namespace tcp_pubsub
 {
+  namespace
+  {
+    // Resolution of the coarse clock used for the transient local history
+    constexpr std::chrono::milliseconds transient_local_clock_resolution(10);
+
+    uint64_t createPublisherInstanceId()
+    {
+      std::random_device random_device;
+      std::mt19937_64    generator((static_cast<uint64_t>(random_device()) << 32) ^ random_device()
+                                   ^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+
+      // 0 is reserved for "unknown"
+      uint64_t instance_id = 0;
+      while (instance_id == 0)
+        instance_id = generator();
+      return instance_id;
+    }
+  }
 
   ////////////////////////////////////////////////
   // Constructor & Destructor
   ////////////////////////////////////////////////
   
   // Constructor
-  Publisher_Impl::Publisher_Impl(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting)
+  Publisher_Impl::Publisher_Impl(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting, const PublisherReliableSetting& reliable_setting)
     : is_running_     (false)
     , executor_       (executor)
     , acceptor_       (*executor_->executor_impl_->ioService())
     , log_            (executor_->executor_impl_->logFunction())
+    , reliable_setting_(reliable_setting)
+    , next_sequence_number_(1)
+    , next_send_ticket_    (0)
+    , instance_id_    (createPublisherInstanceId())
+    , published_messages_(0)
+    , published_bytes_(0)
+    , evicted_sessions_(0)
+    , closed_sessions_dropped_buffers_(0)
+    , closed_sessions_downsampled_buffers_(0)
     , transient_local_setting_(transient_local_setting)
-  {}
+    , transient_local_buffers_      (transient_local_setting.keyed_ ? 0 : transient_local_setting.buffer_max_count_, transient_local_setting.lifespan_, transient_local_setting.buffer_max_bytes_)
+    , transient_local_keyed_buffers_(transient_local_setting.keyed_ ? transient_local_setting.buffer_max_count_ : 0, transient_local_setting.lifespan_, transient_local_setting.buffer_max_bytes_)
+    , transient_local_maintenance_timer_(*executor_->executor_impl_->ioService())
+    , transient_local_steady_now_ns_(0)
+    , transient_local_system_now_ns_(0)
+    , transient_local_history_version_(0)
+  {
+    updateTransientLocalClock();
+
+    if ((transient_local_setting_.buffer_max_count_ > 0) && !transient_local_setting_.journal_path_.empty())
+    {
+      if (transient_local_setting_.keyed_)
+      {
+        // The journal does not store keys, so we could not rebuild the keyed history from it
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "Publisher: The transient local journal is not supported in keyed mode. Ignoring journal " + transient_local_setting_.journal_path_ + ".");
+      }
+      else
+      {
+        transient_local_journal_ = std::make_unique<TransientLocalJournal>(transient_local_setting_.journal_path_
+                                                                         , transient_local_setting_.buffer_max_count_
+                                                                         , transient_local_setting_.journal_size_bytes_
+                                                                         , instance_id_
+                                                                         , log_);
+
+        // The restored samples keep their sequence numbers, so we also have
+        // to keep the instance id they belong to.
+        instance_id_ = transient_local_journal_->publisherInstanceId();
+        restoreTransientLocalJournal();
+      }
+    }
+  }
 
   // Destructor
   Publisher_Impl::~Publisher_Impl()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    std::stringstream ss;
-    ss << std::this_thread::get_id();
-    std::string thread_id = ss.str();
-    log_(logger::LogLevel::DebugVerbose, "Publisher " + localEndpointToString() + ": Deleting from thread " + thread_id + "...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher " + localEndpointToString() + ": Deleting from thread " + logger::threadIdString() + "...");
 #endif
 
     if (is_running_)
@@ -40,7 +100,7 @@ namespace tcp_pubsub
     }
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "Publisher " + localEndpointToString() + ": Deleted.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher " + localEndpointToString() + ": Deleted.");
 #endif
   }
 
@@ -51,7 +111,7 @@ namespace tcp_pubsub
   bool Publisher_Impl::start(const std::string& address, uint16_t port)
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "Publisher: Parsing address " + address + ":" + std::to_string(port) + ".");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher: Parsing address " + address + ":" + std::to_string(port) + ".");
 #endif
 
     // set up the acceptor to listen on the tcp port
@@ -59,12 +119,12 @@ namespace tcp_pubsub
     asio::ip::tcp::endpoint endpoint(asio::ip::make_address(address, make_address_ec), port);
     if (make_address_ec)
     {
-      log_(logger::LogLevel::Error,  "Publisher: Error parsing address \"" + address + ":" + std::to_string(port) + "\": " + make_address_ec.message());
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error,  "Publisher: Error parsing address \"" + address + ":" + std::to_string(port) + "\": " + make_address_ec.message());
       return false;
     }
     
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Opening acceptor.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Opening acceptor.");
 #endif
 
     {
@@ -72,13 +132,13 @@ namespace tcp_pubsub
       acceptor_.open(endpoint.protocol(), ec);
       if (ec)
       {
-        log_(logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error opening acceptor: " + ec.message());
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error opening acceptor: " + ec.message());
         return false;
       }
     }
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Setting \"reuse_address\" option.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Setting \"reuse_address\" option.");
 #endif
 
     {
@@ -86,13 +146,13 @@ namespace tcp_pubsub
       acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true), ec);
       if (ec)
       {
-        log_(logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error setting reuse_address option : " + ec.message());
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error setting reuse_address option : " + ec.message());
         return false;
       }
     }
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Binding acceptor to the endpoint.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Binding acceptor to the endpoint.");
 #endif
 
     {
@@ -100,13 +160,13 @@ namespace tcp_pubsub
       acceptor_.bind(endpoint, ec);
       if (ec)
       {
-        log_(logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error binding acceptor: " + ec.message());
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error binding acceptor: " + ec.message());
         return false;
       }
     }
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Listening on acceptor.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher " + toString(endpoint) + ": Listening on acceptor.");
 #endif
 
     {
@@ -114,15 +174,20 @@ namespace tcp_pubsub
       acceptor_.listen(asio::socket_base::max_listen_connections, ec);
       if (ec)
       {
-        log_(logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error listening on acceptor: " + ec.message());
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "Publisher " + toString(endpoint) + ": Error listening on acceptor: " + ec.message());
         return false;
       }
     }
 
-    log_(logger::LogLevel::Info, "Publisher " + toString(endpoint) + ": Created publisher and waiting for clients.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Info, "Publisher " + toString(endpoint) + ": Created publisher and waiting for clients.");
 
     is_running_ = true;
 
+    registerStatistics();
+
+    if (transient_local_setting_.buffer_max_count_ > 0)
+      scheduleTransientLocalMaintenance();
+
     acceptClient();
 
     return true;
@@ -132,7 +197,7 @@ namespace tcp_pubsub
   {
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Publisher " + localEndpointToString() + ": Shutting down");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Publisher " + localEndpointToString() + ": Shutting down");
 #endif
 
     {
@@ -143,6 +208,12 @@ namespace tcp_pubsub
 
     is_running_ = false;
 
+    {
+      std::lock_guard<std::mutex> maintenance_lock(transient_local_maintenance_mutex_);
+      asio::error_code ec;
+      transient_local_maintenance_timer_.cancel(ec);
+    }
+
     std::vector<std::shared_ptr<PublisherSession>> publisher_sessions;
     {
       // Copy the list, so we can safely iterate over it without locking the mutex
@@ -158,7 +229,7 @@ namespace tcp_pubsub
   void Publisher_Impl::acceptClient()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Publisher " + localEndpointToString() + ": Waiting for new client...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Publisher " + localEndpointToString() + ": Waiting for new client...");
 #endif
 
     std::function<void(const std::shared_ptr<PublisherSession>&)> publisher_session_closed_handler
@@ -169,14 +240,19 @@ namespace tcp_pubsub
                 auto session_it = std::find(me->publisher_sessions_.begin(), me->publisher_sessions_.end(), session);
                 if (session_it != me->publisher_sessions_.end())
                 {
+                  // Keep the statistics of the session, so the publisher's counters never decrease
+                  me->closed_sessions_dropped_buffers_    .fetch_add(session->getDroppedBufferCount(),     std::memory_order_relaxed);
+                  me->closed_sessions_downsampled_buffers_.fetch_add(session->getDownsampledBufferCount(), std::memory_order_relaxed);
+                  me->closed_sessions_publish_to_write_histogram_.add(session->getStatistics().publish_to_write_);
+
                   me->publisher_sessions_.erase(session_it);
             #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                  me->log_(logger::LogLevel::Debug, "Publisher " + me->localEndpointToString() + ": Successfully removed Session to subscriber " + session->remoteEndpointToString() + ". Current subscriber count: " + std::to_string(me->publisher_sessions_.size()) + ".");
+                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "Publisher " + me->localEndpointToString() + ": Successfully removed Session to subscriber " + session->remoteEndpointToString() + ". Current subscriber count: " + std::to_string(me->publisher_sessions_.size()) + ".");
             #endif
                 }
                 else
                 {
-                  me->log_(logger::LogLevel::Error,  "Publisher " + me->localEndpointToString() + ": Trying to delete a non-existing publisher session.");
+                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "Publisher " + me->localEndpointToString() + ": Trying to delete a non-existing publisher session.");
                 }
               };
 
@@ -187,32 +263,26 @@ namespace tcp_pubsub
                 if (me->transient_local_setting_.buffer_max_count_ == 0) {
                   return;
                 }
-                std::vector<std::shared_ptr<std::vector<char>>> buffers_to_send;
-                size_t buffers_full_size = 0;
-                {
-                  std::lock_guard<std::mutex> lk(me->transient_local_mtx_);
-                  me->purgeExpiredTransientLocalBuffers(me->transient_local_buffers_, std::chrono::steady_clock::now());
-                  buffers_to_send.reserve(me->transient_local_buffers_.size());
-                  for (auto &buffer : me->transient_local_buffers_)
-                  {
-                    buffers_to_send.push_back(buffer.buffer_);
-                    buffers_full_size += buffer.buffer_->size();
-                  }
-                }
-                if (buffers_to_send.empty()) return;
-                // session can not continously send buffers, it will drop next send if previous one not confirmed to be written to OS.
-                // so we have to concat these buffers, then send them together to TCP stream.
-                auto big_buffer = std::make_shared<std::vector<char>>();
-                big_buffer->reserve(buffers_full_size);
-                for (auto& buffer : buffers_to_send) {
-                  big_buffer->insert(big_buffer->end(), buffer->begin(), buffer->end());
+                if (session->handshakeRequest().replay_mode == ReplayMode::None) {
+                  return;
                 }
-                if (big_buffer->empty()) return;
-                session->pushTransientBuffer(big_buffer);
+                const auto now_tp   = std::chrono::steady_clock::now();
+                const auto snapshot = me->transientLocalSnapshot(now_tp);
+                if (snapshot.buffers_->empty()) return;
+                // The session streams the buffers as they are (i.e. without
+                // copying them), right after the handshake response. It only
+                // sends the part of the history the subscriber has asked for.
+                session->pushTransientBuffers(snapshot.buffers_, me->transientLocalReplayBegin(snapshot, session->handshakeRequest(), now_tp));
+              };
+
+    std::function<void(const std::shared_ptr<PublisherSession>&, const std::shared_ptr<std::vector<char>>&, uint64_t)> rpc_request_handler
+            = [me = shared_from_this()](const std::shared_ptr<PublisherSession>& session, const std::shared_ptr<std::vector<char>>& request, uint64_t correlation_id) -> void
+              {
+                me->handleRpcRequest(session, request, correlation_id);
               };
 
     // Create a new session
-    auto session = std::make_shared<PublisherSession>(executor_->executor_impl_->ioService(), publisher_session_closed_handler, transient_local_push_handler, log_);
+    auto session = std::make_shared<PublisherSession>(executor_->executor_impl_->ioService(), publisher_session_closed_handler, transient_local_push_handler, rpc_request_handler, instance_id_, reliable_setting_.enabled_, reliable_setting_.max_credit_window_messages_, reliable_setting_.max_credit_window_bytes_, transient_local_setting_.replay_max_bytes_per_second_, log_);
     acceptor_.async_accept(session->getSocket()
                           , [session, me = shared_from_this()](asio::error_code ec)
                           {
@@ -221,22 +291,25 @@ namespace tcp_pubsub
                               auto logger_level = logger::LogLevel::Error;
                               if (ec.value() == static_cast<int>(std::errc::operation_canceled))
                                 logger_level = logger::LogLevel::Info;
-                              me->log_(logger_level, "Publisher " + me->localEndpointToString() + ": Error while waiting for subsriber: " + ec.message());
+                              TCP_PUBSUB_LOG(me->log_, logger_level, "Publisher " + me->localEndpointToString() + ": Error while waiting for subsriber: " + ec.message());
                               return;
                             }
                             else
                             {
-                              me->log_(logger::LogLevel::Info, "Publisher " + me->localEndpointToString() + ": Subscriber " + session->remoteEndpointToString() + " has connected.");
+                              TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Info, "Publisher " + me->localEndpointToString() + ": Subscriber " + session->remoteEndpointToString() + " has connected.");
                             }
 
                             session->start();
 
-                            // Add the session to the session list
+                            // Add the session to the session list. It receives all
+                            // messages that have not been numbered yet.
                             {
+                              std::lock_guard<std::mutex> send_order_lock(me->send_order_mutex_);
                               std::lock_guard<std::mutex> publisher_sessions_lock_(me->publisher_sessions_mutex_);
+                              session->setNextSendTicket(me->next_send_ticket_);
                               me->publisher_sessions_.push_back(session);
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                              me->log_(logger::LogLevel::Debug, "Publisher " + me->localEndpointToString() + ": Current subscriber count: " + std::to_string(me->publisher_sessions_.size()));
+                              TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "Publisher " + me->localEndpointToString() + ": Current subscriber count: " + std::to_string(me->publisher_sessions_.size()));
 #endif
                             }
 
@@ -249,14 +322,21 @@ namespace tcp_pubsub
   // Send data
   ////////////////////////////////////////////////
 
-  bool Publisher_Impl::send(const std::vector<std::pair<const char* const, const size_t>>& payloads)
+  template <typename PayloadWriter>
+  bool Publisher_Impl::sendBuffer(size_t entire_payload_size, const PayloadWriter& write_payload, bool has_key, uint64_t key, uint64_t sequence_number)
   {
     if (!is_running_)
     {
-      log_(logger::LogLevel::Error, "Publisher::send " + localEndpointToString() + ": Tried to send data to a non-running publisher.");
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "Publisher::send " + localEndpointToString() + ": Tried to send data to a non-running publisher.");
       return false;
     }
 
+    const int64_t publish_time_ns       = LatencyHistogram::now();
+    const int64_t publish_entry_time_ns = TCP_PUBSUB_TRACE_NOW();
+
+    published_messages_.fetch_add(1,                   std::memory_order_relaxed);
+    published_bytes_   .fetch_add(entire_payload_size, std::memory_order_relaxed);
+
     // Don' send data if no subscriber is connected, unless requires stashing to transient local buffers
     if (transient_local_setting_.buffer_max_count_ == 0)
     {
@@ -264,7 +344,7 @@ namespace tcp_pubsub
       if (publisher_sessions_.empty())
       {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-        log_(logger::LogLevel::DebugVerbose, "Publisher::send " + localEndpointToString() + ": No connection to any subscriber. Skip sending data.");
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher::send " + localEndpointToString() + ": No connection to any subscriber. Skip sending data.");
 #endif
         return true;
       }
@@ -273,24 +353,11 @@ namespace tcp_pubsub
     // If a subsriber is connected, we need to initialize a buffer.
     std::shared_ptr<std::vector<char>> buffer = buffer_pool.allocate();
 
-#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    std::stringstream buffer_pointer_ss;
-    buffer_pointer_ss << "0x" << std::hex << buffer.get();
-    const std::string buffer_pointer_string = buffer_pointer_ss.str();
-#endif
-
     // Check the size of the buffer and resize it
     {
       // Size of header
       size_t header_size = sizeof(TcpHeader);
 
-      // Size of user data, i.e. all payload(s)
-      size_t entire_payload_size = 0;
-      for (const auto& payload : payloads)
-      {
-        entire_payload_size += payload.second;
-      }
-
       // Size of header and user data
       const size_t complete_size = header_size + entire_payload_size;
 
@@ -301,7 +368,7 @@ namespace tcp_pubsub
       buffer->resize(complete_size);
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-      log_(logger::LogLevel::DebugVerbose, "Publisher::send " + localEndpointToString() + ": Filling buffer " + buffer_pointer_string + " with header and data.Entire buffer size is " + std::to_string(buffer->size()) + " bytes.");
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher::send " + localEndpointToString() + ": Filling buffer " + logger::pointerString(buffer.get()) + " with header and data.Entire buffer size is " + std::to_string(buffer->size()) + " bytes.");
 #endif
 
       // Fill header and copy the given data to the buffer
@@ -311,53 +378,363 @@ namespace tcp_pubsub
       header->reserved        = 0;
       header->data_size       = htole64(entire_payload_size);
 
-      // copy the data into the buffer right after the header
-      size_t current_position = header_size;
-      for (const auto& payload : payloads)
+      // Write the payload right after the header
+      if (entire_payload_size > 0)
+        write_payload(&((*buffer)[header_size]), entire_payload_size);
+    }
+
+    // Numbering the message and adding it to the history are the only parts
+    // of sending that are serialized. The sessions restore the order of
+    // concurrent sends from the send ticket, so a slow subscriber only
+    // blocks the sends that have to wait for it.
+    uint64_t                                       send_ticket = 0;
+    std::vector<std::shared_ptr<PublisherSession>> reliable_sessions;
+    {
+      std::lock_guard<std::mutex> send_order_lock(send_order_mutex_);
+
+      if (sequence_number == 0)
+      {
+        sequence_number = next_sequence_number_++;
+      }
+      else if (next_sequence_number_ <= sequence_number)
       {
-        if (payload.first && (payload.second > 0))
+        // Numbers given by the user continue the count, so the next automatic
+        // number never goes back.
+        next_sequence_number_ = sequence_number + 1;
+      }
+      reinterpret_cast<tcp_pubsub::TcpHeader*>(&(*buffer)[0])->sequence_number = htole64(sequence_number);
+      send_ticket = next_send_ticket_++;
+
+      // The entry is only recorded now, as the message did not have an id before
+      TCP_PUBSUB_TRACE_AT(PublishEntry, sequence_number, publish_entry_time_ns);
+      TCP_PUBSUB_TRACE(BufferFilled, sequence_number);
+
+      if (transient_local_setting_.keyed_)
+      {
+        if (has_key)
         {
-          memcpy(&((*buffer)[current_position]), payload.first, payload.second);
-          current_position += payload.second;
+          const std::chrono::steady_clock::time_point now_tp(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(transient_local_steady_now_ns_.load(std::memory_order_relaxed))));
+          transient_local_keyed_buffers_.update(key, buffer, now_tp);
+          transient_local_history_version_++;
         }
       }
+      else if (transient_local_setting_.buffer_max_count_ > 0)
+      {
+        const std::chrono::steady_clock::time_point now_tp(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(transient_local_steady_now_ns_.load(std::memory_order_relaxed))));
+        transient_local_buffers_.push(buffer, now_tp);
+        transient_local_history_version_++;
+
+        if (transient_local_journal_)
+          transient_local_journal_->append(*buffer, transient_local_system_now_ns_.load(std::memory_order_relaxed));
+      }
+
+      // Every session that is in the list has been given an older ticket
+      // than this one, so it waits for this buffer.
+      if (reliable_setting_.enabled_)
+      {
+        std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mutex_);
+        reliable_sessions = publisher_sessions_;
+      }
     }
 
-    // Lock the sessions mutex again and send out the prepared buffer. All publisher sessions will operate on the same buffer!
+    if (reliable_setting_.enabled_)
+    {
+      // The eviction timeout is one deadline for the entire call, so several
+      // slow subscribers cannot add up their timeouts.
+      const auto deadline = (reliable_setting_.eviction_timeout_ > 0)
+                          ? std::chrono::steady_clock::now() + std::chrono::nanoseconds(reliable_setting_.eviction_timeout_)
+                          : std::chrono::steady_clock::time_point::max();
+
+      // Queueing may block, so we must not keep the sessions mutex locked.
+      // Otherwise sessions could not even remove themselves from the list.
+      for (const auto& publisher_session : reliable_sessions)
+      {
+        if (!publisher_session->sendReliableDataBuffer(buffer, send_ticket, publish_time_ns, deadline))
+        {
+          TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "Publisher::send " + localEndpointToString() + ": Subscriber " + publisher_session->remoteEndpointToString() + " has not granted credit in time. Disconnecting it.");
+          evicted_sessions_.fetch_add(1, std::memory_order_relaxed);
+          publisher_session->evict();
+        }
+      }
+    }
+    else
     {
+      // Lock the sessions mutex again and send out the prepared buffer. All publisher sessions will operate on the same buffer!
       std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mutex_);
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-      log_(logger::LogLevel::DebugVerbose, "Publisher::send " + localEndpointToString() + ": Sending buffer " + buffer_pointer_string + " to " + std::to_string(publisher_sessions_.size()) + " subsribers.");
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Publisher::send " + localEndpointToString() + ": Sending buffer " + logger::pointerString(buffer.get()) + " to " + std::to_string(publisher_sessions_.size()) + " subsribers.");
 #endif
 
       for (const auto& publisher_session : publisher_sessions_)
       {
-        publisher_session->sendDataBuffer(buffer);
+        publisher_session->sendDataBuffer(buffer, send_ticket, publish_time_ns);
       }
     }
 
-    if (transient_local_setting_.buffer_max_count_ > 0)
+    return true;
+  }
+
+  bool Publisher_Impl::send(const std::pair<const char* const, const size_t>* payloads_begin, const std::pair<const char* const, const size_t>* payloads_end, bool has_key, uint64_t key, uint64_t sequence_number)
+  {
+    // Size of user data, i.e. all payload(s)
+    size_t entire_payload_size = 0;
+    for (auto payload = payloads_begin; payload != payloads_end; ++payload)
     {
-      std::lock_guard<std::mutex> lk(transient_local_mtx_);
-      const auto now_tp = std::chrono::steady_clock::now();
-      TransientLocalElement ele;
-      ele.buffer_ = buffer;
-      ele.enqueue_tp_ = now_tp;
-      transient_local_buffers_.push_back(ele);
-      purgeExpiredTransientLocalBuffers(transient_local_buffers_, now_tp);
+      entire_payload_size += payload->second;
     }
 
-    return true;
+    // copy the data into the buffer right after the header
+    const auto copy_payloads = [payloads_begin, payloads_end](char* data, size_t /*size*/)
+                               {
+                                 size_t current_position = 0;
+                                 for (auto payload = payloads_begin; payload != payloads_end; ++payload)
+                                 {
+                                   if (payload->first && (payload->second > 0))
+                                   {
+                                     memcpy(data + current_position, payload->first, payload->second);
+                                     current_position += payload->second;
+                                   }
+                                 }
+                               };
+
+    return sendBuffer(entire_payload_size, copy_payloads, has_key, key, sequence_number);
   }
 
-  void Publisher_Impl::purgeExpiredTransientLocalBuffers(std::list<TransientLocalElement>& buffers, std::chrono::steady_clock::time_point now_tp)
+  bool Publisher_Impl::sendInPlace(size_t payload_size, const std::function<void(char* data, size_t size)>& writer, bool has_key, uint64_t key)
   {
-    while (buffers.size() > transient_local_setting_.buffer_max_count_ ||
-           (transient_local_setting_.lifespan_ > 0 && !buffers.empty() &&
-            std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp - buffers.front().enqueue_tp_).count() > transient_local_setting_.lifespan_))
+    return sendBuffer(payload_size, writer, has_key, key, 0);
+  }
+
+  ////////////////////////////////////////////////
+  // RPC
+  ////////////////////////////////////////////////
+
+  void Publisher_Impl::setRpcHandler(const RpcHandler& rpc_handler)
+  {
+    std::lock_guard<std::mutex> rpc_handler_lock(rpc_handler_mutex_);
+    rpc_handler_ = rpc_handler;
+  }
+
+  void Publisher_Impl::handleRpcRequest(const std::shared_ptr<PublisherSession>& session, const std::shared_ptr<std::vector<char>>& request, uint64_t correlation_id)
+  {
+    // Called from the session's strand
+
+    RpcHandler rpc_handler;
     {
-      buffers.pop_front();
+      std::lock_guard<std::mutex> rpc_handler_lock(rpc_handler_mutex_);
+      rpc_handler = rpc_handler_;
+    }
+
+    if (!rpc_handler)
+    {
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Publisher " + localEndpointToString() + ": Received RPC request from " + session->remoteEndpointToString() + ", but no RPC handler is set.");
+#endif
+      sendRpcResponse(session, correlation_id, MessageContentType::RpcError, nullptr, 0);
+      return;
+    }
+
+    // The responder only keeps weak references, so a response that is never
+    // sent does not keep the publisher or the session alive.
+    const std::weak_ptr<Publisher_Impl>   weak_me      = shared_from_this();
+    const std::weak_ptr<PublisherSession> weak_session = session;
+    const auto                            responded    = std::make_shared<std::atomic<bool>>(false);
+
+    const RpcResponder respond = [weak_me, weak_session, correlation_id, responded](const char* data, size_t size) -> bool
+                                 {
+                                   const auto me      = weak_me.lock();
+                                   const auto session = weak_session.lock();
+                                   if (!me || !session || responded->exchange(true))
+                                     return false;
+
+                                   return me->sendRpcResponse(session, correlation_id, MessageContentType::RpcResponse, data, size);
+                                 };
+
+    CallbackData request_data;
+    request_data.buffer_ = request;
+
+    rpc_handler(request_data, respond);
+  }
+
+  bool Publisher_Impl::sendRpcResponse(const std::shared_ptr<PublisherSession>& session, uint64_t correlation_id, MessageContentType type, const char* data, size_t size)
+  {
+    std::shared_ptr<std::vector<char>> buffer = buffer_pool.allocate();
+
+    const size_t complete_size = sizeof(TcpHeader) + size;
+    if (buffer->capacity() < complete_size)
+    {
+      buffer->reserve(static_cast<size_t>(complete_size * 1.1)); // Reserve 10% more bytes for later!
+    }
+    buffer->resize(complete_size);
+
+    auto header = reinterpret_cast<tcp_pubsub::TcpHeader*>(&(*buffer)[0]);
+    header->header_size     = htole16(sizeof(TcpHeader));
+    header->type            = type;
+    header->reserved        = 0;
+    header->data_size       = htole64(size);
+    header->sequence_number = htole64(correlation_id);
+
+    if (size > 0)
+      std::memcpy(&((*buffer)[sizeof(TcpHeader)]), data, size);
+
+    // Responses are never dropped and overtake queued data
+    return session->sendPriorityBuffer(buffer);
+  }
+
+  void Publisher_Impl::updateTransientLocalClock()
+  {
+    transient_local_steady_now_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+    transient_local_system_now_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+  }
+
+  void Publisher_Impl::scheduleTransientLocalMaintenance()
+  {
+    // cancel() resets is_running_ before it cancels the timer with the mutex
+    // locked. So either we see that, or the timer is canceled after we have
+    // armed it.
+    std::lock_guard<std::mutex> maintenance_lock(transient_local_maintenance_mutex_);
+    if (!is_running_)
+      return;
+
+    transient_local_maintenance_timer_.expires_after(transient_local_clock_resolution);
+    transient_local_maintenance_timer_.async_wait([me = shared_from_this()](asio::error_code ec)
+                                                  {
+                                                    if (ec || !me->is_running_)
+                                                      return;
+
+                                                    me->updateTransientLocalClock();
+
+                                                    // Expiring samples does not change what a snapshot contains, as
+                                                    // snapshots skip expired samples anyways. So we don't have to
+                                                    // increment the history version here.
+                                                    if (me->transient_local_setting_.lifespan_ > 0)
+                                                    {
+                                                      const auto now_tp = std::chrono::steady_clock::now();
+                                                      if (me->transient_local_setting_.keyed_)
+                                                        me->transient_local_keyed_buffers_.purgeExpired(now_tp);
+                                                      else
+                                                        me->transient_local_buffers_.purgeExpired(now_tp);
+                                                    }
+
+                                                    me->scheduleTransientLocalMaintenance();
+                                                  });
+  }
+
+  void Publisher_Impl::restoreTransientLocalJournal()
+  {
+    if (!transient_local_journal_->isOpen())
+      return;
+
+    const auto elements = transient_local_journal_->restore();
+
+    // The journal stores system time, as the steady clock of the previous
+    // process is meaningless for us. We convert it back to our steady clock
+    // so the lifespan also covers the time the publisher was not running.
+    const auto    steady_now_tp  = std::chrono::steady_clock::now();
+    const int64_t system_now_ns  = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    uint64_t last_sequence_number = 0;
+    for (const auto& element : elements)
+    {
+      const int64_t age_ns = std::max(system_now_ns - element.system_time_ns_, int64_t(0));
+      transient_local_buffers_.push(element.buffer_, steady_now_tp - std::chrono::nanoseconds(age_ns));
+      last_sequence_number = std::max(last_sequence_number, sequenceNumberOfBuffer(*element.buffer_));
+    }
+
+    // Continue counting after the restored messages, so subscribers can
+    // tell the new messages from the restored ones.
+    next_sequence_number_ = last_sequence_number + 1;
+
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Publisher: Restored " + std::to_string(elements.size()) + " samples from transient local journal " + transient_local_setting_.journal_path_ + ".");
+#endif
+  }
+
+  Publisher_Impl::TransientLocalSnapshot Publisher_Impl::transientLocalSnapshot(std::chrono::steady_clock::time_point now_tp)
+  {
+    // When many subscribers join at once, the first one creates the snapshot
+    // and all others wait for it and share it, as long as no sample has been
+    // added and no sample of the snapshot has expired in the meantime.
+    std::lock_guard<std::mutex> snapshot_lock(transient_local_snapshot_mutex_);
+
+    // Read the version before creating the snapshot. If a sample is added
+    // while we are creating it, the next joiner will create a new one.
+    const uint64_t history_version = transient_local_history_version_;
+
+    if (transient_local_snapshot_.buffers_
+        && (transient_local_snapshot_.history_version_ == history_version)
+        && (now_tp < transient_local_snapshot_.valid_until_))
+    {
+      return transient_local_snapshot_;
+    }
+
+    auto enqueue_times_ns = std::make_shared<std::vector<int64_t>>();
+    if (transient_local_setting_.keyed_)
+      transient_local_snapshot_.buffers_ = std::make_shared<const std::vector<std::shared_ptr<std::vector<char>>>>(transient_local_keyed_buffers_.snapshot(now_tp, *enqueue_times_ns));
+    else
+      transient_local_snapshot_.buffers_ = std::make_shared<const std::vector<std::shared_ptr<std::vector<char>>>>(transient_local_buffers_.snapshot(now_tp, *enqueue_times_ns));
+
+    transient_local_snapshot_.enqueue_times_ns_ = enqueue_times_ns;
+    transient_local_snapshot_.history_version_  = history_version;
+    if ((transient_local_setting_.lifespan_ > 0) && !enqueue_times_ns->empty())
+      transient_local_snapshot_.valid_until_ = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(enqueue_times_ns->front() + transient_local_setting_.lifespan_)));
+    else
+      transient_local_snapshot_.valid_until_ = std::chrono::steady_clock::time_point::max();
+
+    return transient_local_snapshot_;
+  }
+
+  size_t Publisher_Impl::transientLocalReplayBegin(const TransientLocalSnapshot& snapshot, const ProtocolHandshakeMessage& handshake_request, std::chrono::steady_clock::time_point now_tp) const
+  {
+    const auto& buffers          = *snapshot.buffers_;
+    const auto& enqueue_times_ns = *snapshot.enqueue_times_ns_;
+
+    switch (handshake_request.replay_mode)
+    {
+    case ReplayMode::None:
+      return buffers.size();
+
+    case ReplayMode::LastN:
+    {
+      const uint64_t count = le64toh(handshake_request.replay_count);
+      return (count < buffers.size() ? buffers.size() - static_cast<size_t>(count) : 0);
+    }
+
+    case ReplayMode::SinceTime:
+    {
+      // The subscriber sends system time, but the history stores steady time
+      const int64_t since_system_ns = static_cast<int64_t>(le64toh(static_cast<uint64_t>(handshake_request.replay_since_ns)));
+      const int64_t system_now_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+      const int64_t steady_now_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+      // The history is timestamped with a coarse clock, so samples may appear
+      // older than they are. We rather send a few samples too many.
+      const int64_t since_steady_ns = steady_now_ns - (system_now_ns - since_system_ns)
+                                      - std::chrono::duration_cast<std::chrono::nanoseconds>(transient_local_clock_resolution).count();
+
+      const auto it = std::find_if(enqueue_times_ns.begin(), enqueue_times_ns.end()
+                                  , [since_steady_ns](int64_t enqueue_time_ns) { return enqueue_time_ns >= since_steady_ns; });
+      return static_cast<size_t>(it - enqueue_times_ns.begin());
+    }
+
+    case ReplayMode::AfterSequenceNumber:
+    {
+      // Sequence numbers of another publisher instance (e.g. before a
+      // restart) mean nothing to us. The subscriber has missed everything
+      // this instance has published, so we send the entire history.
+      const uint64_t requested_instance_id = le64toh(handshake_request.publisher_instance_id);
+      if ((requested_instance_id != 0) && (requested_instance_id != instance_id_))
+        return 0;
+
+      const uint64_t sequence_number = le64toh(handshake_request.replay_sequence_number);
+
+      const auto it = std::find_if(buffers.begin(), buffers.end()
+                                  , [sequence_number](const std::shared_ptr<std::vector<char>>& buffer) { return sequenceNumberOfBuffer(*buffer) > sequence_number; });
+      return static_cast<size_t>(it - buffers.begin());
+    }
+
+    default:
+      return 0;
     }
   }
 
@@ -388,6 +765,18 @@ namespace tcp_pubsub
     return publisher_sessions_.size();
   }
 
+  std::vector<PublisherSessionStatistics> Publisher_Impl::getSessionStatistics() const
+  {
+    std::vector<PublisherSessionStatistics> statistics;
+
+    std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mutex_);
+    statistics.reserve(publisher_sessions_.size());
+    for (const auto& publisher_session : publisher_sessions_)
+      statistics.push_back(publisher_session->getStatistics());
+
+    return statistics;
+  }
+
   bool Publisher_Impl::isRunning() const
   {
     return is_running_;
@@ -407,4 +796,56 @@ namespace tcp_pubsub
     else
       return "?";
   }
+
+  ////////////////////////////////////////////////
+  // Statistics
+  ////////////////////////////////////////////////
+
+  void Publisher_Impl::registerStatistics()
+  {
+    // The endpoint is determined once, as it cannot be read anymore after canceling
+    executor_->executor_impl_->statisticsRegistry().add(
+              [weak_me = std::weak_ptr<Publisher_Impl>(shared_from_this()), labels = StatisticsCollector::label("publisher", localEndpointToString())](StatisticsCollector& collector) -> bool
+              {
+                auto me = weak_me.lock();
+                if (!me || !me->is_running_)
+                  return false;
+
+                me->collectStatistics(collector, labels);
+                return true;
+              });
+  }
+
+  void Publisher_Impl::collectStatistics(StatisticsCollector& collector, const std::string& labels) const
+  {
+    std::vector<std::shared_ptr<PublisherSession>> publisher_sessions;
+    {
+      std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mutex_);
+      publisher_sessions = publisher_sessions_;
+    }
+
+    uint64_t                              dropped_buffers     = closed_sessions_dropped_buffers_    .load(std::memory_order_relaxed);
+    uint64_t                              downsampled_buffers = closed_sessions_downsampled_buffers_.load(std::memory_order_relaxed);
+    uint64_t                              queued_buffers      = 0;
+    std::vector<LatencyHistogramSnapshot> publish_to_write_snapshots;
+    publish_to_write_snapshots.reserve(publisher_sessions.size() + 1);
+    publish_to_write_snapshots.push_back(closed_sessions_publish_to_write_histogram_.snapshot());
+
+    for (const auto& publisher_session : publisher_sessions)
+    {
+      dropped_buffers     += publisher_session->getDroppedBufferCount();
+      downsampled_buffers += publisher_session->getDownsampledBufferCount();
+      queued_buffers      += publisher_session->getQueuedBufferCount();
+      publish_to_write_snapshots.push_back(publisher_session->getStatistics().publish_to_write_);
+    }
+
+    collector.counter  ("tcp_pubsub_publisher_messages_total",         "Number of messages published",                                                      labels, published_messages_.load(std::memory_order_relaxed));
+    collector.counter  ("tcp_pubsub_publisher_bytes_total",            "Number of payload bytes published",                                                 labels, published_bytes_.load(std::memory_order_relaxed));
+    collector.counter  ("tcp_pubsub_publisher_dropped_messages_total", "Number of messages that have been replaced by a newer one before they could be sent", labels, dropped_buffers);
+    collector.counter  ("tcp_pubsub_publisher_downsampled_messages_total", "Number of messages that have been replaced by a newer one due to the rate limit of a subscriber", labels, downsampled_buffers);
+    collector.counter  ("tcp_pubsub_publisher_evicted_sessions_total", "Number of reliable subscribers that have been disconnected for not granting credit in time", labels, evicted_sessions_.load(std::memory_order_relaxed));
+    collector.gauge    ("tcp_pubsub_publisher_sessions",               "Number of connected subscribers",                                                   labels, publisher_sessions.size());
+    collector.gauge    ("tcp_pubsub_publisher_queued_messages",        "Number of messages waiting to be sent, summed over all subscribers",                labels, queued_buffers);
+    collector.histogram("tcp_pubsub_publisher_publish_to_write_seconds", "Time from the send() call until the message has been written to the socket",    labels, publish_to_write_snapshots);
+  }
 }
@@ -7,14 +7,21 @@
 #include <string>
 #include <mutex>
 #include <atomic>
+#include <functional>
 
 #include <asio.hpp>
 #include <recycle/shared_pool.hpp>
 
 #include <tcp_pubsub/executor.h>
 #include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/rpc.h>
 #include "tcp_pubsub_logger_abstraction.h"
 #include "publisher_session.h"
+#include "latency_histogram.h"
+#include "statistics_registry.h"
+#include "transient_local_ring.h"
+#include "transient_local_journal.h"
+#include "transient_local_keyed_cache.h"
 
 namespace tcp_pubsub
 {
@@ -27,7 +34,7 @@ namespace tcp_pubsub
   
   public:
     // Constructor
-    Publisher_Impl(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting);
+    Publisher_Impl(const std::shared_ptr<Executor>& executor, const PublisherTransientLocalSetting& transient_local_setting, const PublisherReliableSetting& reliable_setting);
 
     // Copy
     Publisher_Impl(const Publisher_Impl&)            = delete;
@@ -56,7 +63,28 @@ namespace tcp_pubsub
   ////////////////////////////////////////////////
   
   public:
-    bool send(const std::vector<std::pair<const char* const, const size_t>>& payloads);
+    // Takes the payloads as range, so sending a single payload does not need
+    // to allocate a vector. A sequence number of 0 means to use the next one.
+    bool send(const std::pair<const char* const, const size_t>* payloads_begin, const std::pair<const char* const, const size_t>* payloads_end, bool has_key, uint64_t key, uint64_t sequence_number);
+
+    // Lets the writer fill the payload directly in the buffer. The writer is
+    // only called, if the message is actually sent or stored in the history.
+    bool sendInPlace(size_t payload_size, const std::function<void(char* data, size_t size)>& writer, bool has_key, uint64_t key);
+
+  private:
+    template <typename PayloadWriter>
+    bool sendBuffer(size_t entire_payload_size, const PayloadWriter& write_payload, bool has_key, uint64_t key, uint64_t sequence_number);
+
+  ////////////////////////////////////////////////
+  // RPC
+  ////////////////////////////////////////////////
+
+  public:
+    void setRpcHandler(const RpcHandler& rpc_handler);
+
+  private:
+    void handleRpcRequest(const std::shared_ptr<PublisherSession>& session, const std::shared_ptr<std::vector<char>>& request, uint64_t correlation_id);
+    bool sendRpcResponse(const std::shared_ptr<PublisherSession>& session, uint64_t correlation_id, MessageContentType type, const char* data, size_t size);
 
   ////////////////////////////////////////////////
   // (Status-) getters
@@ -65,6 +93,7 @@ namespace tcp_pubsub
   public:
     uint16_t           getPort()            const;
     size_t             getSubscriberCount() const;
+    std::vector<PublisherSessionStatistics> getSessionStatistics() const;
 
     bool               isRunning()          const;
 
@@ -72,6 +101,14 @@ namespace tcp_pubsub
     std::string toString(const asio::ip::tcp::endpoint& endpoint) const;
     std::string localEndpointToString() const;
 
+  ////////////////////////////////////////////////
+  // Statistics
+  ////////////////////////////////////////////////
+
+  private:
+    void registerStatistics();
+    void collectStatistics(StatisticsCollector& collector, const std::string& labels) const;
+
   ////////////////////////////////////////////////
   // Member variables
   ////////////////////////////////////////////////
@@ -84,12 +121,30 @@ namespace tcp_pubsub
     asio::ip::tcp::acceptor                        acceptor_;                   /// Acceptor used for waiting for clients (i.e. subscribers)
                                                 
     // Logger                                    
-    const logger::logger_t                         log_;                        /// Function for logging
+    const logger::Logger                         log_;                        /// Function for logging
                                                    
     // Sessions                                       
     mutable std::mutex                             publisher_sessions_mutex_;   
     std::vector<std::shared_ptr<PublisherSession>> publisher_sessions_;         /// List of all sessions (i.e. connections to subsribers)
 
+    const PublisherReliableSetting                 reliable_setting_;
+    std::mutex                                     send_order_mutex_;           /// Held by send() while numbering the message and adding it to the history. Never held while waiting for a session.
+    uint64_t                                       next_sequence_number_;       /// [PROTECTED BY send_order_mutex_!] Sequence number of the next message. Starts at 1.
+    uint64_t                                       next_send_ticket_;           /// [PROTECTED BY send_order_mutex_!] Counts the messages in the order of their sequence numbers, so the sessions can restore that order.
+    uint64_t                                       instance_id_;                /// Random id, so subscribers can tell whether sequence numbers belong to this publisher instance
+
+    // Statistics
+    std::atomic<uint64_t>                          published_messages_;         /// Messages passed to send() while running
+    std::atomic<uint64_t>                          published_bytes_;            /// Payload bytes of published_messages_
+    std::atomic<uint64_t>                          evicted_sessions_;           /// Reliable sessions that have been disconnected, because the subscriber did not grant credit in time
+    std::atomic<uint64_t>                          closed_sessions_dropped_buffers_;             /// Dropped buffers of sessions that have been removed already
+    std::atomic<uint64_t>                          closed_sessions_downsampled_buffers_;         /// Downsampled buffers of sessions that have been removed already
+    LatencyHistogram                               closed_sessions_publish_to_write_histogram_;  /// Latencies of sessions that have been removed already
+
+    // RPC
+    mutable std::mutex                             rpc_handler_mutex_;
+    RpcHandler                                     rpc_handler_;                /// [PROTECTED BY rpc_handler_mutex_!] Handler for requests of all sessions. Requests are answered with an error, if not set.
+
     // Buffer pool
     struct buffer_pool_lock_policy_
     {
@@ -98,16 +153,37 @@ namespace tcp_pubsub
     };
     recycle::shared_pool<std::vector<char>, buffer_pool_lock_policy_> buffer_pool; /// Buffer pool that let's us reuse memory chunks
 
-    PublisherTransientLocalSetting transient_local_setting_;
-    struct TransientLocalElement
+    // Transient local history
+    const PublisherTransientLocalSetting transient_local_setting_;
+    TransientLocalRing                   transient_local_buffers_;             /// stores recent samples to implement QOS::transient_local_durability_qos
+    TransientLocalKeyedCache             transient_local_keyed_buffers_;       /// Latest sample per key, used instead of transient_local_buffers_ in keyed mode
+    std::unique_ptr<TransientLocalJournal> transient_local_journal_;           /// Optional persistent copy of transient_local_buffers_
+
+    // Coarse clock for timestamping the history. Reading it costs a relaxed
+    // atomic load instead of a clock call per sample. It is advanced by the
+    // maintenance timer, which also purges expired samples.
+    std::mutex                           transient_local_maintenance_mutex_;   /// The timer is re-armed by its handler on an io thread and canceled by the user thread
+    asio::steady_timer                   transient_local_maintenance_timer_;   /// [PROTECTED BY transient_local_maintenance_mutex_!]
+    std::atomic<int64_t>                 transient_local_steady_now_ns_;
+    std::atomic<int64_t>                 transient_local_system_now_ns_;
+
+    // Snapshot of the history that is shared by all late joiners until the history changes
+    struct TransientLocalSnapshot
     {
-      std::shared_ptr<std::vector<char>> buffer_;
-      std::chrono::steady_clock::time_point enqueue_tp_;
+      uint64_t                                                               history_version_ = 0;
+      std::chrono::steady_clock::time_point                                  valid_until_;           /// Time the oldest element of the snapshot expires
+      std::shared_ptr<const std::vector<std::shared_ptr<std::vector<char>>>> buffers_;
+      std::shared_ptr<const std::vector<int64_t>>                            enqueue_times_ns_;      /// steady_clock enqueue time of each element of buffers_
     };
-    std::mutex transient_local_mtx_;
-    std::list<TransientLocalElement> transient_local_buffers_;    /// stores recent samples to implement QOS::transient_local_durability_qos
+    std::atomic<uint64_t>                transient_local_history_version_;     /// Incremented each time a sample is added to the history
+    std::mutex                           transient_local_snapshot_mutex_;
+    TransientLocalSnapshot               transient_local_snapshot_;
 
   private:
-    void purgeExpiredTransientLocalBuffers(std::list<TransientLocalElement>& buffers, std::chrono::steady_clock::time_point now_tp);
+    void updateTransientLocalClock();
+    void scheduleTransientLocalMaintenance();
+    void restoreTransientLocalJournal();
+    TransientLocalSnapshot transientLocalSnapshot(std::chrono::steady_clock::time_point now_tp);
+    size_t transientLocalReplayBegin(const TransientLocalSnapshot& snapshot, const ProtocolHandshakeMessage& handshake_request, std::chrono::steady_clock::time_point now_tp) const;
   };
 }
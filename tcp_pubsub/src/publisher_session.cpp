@@ -7,11 +7,23 @@
 
 #include "tcp_header.h"
 #include "portable_endian.h"
+#include "trace_points.h"
 
 #include "protocol_handshake_message.h"
+#include "credit_grant_message.h"
+#include "rate_limit_message.h"
 
 namespace tcp_pubsub
 {
+  constexpr size_t PublisherSession::max_buffers_per_write_;
+
+  namespace
+  {
+    // Queue size of reliable sessions until the subscriber has told us its
+    // credit window, and for subscribers that don't send credit at all
+    constexpr uint64_t default_credit_window_messages = 64;
+  }
+
   //////////////////////////////////////////////
   /// Constructor & Destructor
   //////////////////////////////////////////////
@@ -19,32 +31,59 @@ namespace tcp_pubsub
   PublisherSession::PublisherSession(const std::shared_ptr<asio::io_service>&                               io_service
                                      , const std::function<void(const std::shared_ptr<PublisherSession>&)>& session_closed_handler
                                      , const std::function<void(const std::shared_ptr<PublisherSession>&)>& transient_local_push_handler
-                                     , const tcp_pubsub::logger::logger_t&                                  log_function)
+                                     , const std::function<void(const std::shared_ptr<PublisherSession>&, const std::shared_ptr<std::vector<char>>&, uint64_t)>& rpc_request_handler
+                                     , uint64_t                                                             publisher_instance_id
+                                     , bool                                                                 reliable
+                                     , uint64_t                                                             max_credit_window_messages
+                                     , uint64_t                                                             max_credit_window_bytes
+                                     , uint64_t                                                             replay_max_bytes_per_second
+                                     , const tcp_pubsub::logger::Logger&                                  log_function)
     : io_service_             (io_service)
     , state_                  (State::NotStarted)
     , session_closed_handler_ (session_closed_handler)
     , transient_local_push_handler_ (transient_local_push_handler)
+    , rpc_request_handler_    (rpc_request_handler)
     , log_                    (log_function)
     , data_socket_            (*io_service_)
     , data_strand_            (*io_service_)
+    , publisher_instance_id_  (publisher_instance_id)
+    , reliable_               (reliable)
     , sending_in_progress_    (false)
+    , next_buffer_publish_time_ns_(0)
+    , next_send_ticket_       (0)
+    , sequence_number_header_ (false)
+    , transient_buffers_to_send_position_(0)
+    , replay_max_bytes_per_second_(replay_max_bytes_per_second)
+    , replay_timer_           (*io_service_)
+    , replay_window_bytes_    (0)
+    , min_interval_ns_        (0)
+    , rate_limit_timer_       (*io_service_)
+    , rate_limit_waiting_     (false)
+    , reliable_queued_bytes_  (0)
+    , max_credit_window_messages_(std::max<uint64_t>(1, max_credit_window_messages))
+    , max_credit_window_bytes_(max_credit_window_bytes)
+    , credit_unlimited_       (false)
+    , credit_window_messages_ (std::min(default_credit_window_messages, max_credit_window_messages_))
+    , credit_window_bytes_    (max_credit_window_bytes_)
+    , credit_messages_        (0)
+    , credit_bytes_           (0)
+    , evicted_                (false)
+    , dropped_buffers_        (0)
+    , downsampled_buffers_    (0)
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Created.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Created.");
 #endif
   }
 
   PublisherSession::~PublisherSession()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    std::stringstream ss;
-    ss << std::this_thread::get_id();
-    std::string thread_id = ss.str();
-    log_(logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Deleting from thread " + thread_id + "...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Deleting from thread " + logger::threadIdString() + "...");
 #endif
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "PublisherSession " + endpointToString() + ": Deleted.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "PublisherSession " + endpointToString() + ": Deleted.");
 #endif
   }
 
@@ -55,7 +94,7 @@ namespace tcp_pubsub
   void PublisherSession::start()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Setting tcp::no_delay option.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Setting tcp::no_delay option.");
 #endif
     // Disable Nagle's algorithm. Nagles Algorithm will otherwise cause the
     // Socket to wait for more data, if it encounters a frame that can still
@@ -64,7 +103,7 @@ namespace tcp_pubsub
     {
       asio::error_code ec;
       data_socket_.set_option(asio::ip::tcp::no_delay(true), ec);
-      if (ec) log_(logger::LogLevel::Warning, "PublisherSession " + endpointToString() + ": Failed setting tcp::no_delay option. The performance may suffer.");
+      if (ec) TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "PublisherSession " + endpointToString() + ": Failed setting tcp::no_delay option. The performance may suffer.");
     }
 
     state_ = State::Handshaking;
@@ -77,6 +116,17 @@ namespace tcp_pubsub
     sessionClosedHandler();
   }
 
+  void PublisherSession::evict()
+  {
+    {
+      std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+      evicted_ = true;
+    }
+    reliable_buffers_cv_.notify_all();
+
+    data_strand_.post([me = shared_from_this()]() { me->sessionClosedHandler(); });
+  }
+
   void PublisherSession::sessionClosedHandler()
   {
     // Check if this session has already been canceled while at the same time
@@ -87,7 +137,7 @@ namespace tcp_pubsub
       return;
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "PublisherSession " + endpointToString() + ": Closing session.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "PublisherSession " + endpointToString() + ": Closing session.");
 #endif
 
     {
@@ -95,6 +145,21 @@ namespace tcp_pubsub
       data_socket_.close(ec); // Even if ec indicates an error, the socket is closed now (according to the documentation)
     }
 
+    // The timers are armed by send() threads while holding the
+    // next_buffer_mutex_, so we must hold it as well to cancel them. Locking
+    // the mutex also makes sure no thread waiting to queue a reliable buffer
+    // is between checking the state and starting to wait.
+    {
+      std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+      asio::error_code ec;
+      replay_timer_    .cancel(ec);
+      rate_limit_timer_.cancel(ec);
+    }
+
+    // Wake up all threads waiting to queue a reliable buffer
+    reliable_buffers_cv_.notify_all();
+
     session_closed_handler_(shared_from_this()); // Run the completion handler
   }
 
@@ -112,7 +177,7 @@ namespace tcp_pubsub
       return;
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose,  "PublisherSession " + endpointToString() + ": Waiting for data...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose,  "PublisherSession " + endpointToString() + ": Waiting for data...");
 #endif
 
     std::shared_ptr<TcpHeader> header = std::make_shared<TcpHeader>();
@@ -124,7 +189,10 @@ namespace tcp_pubsub
                                         {
                                           if (ec)
                                           {
-                                            me->log_(logger::LogLevel::Error,  "PublisherSession " + me->endpointToString() + ": Error reading header length: " + ec.message());
+                                            auto logger_level = logger::LogLevel::Error;
+                                            if ((ec == asio::error::eof) || (ec.value() == static_cast<int>(std::errc::operation_canceled)))
+                                              logger_level = logger::LogLevel::Info;
+                                            TCP_PUBSUB_LOG(me->log_, logger_level, "PublisherSession " + me->endpointToString() + ": Error reading header length: " + ec.message());
                                             me->sessionClosedHandler();;
                                             return;
                                           }
@@ -139,7 +207,7 @@ namespace tcp_pubsub
 
     if (header->header_size < sizeof(header->header_size))
     {
-      log_(logger::LogLevel::Error,  "PublisherSession " + endpointToString() + ": Received header length of " + std::to_string(header->header_size) + ", which is less than the minimal header size.");
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error,  "PublisherSession " + endpointToString() + ": Received header length of " + std::to_string(header->header_size) + ", which is less than the minimal header size.");
       sessionClosedHandler();
       return;
     }
@@ -157,13 +225,12 @@ namespace tcp_pubsub
                                   {
                                     if (ec)
                                     {
-                                      me->log_(logger::LogLevel::Error,  "PublisherSession " + me->endpointToString() + ": Error reading header content: " + ec.message());
+                                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "PublisherSession " + me->endpointToString() + ": Error reading header content: " + ec.message());
                                       me->sessionClosedHandler();;
                                       return;
                                     }
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                                    me->log_(logger::LogLevel::DebugVerbose
-                                          ,  "PublisherSession " + me->endpointToString()
+                                    TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose,  "PublisherSession " + me->endpointToString()
                                             + ": Received header content: "
                                             + "data_size: "       + std::to_string(le64toh(header->data_size)));
 #endif
@@ -184,22 +251,22 @@ namespace tcp_pubsub
     if (state_ == State::Canceled)
       return;
 
-    // This vector is temporary and will be deleted right after we read the data into it
-    std::vector<char> data_to_discard;
-    data_to_discard.resize(bytes_to_discard);
+    // This vector is temporary and will be deleted right after we read the
+    // data into it. The handler keeps it alive until the read has finished.
+    std::shared_ptr<std::vector<char>> data_to_discard = std::make_shared<std::vector<char>>(bytes_to_discard);
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose,  "PublisherSession " + endpointToString() + ": Discarding " + std::to_string(bytes_to_discard) + " bytes after the header.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose,  "PublisherSession " + endpointToString() + ": Discarding " + std::to_string(bytes_to_discard) + " bytes after the header.");
 #endif
 
     asio::async_read(data_socket_
-              , asio::buffer(data_to_discard.data(), bytes_to_discard)
+              , asio::buffer(data_to_discard->data(), bytes_to_discard)
               , asio::transfer_at_least(bytes_to_discard)
-              , data_strand_.wrap([me = shared_from_this(), header](asio::error_code ec, std::size_t /*length*/)
+              , data_strand_.wrap([me = shared_from_this(), header, data_to_discard](asio::error_code ec, std::size_t /*length*/)
                                   {
                                     if (ec)
                                     {
-                                      me->log_(logger::LogLevel::Error,  "PublisherSession " + me->endpointToString() + ": Error discarding bytes after header: " + ec.message());
+                                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "PublisherSession " + me->endpointToString() + ": Error discarding bytes after header: " + ec.message());
                                       me->sessionClosedHandler();
                                       return;
                                     }
@@ -214,8 +281,16 @@ namespace tcp_pubsub
 
     if (header->data_size == 0)
     {
+      // Requests may be empty. Anything else is not valid.
+      if ((header->type == MessageContentType::RpcRequest) && (state_ == State::Running))
+      {
+        rpc_request_handler_(shared_from_this(), std::make_shared<std::vector<char>>(), le64toh(header->sequence_number));
+        readHeaderLength();
+        return;
+      }
+
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-      log_(logger::LogLevel::Debug,  "PublisherSession " + endpointToString() + ": Received data size of 0.");
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug,  "PublisherSession " + endpointToString() + ": Received data size of 0.");
 #endif
       sessionClosedHandler();
       return;
@@ -232,27 +307,63 @@ namespace tcp_pubsub
                                   {
                                     if (ec)
                                     {
-                                      me->log_(logger::LogLevel::Error,  "PublisherSession " + me->endpointToString() + ": Error reading payload: " + ec.message());
+                                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "PublisherSession " + me->endpointToString() + ": Error reading payload: " + ec.message());
                                       me->sessionClosedHandler();;
                                       return;
                                     }
 
                                     // Handle payload
-                                    if (header->type == MessageContentType::ProtocolHandshake)
+                                    if ((header->type == MessageContentType::ProtocolHandshake) && (me->state_ == State::Handshaking))
                                     {
                                       ProtocolHandshakeMessage handshake_message;
                                       size_t bytes_to_copy = std::min(data_buffer->size(), sizeof(ProtocolHandshakeMessage));
                                       std::memcpy(&handshake_message, data_buffer->data(), bytes_to_copy);
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                                      me->log_(logger::LogLevel::Debug,  "PublisherSession " + me->endpointToString() + ": Received Handshake message. Maximum supported protocol version from subsriber: v" + std::to_string(handshake_message.protocol_version));
+                                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug,  "PublisherSession " + me->endpointToString() + ": Received Handshake message. Maximum supported protocol version from subsriber: v" + std::to_string(handshake_message.protocol_version));
 #endif
+                                      me->handshake_request_ = handshake_message;
                                       me->sendProtocolHandshakeResponse();
                                     }
-                                    else
+                                    else if (me->state_ == State::Handshaking)
                                     {
-                                      me->log_(logger::LogLevel::Warning,  "PublisherSession " + me->endpointToString() + ": Received message is not a handshake message (Type is " + std::to_string(static_cast<uint8_t>(header->type)) + ").");
+                                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning,  "PublisherSession " + me->endpointToString() + ": Received message is not a handshake message (Type is " + std::to_string(static_cast<uint8_t>(header->type)) + ").");
                                       me->sessionClosedHandler();
+                                      return;
+                                    }
+                                    else if (header->type == MessageContentType::CreditGrant)
+                                    {
+                                      CreditGrantMessage credit_grant_message;
+                                      size_t bytes_to_copy = std::min(data_buffer->size(), sizeof(CreditGrantMessage));
+                                      std::memcpy(&credit_grant_message, data_buffer->data(), bytes_to_copy);
+                                      me->grantCredit(le64toh(credit_grant_message.messages), le64toh(credit_grant_message.bytes));
+                                    }
+                                    else if (header->type == MessageContentType::RateLimit)
+                                    {
+                                      RateLimitMessage rate_limit_message;
+                                      size_t bytes_to_copy = std::min(data_buffer->size(), sizeof(RateLimitMessage));
+                                      std::memcpy(&rate_limit_message, data_buffer->data(), bytes_to_copy);
+                                      me->setMinInterval(le64toh(rate_limit_message.min_interval_ns));
                                     }
+                                    else if (header->type == MessageContentType::RpcRequest)
+                                    {
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+                                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose,  "PublisherSession " + me->endpointToString() + ": Received RPC request " + std::to_string(le64toh(header->sequence_number)) + ".");
+#endif
+                                      // The payload buffer is handed over as it is. The
+                                      // response may be sent later from any thread.
+                                      me->rpc_request_handler_(me, data_buffer, le64toh(header->sequence_number));
+                                    }
+                                    else
+                                    {
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+                                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose,  "PublisherSession " + me->endpointToString() + ": Ignoring message of type " + std::to_string(static_cast<uint8_t>(header->type)) + ".");
+#endif
+                                    }
+
+                                    // Keep reading, as the subscriber may send us credit, rate
+                                    // limits or requests. This also lets us detect closed
+                                    // connections right away.
+                                    me->readHeaderLength();
                                   }));
   }
 
@@ -262,96 +373,516 @@ namespace tcp_pubsub
       return;
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug,  "PublisherSession " + endpointToString() + ": Sending ProtocolHandshakeResponse.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug,  "PublisherSession " + endpointToString() + ": Sending ProtocolHandshakeResponse.");
 #endif
 
+    // Like the request, the response always uses the short header
     std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
-    buffer->resize(sizeof(TcpHeader) + sizeof(ProtocolHandshakeMessage));
+    buffer->resize(short_tcp_header_size + sizeof(ProtocolHandshakeMessage));
 
     TcpHeader* header   = reinterpret_cast<TcpHeader*>(buffer->data());
-    header->header_size = htole16(sizeof(TcpHeader));
+    header->header_size = htole16(short_tcp_header_size);
     header->type        = MessageContentType::ProtocolHandshake;
     header->reserved    = 0;
     header->data_size   = htole64(sizeof(ProtocolHandshakeMessage));
 
-    ProtocolHandshakeMessage* handshake_message = reinterpret_cast<ProtocolHandshakeMessage*>(&(buffer->operator[](sizeof(TcpHeader))));
+    ProtocolHandshakeMessage* handshake_message = reinterpret_cast<ProtocolHandshakeMessage*>(&(buffer->operator[](short_tcp_header_size)));
     handshake_message->protocol_version         = 0; // At the moment, we only support Version 0. 
+    handshake_message->publisher_instance_id    = htole64(publisher_instance_id_);
+    handshake_message->reliable                 = (reliable_ ? 1 : 0);
+    handshake_message->sequence_number_header   = 1;
+
+    // The handshake response must be the first buffer on the wire, followed
+    // by the transient local history. Both are queued as priority buffers and
+    // only afterwards we start sending, so no live data can overtake them.
+    {
+      std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+      sequence_number_header_ = (handshake_request_.sequence_number_header != 0);
+      priority_buffers_to_send_.push_back(buffer);
+
+      if (reliable_)
+      {
+        const uint64_t credit_window_messages = le64toh(handshake_request_.credit_window_messages);
+        const uint64_t credit_window_bytes    = le64toh(handshake_request_.credit_window_bytes);
+        if (credit_window_messages == 0)
+        {
+          // The subscriber does not know about credit. The queue is then
+          // drained as fast as TCP lets us send.
+          credit_unlimited_ = true;
+        }
+        else
+        {
+          // The subscriber must not make us queue an arbitrary amount of
+          // data. It learns the window we use from the response.
+          credit_window_messages_ = std::min(credit_window_messages, max_credit_window_messages_);
+          if ((max_credit_window_bytes_ == 0) || ((credit_window_bytes > 0) && (credit_window_bytes < max_credit_window_bytes_)))
+            credit_window_bytes_  = credit_window_bytes;
+          credit_messages_        = credit_window_messages_;
+          credit_bytes_           = credit_window_bytes_;
+
+          handshake_message->credit_window_messages = htole64(credit_window_messages_);
+          handshake_message->credit_window_bytes    = htole64(credit_window_bytes_);
+        }
+
+        // The queue size may have changed
+        reliable_buffers_cv_.notify_all();
+      }
+      else
+      {
+        min_interval_ns_ = le64toh(handshake_request_.min_interval_ns);
+      }
+    }
 
-    // Send the buffer directly to the client
-    sendBufferToClient(buffer);
     transient_local_push_handler_(shared_from_this());
-    State old_state = state_.exchange(State::Running);
-    if (old_state != State::Handshaking)
-      state_ = old_state;
+
+    {
+      std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+      State old_state = state_.exchange(State::Running);
+      if (old_state != State::Handshaking)
+        state_ = old_state;
+
+      if (!sending_in_progress_)
+      {
+        sending_in_progress_ = true;
+        sendNextBufferToClient();
+      }
+    }
   }
 
   //////////////////////////////////////////////
   /// Send Data
   //////////////////////////////////////////////
 
-  void PublisherSession::pushTransientBuffer(const std::shared_ptr<std::vector<char>>& buffer)
+  const ProtocolHandshakeMessage& PublisherSession::handshakeRequest() const
+  {
+    return handshake_request_;
+  }
+
+  void PublisherSession::pushTransientBuffers(const std::shared_ptr<const std::vector<std::shared_ptr<std::vector<char>>>>& buffers, size_t begin)
   {
-    // called from transient_local_push_handler_
+    // called from transient_local_push_handler_. The buffers are sent once the
+    // handshake response has been sent. The list may be shared with other
+    // sessions, so we only keep a reference and our position in it.
     std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
-    if ((state_ == State::Handshaking) && !sending_in_progress_)
+    if ((state_ == State::Handshaking) && (begin < buffers->size()))
     {
-      sending_in_progress_ = true;
-      sendBufferToClient(buffer);
+      transient_buffers_to_send_         = buffers;
+      transient_buffers_to_send_position_ = begin;
     }
   }
 
-  void PublisherSession::sendDataBuffer(const std::shared_ptr<std::vector<char>>& buffer)
+  void PublisherSession::setNextSendTicket(uint64_t send_ticket)
+  {
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+    next_send_ticket_ = send_ticket;
+  }
+
+  void PublisherSession::sendDataBuffer(const std::shared_ptr<std::vector<char>>& buffer, uint64_t send_ticket, int64_t publish_time_ns)
   {
     if (state_ == State::Canceled)
       return;
 
-#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    std::stringstream buffer_pointer_ss;
-    buffer_pointer_ss << "0x" << std::hex << buffer.get();
-    const std::string buffer_pointer_string = buffer_pointer_ss.str();
-#endif
+    TCP_PUBSUB_TRACE(SessionEnqueue, sequenceNumberOfBuffer(*buffer));
 
     {
       std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
 
+      // Concurrent sends hand their buffers to the sessions in any order.
+      // The subscriber would drop a buffer that arrives after a newer one.
+      if (send_ticket < next_send_ticket_)
+      {
+        dropped_buffers_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      next_send_ticket_ = send_ticket + 1;
+
       if ((state_ == State::Running) &&  !sending_in_progress_)
       {
-        // If we are not sending a buffer at the moment, we can directly trigger sending the given buffer
+        sending_in_progress_ = true;
+
+        // If we are not sending a buffer at the moment, we can directly trigger
+        // sending the given buffer, unless the subscriber has received the
+        // last one too recently.
+        if (!waitForRateLimitIfNecessary())
+        {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-        log_(logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Trigger sending buffer " + buffer_pointer_string + ".");
+          TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Trigger sending buffer " + logger::pointerString(buffer.get()) + ".");
 #endif
-        sending_in_progress_ = true;
-        sendBufferToClient(buffer);
+          sendBufferToClient(buffer, publish_time_ns);
+          return;
+        }
       }
-      else
+
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Saved buffer " + logger::pointerString(buffer.get()) + " as next buffer.");
+#endif
+      // Store the new buffer as next buffer. Replacing a buffer that only
+      // waits for the rate limit is what the subscriber has asked for, so it
+      // does not count as a drop.
+      if (next_buffer_to_send_)
       {
+        if (rate_limit_waiting_)
+          downsampled_buffers_.fetch_add(1, std::memory_order_relaxed);
+        else
+          dropped_buffers_.fetch_add(1, std::memory_order_relaxed);
+      }
+      next_buffer_to_send_             = buffer;
+      next_buffer_publish_time_ns_     = publish_time_ns;
+    }
+  }
+
+  PublisherSessionStatistics PublisherSession::getStatistics() const
+  {
+    PublisherSessionStatistics statistics;
+    statistics.remote_endpoint_  = remoteEndpointToString();
+    statistics.publish_to_write_ = publish_to_write_histogram_.snapshot();
+    return statistics;
+  }
+
+  uint64_t PublisherSession::getDroppedBufferCount() const
+  {
+    return dropped_buffers_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t PublisherSession::getDownsampledBufferCount() const
+  {
+    return downsampled_buffers_.load(std::memory_order_relaxed);
+  }
+
+  size_t PublisherSession::getQueuedBufferCount()
+  {
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+    return reliable_buffers_to_send_.size() + priority_buffers_to_send_.size() + (next_buffer_to_send_ ? 1 : 0);
+  }
+
+  bool PublisherSession::sendReliableDataBuffer(const std::shared_ptr<std::vector<char>>& buffer, uint64_t send_ticket, int64_t publish_time_ns, std::chrono::steady_clock::time_point deadline)
+  {
+    std::unique_lock<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+    // Concurrent sends queue their buffers in the order of their tickets. A
+    // buffer that is larger than the entire bytes window only fits into an
+    // empty queue.
+    const auto may_queue = [this, send_ticket, buffer_size = static_cast<uint64_t>(buffer->size())]() -> bool
+                           {
+                             return (state_ == State::Canceled) || evicted_
+                                 || ((send_ticket == next_send_ticket_)
+                                    && (reliable_buffers_to_send_.size() < credit_window_messages_)
+                                    && ((credit_window_bytes_ == 0) || reliable_buffers_to_send_.empty() || (reliable_queued_bytes_ + buffer_size <= credit_window_bytes_)));
+                           };
+
+    if (deadline != std::chrono::steady_clock::time_point::max())
+    {
+      // A deadline that has passed already only checks for room
+      if (!reliable_buffers_cv_.wait_until(next_buffer_lock, deadline, may_queue))
+        return false;
+    }
+    else
+    {
+      reliable_buffers_cv_.wait(next_buffer_lock, may_queue);
+    }
+
+    if ((state_ == State::Canceled) || evicted_)
+      return true;
+
+    reliable_buffers_to_send_ .push_back(buffer);
+    reliable_publish_times_ns_.push_back(publish_time_ns);
+    reliable_queued_bytes_ += buffer->size();
+    TCP_PUBSUB_TRACE(SessionEnqueue, sequenceNumberOfBuffer(*buffer));
+
+    // The send with the next ticket may already be waiting
+    next_send_ticket_++;
+    reliable_buffers_cv_.notify_all();
+
+    if ((state_ == State::Running) && !sending_in_progress_)
+    {
+      sending_in_progress_ = true;
+      sendNextBufferToClient();
+    }
+
+    return true;
+  }
+
+  bool PublisherSession::sendPriorityBuffer(const std::shared_ptr<std::vector<char>>& buffer)
+  {
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+    if (state_ == State::Canceled)
+      return false;
+
+    priority_buffers_to_send_.push_back(buffer);
+
+    // Priority buffers do not wait for the rate limit of the live data
+    if ((state_ == State::Running) && (!sending_in_progress_ || rate_limit_waiting_))
+    {
+      sending_in_progress_ = true;
+      rate_limit_waiting_  = false;
+      sendNextBufferToClient();
+    }
+
+    return true;
+  }
+
+  void PublisherSession::grantCredit(uint64_t messages, uint64_t bytes)
+  {
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+    if (!reliable_ || credit_unlimited_)
+      return;
+
+    // Never exceed the window, even if the subscriber returns more than it
+    // has granted (e.g. for a buffer that has been larger than the window).
+    credit_messages_ = std::min(credit_messages_ + messages, credit_window_messages_);
+    credit_bytes_    = std::min(credit_bytes_    + bytes,    credit_window_bytes_);
+
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-        log_(logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Saved buffer " + buffer_pointer_string + " as next buffer.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Received credit for " + std::to_string(messages) + " messages / " + std::to_string(bytes) + " bytes.");
 #endif
-        // Store the new buffer as next buffer
-        next_buffer_to_send_             = buffer;
+
+    if ((state_ == State::Running) && !sending_in_progress_)
+    {
+      sending_in_progress_ = true;
+      sendNextBufferToClient();
+    }
+  }
+
+  bool PublisherSession::consumeCredit(size_t bytes)
+  {
+    // next_buffer_mutex_ must be locked by the caller
+
+    if (!reliable_ || credit_unlimited_)
+      return true;
+
+    if (credit_messages_ == 0)
+      return false;
+
+    if (credit_window_bytes_ > 0)
+    {
+      // A buffer that is larger than the entire window can only be sent
+      // when the subscriber has returned all credit.
+      if ((bytes > credit_bytes_) && (credit_bytes_ < credit_window_bytes_))
+        return false;
+
+      credit_bytes_ -= std::min(static_cast<uint64_t>(bytes), credit_bytes_);
+    }
+
+    credit_messages_--;
+    return true;
+  }
+
+  void PublisherSession::sendNextBufferToClient()
+  {
+    // next_buffer_mutex_ must be locked by the caller
+
+    if (!priority_buffers_to_send_.empty())
+    {
+      // Priority buffers and the transient local history are sent as
+      // gather-write of the existing buffers. We only take a limited amount
+      // of buffers at once, so a long history does not end up as one huge
+      // write operation.
+      const size_t buffer_count = std::min(priority_buffers_to_send_.size(), max_buffers_per_write_);
+
+      auto buffers = std::make_shared<std::vector<std::shared_ptr<std::vector<char>>>>();
+      buffers->reserve(buffer_count);
+      for (size_t i = 0; i < buffer_count; i++)
+      {
+        buffers->push_back(std::move(priority_buffers_to_send_.front()));
+        priority_buffers_to_send_.pop_front();
       }
+
+      sendBuffersToClient(buffers, 0, buffers->size(), {});
+    }
+    else if (transient_buffers_to_send_)
+    {
+      // Live data must not overtake the history, so while waiting for the
+      // rate limit, sending_in_progress_ stays set and live data is only
+      // stored as next buffer.
+      if (waitForReplayWindowIfNecessary())
+        return;
+
+      // With a rate limit, we send the history buffer by buffer, so a single
+      // write cannot exceed the limit by more than one buffer.
+      const size_t begin   = transient_buffers_to_send_position_;
+      const size_t max_end = std::min(transient_buffers_to_send_->size(), begin + (replay_max_bytes_per_second_ > 0 ? 1 : max_buffers_per_write_));
+
+      // The history also counts against the credit of reliable sessions
+      size_t end = begin;
+      while ((end < max_end) && consumeCredit((*transient_buffers_to_send_)[end]->size()))
+        end++;
+
+      if (end == begin)
+      {
+        // Sending continues once the subscriber grants more credit
+        sending_in_progress_ = false;
+        return;
+      }
+
+      if (replay_max_bytes_per_second_ > 0)
+      {
+        uint64_t bytes = 0;
+        for (size_t i = begin; i < end; i++)
+          bytes += (*transient_buffers_to_send_)[i]->size();
+
+        replay_window_.emplace_back(std::chrono::steady_clock::now(), bytes);
+        replay_window_bytes_ += bytes;
+      }
+
+      std::shared_ptr<const std::vector<std::shared_ptr<std::vector<char>>>> buffers = transient_buffers_to_send_;
+
+      transient_buffers_to_send_position_ = end;
+      if (transient_buffers_to_send_position_ >= transient_buffers_to_send_->size())
+        transient_buffers_to_send_.reset();
+
+      sendBuffersToClient(buffers, begin, end, {});
+    }
+    else if (!reliable_buffers_to_send_.empty())
+    {
+      auto                 buffers = std::make_shared<std::vector<std::shared_ptr<std::vector<char>>>>();
+      std::vector<int64_t> publish_times_ns;
+      buffers->reserve(std::min(reliable_buffers_to_send_.size(), max_buffers_per_write_));
+      while (!reliable_buffers_to_send_.empty()
+            && (buffers->size() < max_buffers_per_write_)
+            && consumeCredit(reliable_buffers_to_send_.front()->size()))
+      {
+        reliable_queued_bytes_ -= reliable_buffers_to_send_.front()->size();
+        buffers->push_back(std::move(reliable_buffers_to_send_.front()));
+        if (reliable_publish_times_ns_.front() != 0)
+          publish_times_ns.push_back(reliable_publish_times_ns_.front()); // Without latency histograms, all times are 0, so we save the allocation
+        reliable_buffers_to_send_ .pop_front();
+        reliable_publish_times_ns_.pop_front();
+      }
+
+      if (buffers->empty())
+      {
+        // Sending continues once the subscriber grants more credit
+        sending_in_progress_ = false;
+        return;
+      }
+
+      reliable_buffers_cv_.notify_all();
+      sendBuffersToClient(buffers, 0, buffers->size(), std::move(publish_times_ns));
+    }
+    else if (next_buffer_to_send_)
+    {
+      // The next buffer may still be replaced by a newer one while we wait
+      if (waitForRateLimitIfNecessary())
+        return;
+
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Next buffer is available, trigger sending it.");
+#endif
+      // Copy the next buffer to send from the member variable
+      // to a temporary variable. Then delete the member variable,
+      // so when adding a new buffer as next buffer, it is clear
+      // that we now have taken ownership of that buffer.
+      auto next_buffer_tmp = next_buffer_to_send_;
+      next_buffer_to_send_ = nullptr;
+
+      // Send the next buffer to the client
+      sendBufferToClient(next_buffer_tmp, next_buffer_publish_time_ns_);
+    }
+    else
+    {
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": No next buffer available.");
+#endif
+      sending_in_progress_ = false;
     }
   }
 
-  void PublisherSession::sendBufferToClient(const std::shared_ptr<std::vector<char>>& buffer)
+  void PublisherSession::sendBufferToClient(const std::shared_ptr<std::vector<char>>& buffer, int64_t publish_time_ns)
   {
     if (state_ == State::Canceled)
       return;
 
+    // Older subscribers need the header to be shortened, which is done by the gather-write
+    if (!sequence_number_header_)
+    {
+      const auto buffers = std::make_shared<const std::vector<std::shared_ptr<std::vector<char>>>>(1, buffer);
+      sendBuffersToClient(buffers, 0, 1, { publish_time_ns });
+      return;
+    }
+
+    TCP_PUBSUB_TRACE(WriteStart, sequenceNumberOfBuffer(*buffer));
+
     asio::async_write(data_socket_
                 , asio::buffer(*buffer)
                 , data_strand_.wrap(
-                  [me = shared_from_this(), buffer](asio::error_code ec, std::size_t /*bytes_to_transfer*/)
+                  [me = shared_from_this(), buffer, publish_time_ns](asio::error_code ec, std::size_t /*bytes_to_transfer*/)
                   {
+                    if (ec)
+                    {
+                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "PublisherSession " + me->endpointToString() + ": Failed sending data: " + ec.message());
+                      me->sessionClosedHandler();
+                      return;
+                    }
+
+                    if (me->state_ == State::Canceled)
+                      return;
+
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                    std::stringstream buffer_pointer_ss;
-                    buffer_pointer_ss << "0x" << std::hex << buffer.get();
-                    const std::string buffer_pointer_string = buffer_pointer_ss.str();
+                    TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose, "PublisherSession " + me->endpointToString() + ": Successfully sent buffer " + logger::pointerString(buffer.get()) + ".");
 #endif
+                    TCP_PUBSUB_TRACE(WriteComplete, sequenceNumberOfBuffer(*buffer));
+                    me->publish_to_write_histogram_.recordSince(publish_time_ns);
+
+                    std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
+                    me->sendNextBufferToClient();
+                  }
+                ));
+  }
+
+  void PublisherSession::sendBuffersToClient(const std::shared_ptr<const std::vector<std::shared_ptr<std::vector<char>>>>& buffers, size_t begin, size_t end, std::vector<int64_t> publish_times_ns)
+  {
+    if (state_ == State::Canceled)
+      return;
+
+    // Older subscribers get each buffer with a short copy of its header. The
+    // copies are reserved up front, so they don't move while being added.
+    std::shared_ptr<std::vector<char>> short_headers;
+    if (!sequence_number_header_)
+    {
+      short_headers = std::make_shared<std::vector<char>>();
+      short_headers->reserve((end - begin) * short_tcp_header_size);
+    }
+
+    std::vector<asio::const_buffer> buffer_sequence;
+    buffer_sequence.reserve(short_headers ? 2 * (end - begin) : (end - begin));
+    for (size_t i = begin; i < end; i++)
+    {
+      const std::vector<char>& buffer      = *(*buffers)[i];
+      const uint16_t           header_size = le16toh(reinterpret_cast<const TcpHeader*>(buffer.data())->header_size);
+
+      if (short_headers && (header_size > short_tcp_header_size))
+      {
+        const size_t   short_header_position = short_headers->size();
+        const uint16_t short_header_size     = htole16(short_tcp_header_size);
+        short_headers->insert(short_headers->end(), buffer.data(), buffer.data() + short_tcp_header_size);
+        std::memcpy(&(*short_headers)[short_header_position], &short_header_size, sizeof(short_header_size));
+
+        buffer_sequence.push_back(asio::buffer(&(*short_headers)[short_header_position], short_tcp_header_size));
+        buffer_sequence.push_back(asio::buffer(buffer.data() + header_size, buffer.size() - header_size));
+      }
+      else
+      {
+        buffer_sequence.push_back(asio::buffer(buffer));
+      }
+      TCP_PUBSUB_TRACE(WriteStart, sequenceNumberOfBuffer(buffer));
+    }
+
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Sending " + std::to_string(end - begin) + " buffers in one write operation.");
+#endif
+
+    // The handler keeps the buffer list alive until the write operation has finished
+    asio::async_write(data_socket_
+                , buffer_sequence
+                , data_strand_.wrap(
+                  [me = shared_from_this(), buffers, short_headers, begin, end, publish_times_ns = std::move(publish_times_ns)](asio::error_code ec, std::size_t /*bytes_to_transfer*/)
+                  {
                     if (ec)
                     {
-                      me->log_(logger::LogLevel::Warning, "PublisherSession " + me->endpointToString() + ": Failed sending data: " + ec.message());
+                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "PublisherSession " + me->endpointToString() + ": Failed sending data: " + ec.message());
                       me->sessionClosedHandler();
                       return;
                     }
@@ -359,37 +890,119 @@ namespace tcp_pubsub
                     if (me->state_ == State::Canceled)
                       return;
 
-                    {
-                      std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
+#if (TCP_PUBSUB_TRACING_ENABLED)
+                    for (size_t i = begin; i < end; i++)
+                      TCP_PUBSUB_TRACE(WriteComplete, sequenceNumberOfBuffer(*(*buffers)[i]));
+#else
+                    static_cast<void>(begin);
+                    static_cast<void>(end);
+#endif
+                    for (const int64_t publish_time_ns : publish_times_ns)
+                      me->publish_to_write_histogram_.recordSince(publish_time_ns);
+
+                    std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
+                    me->sendNextBufferToClient();
+                  }
+                ));
+  }
+
+  bool PublisherSession::waitForReplayWindowIfNecessary()
+  {
+    // next_buffer_mutex_ must be locked by the caller
+
+    if (replay_max_bytes_per_second_ == 0)
+      return false;
+
+    const auto now        = std::chrono::steady_clock::now();
+    const auto window_len = std::chrono::seconds(1);
+
+    // Forget all writes that have left the sliding window
+    while (!replay_window_.empty() && (replay_window_.front().first + window_len <= now))
+    {
+      replay_window_bytes_ -= replay_window_.front().second;
+      replay_window_.pop_front();
+    }
+
+    if (replay_window_bytes_ < replay_max_bytes_per_second_)
+      return false;
 
-                      if (me->next_buffer_to_send_)
-                      {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                        me->log_(logger::LogLevel::DebugVerbose, "PublisherSession " + me->endpointToString() + ": Successfully sent buffer " + buffer_pointer_string + ". Next buffer is available, trigger sending it.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "PublisherSession " + endpointToString() + ": Replay rate limit reached. Pausing history.");
 #endif
-                        // We have a next buffer!
 
-                        // Copy the next buffer to send from the member variable
-                        // to a temporary variable. Then delete the member variable,
-                        // so when adding a new buffer as next buffer, it is clear
-                        // that we now have taken ownership of that buffer.
-                        auto next_buffer_tmp             = me->next_buffer_to_send_;
+    // Continue once the oldest write has left the window
+    replay_timer_.expires_at(replay_window_.front().first + window_len);
+    replay_timer_.async_wait(data_strand_.wrap(
+                  [me = shared_from_this()](asio::error_code ec)
+                  {
+                    if (ec || (me->state_ == State::Canceled))
+                      return;
 
-                        me->next_buffer_to_send_         = nullptr;
+                    std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
+                    me->sendNextBufferToClient();
+                  }
+                ));
+    return true;
+  }
 
-                        // Send the next buffer to the client
-                        me->sendBufferToClient(next_buffer_tmp);
-                      }
-                      else
-                      {
-#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                        me->log_(logger::LogLevel::DebugVerbose, "PublisherSession " + me->endpointToString() + ": Successfully sent buffer " + buffer_pointer_string + ". No next buffer available.");
+  void PublisherSession::setMinInterval(uint64_t min_interval_ns)
+  {
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+    if (reliable_)
+      return;
+
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "PublisherSession " + endpointToString() + ": Subscriber has requested a minimum interval of " + std::to_string(min_interval_ns) + " ns.");
 #endif
-                        me->sending_in_progress_ = false;
-                      }
-                    }
+
+    min_interval_ns_ = min_interval_ns;
+
+    // A waiting buffer may be due earlier (or later) now
+    if ((state_ == State::Running) && rate_limit_waiting_)
+    {
+      rate_limit_waiting_ = false;
+      sendNextBufferToClient();
+    }
+  }
+
+  bool PublisherSession::waitForRateLimitIfNecessary()
+  {
+    // next_buffer_mutex_ must be locked by the caller
+
+    if (min_interval_ns_ == 0)
+      return false;
+
+    const auto now             = std::chrono::steady_clock::now();
+    const auto next_write_time = last_live_write_time_ + std::chrono::nanoseconds(min_interval_ns_);
+
+    if (now >= next_write_time)
+    {
+      last_live_write_time_ = now;
+      return false;
+    }
+
+    // Only the latest buffer is sent once the interval has passed. Setting
+    // the expiry time cancels a previous wait.
+    rate_limit_waiting_ = true;
+    rate_limit_timer_.expires_at(next_write_time);
+    rate_limit_timer_.async_wait(data_strand_.wrap(
+                  [me = shared_from_this()](asio::error_code ec)
+                  {
+                    if (ec || (me->state_ == State::Canceled))
+                      return;
+
+                    std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
+
+                    // Sending may have been resumed already, e.g. for an RPC response
+                    if (!me->rate_limit_waiting_)
+                      return;
+
+                    me->rate_limit_waiting_ = false;
+                    me->sendNextBufferToClient();
                   }
                 ));
+    return true;
   }
 
   //////////////////////////////////////////////
@@ -3,12 +3,16 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <deque>
 
 #include <asio.hpp>
 
 #include "tcp_header.h"
+#include "protocol_handshake_message.h"
+#include "latency_histogram.h"
 #include "tcp_pubsub_logger_abstraction.h"
 
 namespace tcp_pubsub
@@ -35,7 +39,13 @@ namespace tcp_pubsub
     PublisherSession(const std::shared_ptr<asio::io_service>&                               io_service
                     , const std::function<void(const std::shared_ptr<PublisherSession>&)>&  session_closed_handler
                     , const std::function<void(const std::shared_ptr<PublisherSession>&)>&  transient_local_push_handler
-                    , const tcp_pubsub::logger::logger_t&                                        log_function);
+                    , const std::function<void(const std::shared_ptr<PublisherSession>&, const std::shared_ptr<std::vector<char>>&, uint64_t)>& rpc_request_handler
+                    , uint64_t                                                              publisher_instance_id
+                    , bool                                                                  reliable
+                    , uint64_t                                                              max_credit_window_messages
+                    , uint64_t                                                              max_credit_window_bytes
+                    , uint64_t                                                              replay_max_bytes_per_second
+                    , const tcp_pubsub::logger::Logger&                                        log_function);
 
     // Copy
     PublisherSession(const PublisherSession&)            = delete;
@@ -55,6 +65,11 @@ namespace tcp_pubsub
     void start();
     void cancel();
 
+    // Closes a reliable session that has not granted credit in time. Threads
+    // waiting to queue a buffer return immediately and the session is closed
+    // from the data_strand_.
+    void evict();
+
   private:
     void sessionClosedHandler();
   
@@ -71,14 +86,59 @@ namespace tcp_pubsub
 
     void sendProtocolHandshakeResponse();
 
+  public:
+    // Handshake message received from the subscriber. Only valid from the
+    // transient_local_push_handler on.
+    const ProtocolHandshakeMessage& handshakeRequest() const;
+
   //////////////////////////////////////////////
   /// Send Data
   //////////////////////////////////////////////
   public:
-    void pushTransientBuffer(const std::shared_ptr<std::vector<char>>& buffer);
-    void sendDataBuffer(const std::shared_ptr<std::vector<char>>& buffer);
+    void pushTransientBuffers(const std::shared_ptr<const std::vector<std::shared_ptr<std::vector<char>>>>& buffers, size_t begin);
+
+    // Send tickets are counted by the publisher in the order of the sequence
+    // numbers. The session gets the first one when it is added to the
+    // publisher's session list.
+    void setNextSendTicket(uint64_t send_ticket);
+
+    // Stores the buffer as the next one to send. A buffer with an older
+    // ticket than the last one is dropped, as a newer one has overtaken it.
+    void sendDataBuffer(const std::shared_ptr<std::vector<char>>& buffer, uint64_t send_ticket, int64_t publish_time_ns);
+
+    // Queues the buffer without ever dropping it. Blocks until all buffers
+    // with older tickets have been queued and the queue has room. Returns
+    // false, if that has not happened before the deadline
+    // (time_point::max() = wait indefinitely).
+    bool sendReliableDataBuffer(const std::shared_ptr<std::vector<char>>& buffer, uint64_t send_ticket, int64_t publish_time_ns, std::chrono::steady_clock::time_point deadline);
+
+    // Queues a buffer that is sent before any data and does not count against
+    // the credit (e.g. an RPC response). Returns false, if the session has
+    // been canceled.
+    bool sendPriorityBuffer(const std::shared_ptr<std::vector<char>>& buffer);
+
+    PublisherSessionStatistics getStatistics() const;
+    uint64_t                   getDroppedBufferCount() const;
+    uint64_t                   getDownsampledBufferCount() const;
+    size_t                     getQueuedBufferCount();
+
   private:
-    void sendBufferToClient(const std::shared_ptr<std::vector<char>>& buffer);
+    void grantCredit(uint64_t messages, uint64_t bytes);
+    bool consumeCredit(size_t bytes);
+
+    void sendNextBufferToClient();
+    void sendBufferToClient(const std::shared_ptr<std::vector<char>>& buffer, int64_t publish_time_ns);
+    void sendBuffersToClient(const std::shared_ptr<const std::vector<std::shared_ptr<std::vector<char>>>>& buffers, size_t begin, size_t end, std::vector<int64_t> publish_times_ns);
+
+    bool waitForReplayWindowIfNecessary();
+
+    // Changes the minimum time between two live buffers requested by the
+    // subscriber. Ignored by reliable sessions.
+    void setMinInterval(uint64_t min_interval_ns);
+
+    // Returns true, if the next live buffer must not be sent before the
+    // minimum interval has passed. Sending continues from a timer then.
+    bool waitForRateLimitIfNecessary();
 
   //////////////////////////////////////////////
   /// (Status-) getters
@@ -103,16 +163,61 @@ namespace tcp_pubsub
     // Handlers
     const std::function<void(const std::shared_ptr<PublisherSession>&)>  session_closed_handler_;
     const std::function<void(const std::shared_ptr<PublisherSession>&)>  transient_local_push_handler_;
+    const std::function<void(const std::shared_ptr<PublisherSession>&, const std::shared_ptr<std::vector<char>>&, uint64_t)> rpc_request_handler_;  /// Called with the payload and correlation id of each RPC request. Requests are handled one after another in the order they have been received.
     // Logger                                    
-    const logger::logger_t                                               log_;                        /// Function for logging
+    const logger::Logger                                               log_;                        /// Function for logging
 
     // TCP Socket & Queue (protected by the strand!)
     asio::ip::tcp::socket     data_socket_;
     asio::io_service::strand  data_strand_;
 
+    ProtocolHandshakeMessage  handshake_request_;   /// [PROTECTED BY data_strand_!]
+    const uint64_t            publisher_instance_id_;
+    const bool                reliable_;            /// Whether this session never drops buffers and sends only as much as the subscriber has granted credit for
+
     // Variable holding if we are currently sending any data and what data to send next
-    std::mutex                         next_buffer_mutex_;
-    bool                               sending_in_progress_;
-    std::shared_ptr<std::vector<char>> next_buffer_to_send_;
+    std::mutex                                     next_buffer_mutex_;
+    bool                                           sending_in_progress_;
+    std::shared_ptr<std::vector<char>>             next_buffer_to_send_;
+    int64_t                                        next_buffer_publish_time_ns_; /// Time send() has been called for next_buffer_to_send_ (see LatencyHistogram::now())
+    std::deque<std::shared_ptr<std::vector<char>>> priority_buffers_to_send_;   /// Buffers that are never dropped and sent before anything else (e.g. the handshake response)
+    uint64_t                                       next_send_ticket_;           /// Send ticket of the next data buffer. Older ones have been overtaken (best effort) or must be queued first (reliable).
+    bool                                           sequence_number_header_;     /// Whether the subscriber supports the TcpHeader with sequence number. Older subscribers get all buffers with the short header.
+
+    std::shared_ptr<const std::vector<std::shared_ptr<std::vector<char>>>> transient_buffers_to_send_;           /// Transient local history that is sent after the priority buffers. May be shared with other sessions.
+    size_t                                                                 transient_buffers_to_send_position_;  /// Index of the next history buffer to send
+
+    static constexpr size_t                        max_buffers_per_write_ = 16; /// Maximum number of priority buffers that are handed to a single gather-write
+
+    // Rate limit for sending the transient local history (protected by next_buffer_mutex_)
+    const uint64_t                                                          replay_max_bytes_per_second_;  /// 0 means unlimited
+    asio::steady_timer                                                      replay_timer_;                 /// Delays sending the history, until the window has room again
+    std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>>  replay_window_;                /// History writes of the last second
+    uint64_t                                                                replay_window_bytes_;          /// Sum of the bytes in replay_window_
+
+    // Rate limit for live data requested by the subscriber (protected by next_buffer_mutex_)
+    uint64_t                                       min_interval_ns_;            /// 0 means unlimited
+    std::chrono::steady_clock::time_point          last_live_write_time_;       /// Time the last live buffer has been handed to the socket
+    asio::steady_timer                             rate_limit_timer_;           /// Delays the next live buffer until the interval has passed
+    bool                                           rate_limit_waiting_;         /// Whether sending waits for rate_limit_timer_. sending_in_progress_ stays set meanwhile, so newer buffers replace next_buffer_to_send_.
+
+    // Reliable mode (protected by next_buffer_mutex_)
+    std::deque<std::shared_ptr<std::vector<char>>> reliable_buffers_to_send_;
+    std::deque<int64_t>                            reliable_publish_times_ns_;  /// Time send() has been called for each element of reliable_buffers_to_send_
+    uint64_t                                       reliable_queued_bytes_;      /// Sum of the sizes of reliable_buffers_to_send_
+    std::condition_variable                        reliable_buffers_cv_;        /// Notified when reliable_buffers_to_send_ has room again or the session has been canceled
+    const uint64_t                                 max_credit_window_messages_; /// Limit for the window the subscriber asks for
+    const uint64_t                                 max_credit_window_bytes_;    /// 0 means unlimited
+    bool                                           credit_unlimited_;           /// The subscriber does not send credit. Buffers are only limited by the queue size then.
+    uint64_t                                       credit_window_messages_;     /// Maximum number of queued and unacknowledged buffers
+    uint64_t                                       credit_window_bytes_;        /// 0 means unlimited
+    uint64_t                                       credit_messages_;            /// Number of buffers we may still send
+    uint64_t                                       credit_bytes_;               /// Number of bytes we may still send
+    bool                                           evicted_;                    /// evict() has been called. Buffers are not queued anymore, even though the session may not have been closed yet.
+
+    // Statistics
+    LatencyHistogram                               publish_to_write_histogram_; /// From the send() call until the buffer has been written
+    std::atomic<uint64_t>                          dropped_buffers_;            /// Buffers that have been replaced by a newer one before they could be sent
+    std::atomic<uint64_t>                          downsampled_buffers_;        /// Buffers that have been replaced by a newer one while waiting for the rate limit of the subscriber
   };
 }
\ No newline at end of file
@@ -0,0 +1,21 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace tcp_pubsub
+{
+#pragma pack(push,1)
+  // This message shall always contain little endian numbers.
+  //
+  // Sent by a subscriber to change the rate it has requested in the
+  // handshake. The publisher then sends at most one live message per
+  // interval, i.e. only the latest one.
+  struct RateLimitMessage
+  {
+    uint64_t          min_interval_ns = 0;   // 0 means no limit
+  };
+#pragma pack(pop)
+}
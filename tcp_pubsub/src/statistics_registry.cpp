@@ -0,0 +1,156 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "statistics_registry.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <locale>
+#include <sstream>
+
+namespace tcp_pubsub
+{
+  namespace
+  {
+    // Upper bounds of the histogram buckets (in nanoseconds and as written to the le label)
+    const std::vector<std::pair<int64_t, const char*>> histogram_buckets =
+    {
+      {          1000, "1e-06"  },
+      {          5000, "5e-06"  },
+      {         10000, "1e-05"  },
+      {         50000, "5e-05"  },
+      {        100000, "0.0001" },
+      {        500000, "0.0005" },
+      {       1000000, "0.001"  },
+      {       5000000, "0.005"  },
+      {      10000000, "0.01"   },
+      {      50000000, "0.05"   },
+      {     100000000, "0.1"    },
+      {     500000000, "0.5"    },
+      {    1000000000, "1"      },
+    };
+
+    std::string withLabel(const std::string& labels, const std::string& additional_label)
+    {
+      return "{" + labels + (labels.empty() ? "" : ",") + additional_label + "}";
+    }
+
+    std::string withLabels(const std::string& labels)
+    {
+      return (labels.empty() ? std::string() : "{" + labels + "}");
+    }
+  }
+
+  ////////////////////////////////////////////////
+  // StatisticsCollector
+  ////////////////////////////////////////////////
+
+  std::string StatisticsCollector::label(const std::string& name, const std::string& value)
+  {
+    std::string escaped_value;
+    escaped_value.reserve(value.size());
+    for (const char c : value)
+    {
+      switch (c)
+      {
+      case '\\': escaped_value += "\\\\"; break;
+      case '"':  escaped_value += "\\\""; break;
+      case '\n': escaped_value += "\\n";  break;
+      default:   escaped_value += c;      break;
+      }
+    }
+    return name + "=\"" + escaped_value + "\"";
+  }
+
+  void StatisticsCollector::counter(const std::string& name, const std::string& help, const std::string& labels, uint64_t value)
+  {
+    family(name, help, "counter").samples_ += name + withLabels(labels) + " " + std::to_string(value) + "\n";
+  }
+
+  void StatisticsCollector::gauge(const std::string& name, const std::string& help, const std::string& labels, uint64_t value)
+  {
+    family(name, help, "gauge").samples_ += name + withLabels(labels) + " " + std::to_string(value) + "\n";
+  }
+
+  void StatisticsCollector::histogram(const std::string& name, const std::string& help, const std::string& labels, const std::vector<LatencyHistogramSnapshot>& snapshots)
+  {
+    std::vector<uint64_t> bucket_counts(histogram_buckets.size(), 0);
+    uint64_t              count  = 0;
+    int64_t               sum_ns = 0;
+
+    for (const auto& snapshot : snapshots)
+    {
+      count  += snapshot.count_;
+      sum_ns += snapshot.sum_ns_;
+
+      // Prometheus buckets are cumulative, so a snapshot bucket counts for
+      // every bucket whose bound is at least its own upper bound.
+      for (const auto& snapshot_bucket : snapshot.buckets_)
+      {
+        for (size_t i = 0; i < histogram_buckets.size(); i++)
+        {
+          if (snapshot_bucket.first <= histogram_buckets[i].first)
+            bucket_counts[i] += snapshot_bucket.second;
+        }
+      }
+    }
+
+    std::ostringstream sum_seconds;
+    sum_seconds.imbue(std::locale::classic());
+    sum_seconds << std::setprecision(12) << (static_cast<double>(sum_ns) / 1e9);
+
+    std::string& samples = family(name, help, "histogram").samples_;
+    for (size_t i = 0; i < histogram_buckets.size(); i++)
+      samples += name + "_bucket" + withLabel(labels, std::string("le=\"") + histogram_buckets[i].second + "\"") + " " + std::to_string(bucket_counts[i]) + "\n";
+    samples += name + "_bucket" + withLabel(labels, "le=\"+Inf\"") + " " + std::to_string(count) + "\n";
+    samples += name + "_sum"    + withLabels(labels) + " " + sum_seconds.str() + "\n";
+    samples += name + "_count"  + withLabels(labels) + " " + std::to_string(count) + "\n";
+  }
+
+  std::string StatisticsCollector::toPrometheusText() const
+  {
+    std::string text;
+    for (const auto& name_family : families_)
+    {
+      text += "# HELP " + name_family.first + " " + name_family.second.help_ + "\n";
+      text += "# TYPE " + name_family.first + " " + name_family.second.type_ + "\n";
+      text += name_family.second.samples_;
+    }
+    return text;
+  }
+
+  StatisticsCollector::Family& StatisticsCollector::family(const std::string& name, const std::string& help, const std::string& type)
+  {
+    Family& family = families_[name];
+    if (family.type_.empty())
+    {
+      family.help_ = help;
+      family.type_ = type;
+    }
+    return family;
+  }
+
+  ////////////////////////////////////////////////
+  // StatisticsRegistry
+  ////////////////////////////////////////////////
+
+  void StatisticsRegistry::add(const Source& source)
+  {
+    std::lock_guard<std::mutex> sources_lock(sources_mutex_);
+    sources_.push_back(source);
+  }
+
+  std::string StatisticsRegistry::toPrometheusText()
+  {
+    StatisticsCollector collector;
+
+    {
+      std::lock_guard<std::mutex> sources_lock(sources_mutex_);
+      sources_.erase(std::remove_if(sources_.begin(), sources_.end()
+                                    , [&collector](const Source& source) { return !source(collector); })
+                    , sources_.end());
+    }
+
+    return collector.toPrometheusText();
+  }
+}
@@ -0,0 +1,74 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <tcp_pubsub/latency_statistics.h>
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Collects metrics and renders them in the Prometheus text exposition format
+   *
+   * Samples of the same metric (e.g. of several publishers) are grouped, so
+   * the HELP and TYPE lines are written only once per metric. Metrics are
+   * rendered in alphabetical order.
+   */
+  class StatisticsCollector
+  {
+  public:
+    // Returns name="value", with the value escaped as required by the format
+    static std::string label(const std::string& name, const std::string& value);
+
+    void counter  (const std::string& name, const std::string& help, const std::string& labels, uint64_t value);
+    void gauge    (const std::string& name, const std::string& help, const std::string& labels, uint64_t value);
+
+    // Merges the given snapshots into one histogram with fixed buckets in
+    // seconds. Values are only known with the precision of the snapshot
+    // buckets, so a value may end up in the next larger bucket.
+    void histogram(const std::string& name, const std::string& help, const std::string& labels, const std::vector<LatencyHistogramSnapshot>& snapshots);
+
+    std::string toPrometheusText() const;
+
+  private:
+    struct Family
+    {
+      std::string help_;
+      std::string type_;
+      std::string samples_;   /// Complete sample lines, including the line breaks
+    };
+
+    Family& family(const std::string& name, const std::string& help, const std::string& type);
+
+  private:
+    std::map<std::string, Family> families_;
+  };
+
+  /**
+   * @brief List of everything that reports statistics to an Executor
+   *
+   * Each Publisher and Subscriber adds a source that writes its metrics to a
+   * collector. Sources only hold weak references to their owners and return
+   * false once their owner is gone, which removes them from the registry.
+   */
+  class StatisticsRegistry
+  {
+  public:
+    using Source = std::function<bool(StatisticsCollector&)>;
+
+    void        add(const Source& source);
+    std::string toPrometheusText();
+
+  private:
+    std::mutex          sources_mutex_;
+    std::vector<Source> sources_;
+  };
+}
@@ -11,16 +11,25 @@
 namespace tcp_pubsub
 {
   Subscriber::Subscriber(const std::shared_ptr<Executor>& executor)
-    : subscriber_impl_(std::make_shared<Subscriber_Impl>(executor))
+    : Subscriber(executor, SubscriberFlowControlSetting())
   {}
 
+  Subscriber::Subscriber(const std::shared_ptr<Executor>& executor, const SubscriberFlowControlSetting& flow_control_setting)
+    : subscriber_impl_(std::make_shared<Subscriber_Impl>(executor, flow_control_setting))
+  {
+    subscriber_impl_->registerStatistics();
+  }
+
   Subscriber::~Subscriber()
   {
     subscriber_impl_->cancel();
   }
 
   std::shared_ptr<SubscriberSession> Subscriber::addSession(const std::string& address, uint16_t port, int max_reconnection_attempts)
-    { return subscriber_impl_->addSession(address, port, max_reconnection_attempts); }
+    { return subscriber_impl_->addSession(address, port, SubscriberReplaySetting(), max_reconnection_attempts); }
+
+  std::shared_ptr<SubscriberSession> Subscriber::addSession(const std::string& address, uint16_t port, const SubscriberReplaySetting& replay_setting, int max_reconnection_attempts)
+    { return subscriber_impl_->addSession(address, port, replay_setting, max_reconnection_attempts); }
 
   std::vector<std::shared_ptr<SubscriberSession>> Subscriber::getSessions() const
     { return subscriber_impl_->getSessions(); }
@@ -31,6 +40,21 @@ namespace tcp_pubsub
   void Subscriber::clearCallback()
     { subscriber_impl_->setCallback([](const auto&){}, true); }
 
+  void Subscriber::setDeduplication(bool enabled)
+    { subscriber_impl_->setDeduplication(enabled); }
+
+  void Subscriber::setPullMode(const std::function<void()>& data_available_handler)
+    { subscriber_impl_->setPullMode(data_available_handler); }
+
+  CallbackData Subscriber::take()
+    { return subscriber_impl_->take(std::chrono::nanoseconds(-1)); }
+
+  CallbackData Subscriber::tryTake()
+    { return subscriber_impl_->take(std::chrono::nanoseconds(0)); }
+
+  CallbackData Subscriber::waitFor(std::chrono::nanoseconds timeout)
+    { return subscriber_impl_->take(timeout > std::chrono::nanoseconds(0) ? timeout : std::chrono::nanoseconds(0)); }
+
   void Subscriber::cancel()
     { subscriber_impl_->cancel(); }
 }
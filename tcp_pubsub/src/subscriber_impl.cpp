@@ -5,6 +5,7 @@
 
 #include "tcp_header.h"
 #include "portable_endian.h"
+#include "trace_points.h"
 #include "subscriber_session_impl.h"
 #include "executor_impl.h"
 
@@ -13,11 +14,19 @@ namespace tcp_pubsub
   ////////////////////////////////////////////////
   // Constructor & Destructor
   ////////////////////////////////////////////////
-  Subscriber_Impl::Subscriber_Impl(const std::shared_ptr<Executor>& executor)
+  Subscriber_Impl::Subscriber_Impl(const std::shared_ptr<Executor>& executor, const SubscriberFlowControlSetting& flow_control_setting)
     : executor_                    (executor)
+    , flow_control_setting_        (flow_control_setting)
     , user_callback_is_synchronous_(true)
+    , pull_mode_                   (false)
     , synchronous_user_callback_   ([](const auto&){})
+    , deduplication_enabled_       (false)
     , callback_thread_stop_        (true)
+    , received_messages_           (0)
+    , received_bytes_              (0)
+    , dropped_messages_            (0)
+    , duplicate_messages_          (0)
+    , closed_sessions_reconnects_  (0)
     , log_                         (executor_->executor_impl_->logFunction())
   {}
 
@@ -25,24 +34,21 @@ namespace tcp_pubsub
   Subscriber_Impl::~Subscriber_Impl()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    std::stringstream ss;
-    ss << std::this_thread::get_id();
-    std::string thread_id = ss.str();
-    log_(logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Deleting from thread " + thread_id + "...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Deleting from thread " + logger::threadIdString() + "...");
 #endif
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": Deleted.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": Deleted.");
 #endif
   }
 
   ////////////////////////////////////////////////
   // Session Management
   ////////////////////////////////////////////////
-  std::shared_ptr<SubscriberSession> Subscriber_Impl::addSession(const std::string& address, uint16_t port, int max_reconnection_attempts)
+  std::shared_ptr<SubscriberSession> Subscriber_Impl::addSession(const std::string& address, uint16_t port, const SubscriberReplaySetting& replay_setting, int max_reconnection_attempts)
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Adding session for endpoint " + address + ":" + std::to_string(port) + ".");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Adding session for endpoint " + address + ":" + std::to_string(port) + ".");
 #endif
 
     // Function for getting a free buffer
@@ -57,7 +63,7 @@ namespace tcp_pubsub
             = [me = shared_from_this()](const std::shared_ptr<SubscriberSession_Impl>& subscriber_session_impl) -> void
               {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                  me->log_(logger::LogLevel::Debug, "Subscriber " + me->subscriberIdString() + ": Removing session " + subscriber_session_impl->remoteEndpointToString() + ".");
+                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "Subscriber " + me->subscriberIdString() + ": Removing session " + subscriber_session_impl->remoteEndpointToString() + ".");
 #endif
                 std::lock_guard<std::mutex>session_list_lock(me->session_list_mutex_);
 
@@ -68,18 +74,40 @@ namespace tcp_pubsub
                                                 { return subscriber_session_impl == session->subscriber_session_impl_; });
                 if (session_it != me->session_list_.end())
                 {
+                  // Keep the statistics of the session, so the subscriber's counters never decrease
+                  const SubscriberSessionStatistics session_statistics = subscriber_session_impl->getStatistics();
+                  me->closed_sessions_reconnects_.fetch_add(subscriber_session_impl->getReconnectCount(), std::memory_order_relaxed);
+                  me->closed_sessions_header_to_payload_histogram_  .add(session_statistics.header_to_payload_);
+                  me->closed_sessions_payload_to_callback_histogram_.add(session_statistics.payload_to_callback_);
+
                   me->session_list_.erase(session_it);
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                  me->log_(logger::LogLevel::Debug, "Subscriber " + me->subscriberIdString() + ": Current number of sessions: " + std::to_string(me->session_list_.size()));
+                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "Subscriber " + me->subscriberIdString() + ": Current number of sessions: " + std::to_string(me->session_list_.size()));
 #endif
                 }
                 else
                 {
                   // This can never happen, unless I screwed up while implementing this
-                  me->log_(logger::LogLevel::Fatal, "Subscriber " + me->subscriberIdString() + ": Error removing subscriber: The subscriber does not exist");
+                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Fatal, "Subscriber " + me->subscriberIdString() + ": Error removing subscriber: The subscriber does not exist");
                 }
               };
 
+    // Function for forgetting the sequence numbers of a publisher instance
+    // that is gone. A restarted publisher counts from the start again, so its
+    // messages would otherwise be dropped as being too old.
+    std::function<void()> publisher_instance_changed_handler
+            = [me = shared_from_this()]() -> void
+              {
+                if (!me->deduplication_enabled_)
+                  return;
+
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+                TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "Subscriber " + me->subscriberIdString() + ": Publisher instance has changed. Resetting deduplication window.");
+#endif
+                std::lock_guard<std::mutex> deduplication_lock(me->deduplication_mutex_);
+                me->deduplication_window_.clear();
+              };
+
     // Create a new Subscriber Session. Unfortunatelly we cannot use
     // ::std::make_shared here, as the constructor is private and make_shared
     // cannot access it. Thus, we crate the object manually with new.
@@ -88,8 +116,11 @@ namespace tcp_pubsub
                                                                     , address
                                                                     , port
                                                                     , max_reconnection_attempts
+                                                                    , replay_setting
+                                                                    , flow_control_setting_
                                                                     , get_free_buffer_handler
                                                                     , subscriber_session_closed_handler
+                                                                    , publisher_instance_changed_handler
                                                                     , log_)));
 
     setCallbackToSession(subscriber_session);
@@ -112,30 +143,19 @@ namespace tcp_pubsub
   void Subscriber_Impl::setCallback(const std::function<void(const CallbackData& callback_data)>& callback_function, bool synchronous_execution)
   {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": Setting new " + (synchronous_execution ? "synchronous" : "asynchronous") + " callback.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": Setting new " + (synchronous_execution ? "synchronous" : "asynchronous") + " callback.");
 #endif
 
     // Stop and remove the old callback thread at first
-    if (callback_thread_)
-    {
-#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-      log_(logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Stopping old callback thread...");
-#endif
-      callback_thread_stop_ = true;
-      last_callback_data_cv_.notify_all();
+    stopCallbackThread();
 
-      // Join or detach the old thread. We cannot join a thread from it's own
-      // thread, so we detach the thread in that case.
-      if (std::this_thread::get_id() == callback_thread_->get_id())
-        callback_thread_->detach();
-      else
-        callback_thread_->join();
-
-      callback_thread_.reset();
-#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-      log_(logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Old callback thread has terminated.");
-#endif
+    // End the pull mode. Threads waiting in take() return empty-handed.
+    {
+      std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+      pull_mode_              = false;
+      data_available_handler_ = nullptr;
     }
+    last_callback_data_cv_.notify_all();
 
     const bool renew_synchronous_callbacks = (synchronous_execution || user_callback_is_synchronous_);
 
@@ -145,9 +165,20 @@ namespace tcp_pubsub
       synchronous_user_callback_    = callback_function;
       user_callback_is_synchronous_ = synchronous_execution;
 
-      // Clean the last callback data, so any buffer in there is freed
-      std::unique_lock<std::mutex> callback_lock(last_callback_data_mutex_);
-      last_callback_data_ = CallbackData();
+      // Clean the last callback data, so any buffer in there is freed. Queued
+      // reliable messages are handed to the new callback instead.
+      std::deque<ReliableCallbackData> reliable_callback_queue;
+      {
+        std::unique_lock<std::mutex> callback_lock(last_callback_data_mutex_);
+        last_callback_data_ = CallbackData();
+        std::swap(reliable_callback_queue, reliable_callback_queue_);
+      }
+      for (const auto& reliable_callback_data : reliable_callback_queue)
+      {
+        callback_function(reliable_callback_data.callback_data_);
+        if (auto session = reliable_callback_data.session_.lock())
+          session->releaseCredit(reliable_callback_data.frame_size_);
+      }
     }
     if (!synchronous_execution)
     {
@@ -161,24 +192,46 @@ namespace tcp_pubsub
                     {
                       for (;;)
                       {
-                        CallbackData this_callback_data; // create empty callback data
+                        CallbackData         this_callback_data; // create empty callback data
+                        ReliableCallbackData this_reliable_callback_data;
+                        bool                 is_reliable = false;
 
                         {
                           // Lock callback mutex and wait for valid data. Wake up if the callback data contains valid data or the user set a synchronous callback. In the latter case, we exit the thread.
                           std::unique_lock<std::mutex> callback_lock(me->last_callback_data_mutex_);
-                          me->last_callback_data_cv_.wait(callback_lock, [&me]() -> bool { return bool(me->last_callback_data_.buffer_) || me->callback_thread_stop_; });
+                          me->last_callback_data_cv_.wait(callback_lock, [&me]() -> bool { return bool(me->last_callback_data_.buffer_) || !me->reliable_callback_queue_.empty() || me->callback_thread_stop_; });
 
                           // Exit if the user has set a synchronous callback
                           if (me->callback_thread_stop_) return;
 
-                          std::swap(this_callback_data, me->last_callback_data_); // Now an empty callback data is in "last_callback_data" again
+                          if (!me->reliable_callback_queue_.empty())
+                          {
+                            // Messages of reliable sessions are processed first, as their sessions are waiting for credit
+                            this_reliable_callback_data = std::move(me->reliable_callback_queue_.front());
+                            me->reliable_callback_queue_.pop_front();
+                            std::swap(this_callback_data, this_reliable_callback_data.callback_data_);
+                            is_reliable = true;
+                          }
+                          else
+                          {
+                            std::swap(this_callback_data, me->last_callback_data_); // Now an empty callback data is in "last_callback_data" again
+                          }
                         }
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                        me->log_(logger::LogLevel::DebugVerbose, "Subscriber " + me->subscriberIdString() + ": Executing asynchronous callback");
+                        TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose, "Subscriber " + me->subscriberIdString() + ": Executing asynchronous callback");
 #endif            
                         // Execute the user callback. Note that the callback mutex is not locked any more, so while the expensive user callback is executed, our tcp sessions can already store new data.
+                        TCP_PUBSUB_TRACE(CallbackStart, this_callback_data.sequence_number_);
                         callback_function(this_callback_data);
+                        TCP_PUBSUB_TRACE(CallbackEnd, this_callback_data.sequence_number_);
+
+                        // Now the publisher may send another message
+                        if (is_reliable)
+                        {
+                          if (auto session = this_reliable_callback_data.session_.lock())
+                            session->releaseCredit(this_reliable_callback_data.frame_size_);
+                        }
                       }
                     });
     }
@@ -199,84 +252,356 @@ namespace tcp_pubsub
     if (user_callback_is_synchronous_)
     {
       session->subscriber_session_impl_->setSynchronousCallback(
-                [callback = synchronous_user_callback_, me = shared_from_this()](const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TcpHeader>& /*header*/)->void
+                [callback = synchronous_user_callback_, me = shared_from_this(), weak_session = std::weak_ptr<SubscriberSession_Impl>(session->subscriber_session_impl_)](const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TcpHeader>& header)->void
                 {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                  me->log_(logger::LogLevel::DebugVerbose, "Subscriber " + me->subscriberIdString() + ": Executing synchronous callback");
+                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose, "Subscriber " + me->subscriberIdString() + ": Executing synchronous callback");
 #endif            
-                  std::lock_guard<std::mutex> callback_lock(me->last_callback_data_mutex_);
-                  if (me->user_callback_is_synchronous_)
+                  me->received_messages_.fetch_add(1,                           std::memory_order_relaxed);
+                  me->received_bytes_   .fetch_add(le64toh(header->data_size), std::memory_order_relaxed);
+
+                  if (!me->isDuplicate(le64toh(header->sequence_number)))
                   {
-                    CallbackData callback_data;
-                    callback_data.buffer_           = buffer;
-                    callback(callback_data);
+                    std::unique_lock<std::mutex> callback_lock(me->last_callback_data_mutex_);
+                    if (me->user_callback_is_synchronous_)
+                    {
+                      CallbackData callback_data;
+                      callback_data.buffer_           = buffer;
+                      callback_data.sequence_number_  = le64toh(header->sequence_number);
+                      TCP_PUBSUB_TRACE(CallbackStart, callback_data.sequence_number_);
+                      callback(callback_data);
+                      TCP_PUBSUB_TRACE(CallbackEnd, callback_data.sequence_number_);
+                    }
+                    else
+                    {
+                      // The callback has been made asynchronous while this
+                      // message was on its way
+                      callback_lock.unlock();
+                      me->storeCallbackData(buffer, header, weak_session);
+                      return;
+                    }
                   }
+
+                  auto subscriber_session_impl = weak_session.lock();
+                  if (subscriber_session_impl && subscriber_session_impl->isReliable())
+                    subscriber_session_impl->releaseCredit(frameSize(header));
                 });
     }
     else
     {
       session->subscriber_session_impl_->setSynchronousCallback(
-                [me = shared_from_this()](const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TcpHeader>& /*header*/)->void
+                [me = shared_from_this(), weak_session = std::weak_ptr<SubscriberSession_Impl>(session->subscriber_session_impl_)](const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TcpHeader>& header)->void
                 {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                  me->log_(logger::LogLevel::DebugVerbose, "Subscriber " + me->subscriberIdString() + ": Storing data for  asynchronous callback");
+                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose, "Subscriber " + me->subscriberIdString() + ": Storing data for  asynchronous callback");
 #endif            
-                  std::lock_guard<std::mutex> callback_lock(me->last_callback_data_mutex_);
-                  if (!me->user_callback_is_synchronous_)
-                  {
-                    me->last_callback_data_.buffer_           = buffer;
+                  me->received_messages_.fetch_add(1,                           std::memory_order_relaxed);
+                  me->received_bytes_   .fetch_add(le64toh(header->data_size), std::memory_order_relaxed);
+
+                  auto subscriber_session_impl = weak_session.lock();
+                  const bool is_reliable = (subscriber_session_impl && subscriber_session_impl->isReliable());
 
-                    me->last_callback_data_cv_.notify_all();
+                  if (me->isDuplicate(le64toh(header->sequence_number)))
+                  {
+                    if (is_reliable)
+                      subscriber_session_impl->releaseCredit(frameSize(header));
+                    return;
                   }
+
+                  me->storeCallbackData(buffer, header, weak_session);
                 });
     }
   }
 
-  void Subscriber_Impl::cancel()
+  void Subscriber_Impl::storeCallbackData(const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TcpHeader>& header, const std::weak_ptr<SubscriberSession_Impl>& weak_session)
+  {
+    auto subscriber_session_impl = weak_session.lock();
+    const bool is_reliable = (subscriber_session_impl && subscriber_session_impl->isReliable());
+
+    bool                  had_data = false;
+    std::function<void()> data_available_handler;
+
+    {
+      std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+      if (user_callback_is_synchronous_)
+      {
+        // The callback has been made synchronous while this message was on
+        // its way. It is passed to the new callback, as a reliable publisher
+        // would otherwise wait for its credit forever.
+        CallbackData callback_data;
+        callback_data.buffer_           = buffer;
+        callback_data.sequence_number_  = le64toh(header->sequence_number);
+        TCP_PUBSUB_TRACE(CallbackStart, callback_data.sequence_number_);
+        synchronous_user_callback_(callback_data);
+        TCP_PUBSUB_TRACE(CallbackEnd, callback_data.sequence_number_);
+
+        if (is_reliable)
+          subscriber_session_impl->releaseCredit(frameSize(header));
+        return;
+      }
+
+      had_data = (last_callback_data_.buffer_ || !reliable_callback_queue_.empty());
+
+      if (is_reliable)
+      {
+        // The publisher only sends as many messages as we have granted
+        // credit for, so this queue cannot grow beyond the credit window of
+        // all sessions.
+        ReliableCallbackData reliable_callback_data;
+        reliable_callback_data.callback_data_.buffer_          = buffer;
+        reliable_callback_data.callback_data_.sequence_number_ = le64toh(header->sequence_number);
+        reliable_callback_data.session_                        = weak_session;
+        reliable_callback_data.frame_size_                     = frameSize(header);
+        reliable_callback_queue_.push_back(std::move(reliable_callback_data));
+      }
+      else
+      {
+        // The callback thread (or take()) has not picked up the previous message yet
+        if (last_callback_data_.buffer_)
+          dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+
+        last_callback_data_.buffer_           = buffer;
+        last_callback_data_.sequence_number_  = le64toh(header->sequence_number);
+      }
+
+      if (!had_data && pull_mode_)
+        data_available_handler = data_available_handler_;
+    }
+
+    // Nobody can be waiting, if there has been data already. So conflated
+    // data does not wake up any thread.
+    if (!had_data)
+    {
+      last_callback_data_cv_.notify_all();
+
+      if (data_available_handler)
+        data_available_handler();
+    }
+  }
+
+  void Subscriber_Impl::setDeduplication(bool enabled)
+  {
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": " + (enabled ? "Enabling" : "Disabling") + " deduplication.");
+#endif
+
+    std::lock_guard<std::mutex> deduplication_lock(deduplication_mutex_);
+    deduplication_window_.clear();
+    deduplication_enabled_ = enabled;
+  }
+
+  bool Subscriber_Impl::isDuplicate(uint64_t sequence_number)
+  {
+    if (!deduplication_enabled_ || (sequence_number == 0))
+      return false;
+
+    // Sessions run in parallel and may deliver different subsets of the
+    // messages, so we must remember each number and not only the greatest one.
+    {
+      std::lock_guard<std::mutex> deduplication_lock(deduplication_mutex_);
+      if (!deduplication_window_.insert(sequence_number))
+        return false;
+    }
+
+    duplicate_messages_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  void Subscriber_Impl::setPullMode(const std::function<void()>& data_available_handler)
   {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": Cancelling...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": Switching to pull mode.");
 #endif
 
+    stopCallbackThread();
+
+    const bool renew_synchronous_callbacks = user_callback_is_synchronous_;
+
+    synchronous_user_callback_ = [](const auto&) {};
+
+    {
+      std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+      pull_mode_              = true;
+      data_available_handler_ = data_available_handler;
+    }
+
+    // From now on, the sessions store their data just like for an
+    // asynchronous callback. take() picks it up instead of a callback thread.
+    user_callback_is_synchronous_ = false;
+
+    if (renew_synchronous_callbacks)
     {
       std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
       for (const auto& session : session_list_)
       {
-        session->cancel();
+        setCallbackToSession(session);
       }
     }
+  }
+
+  CallbackData Subscriber_Impl::take(std::chrono::nanoseconds timeout)
+  {
+    CallbackData         callback_data;
+    ReliableCallbackData reliable_callback_data;
+    bool                 is_reliable = false;
 
-    // Stop and remove the old callback thread at first
-    if (callback_thread_)
     {
+      std::unique_lock<std::mutex> callback_lock(last_callback_data_mutex_);
+
+      const auto data_available_or_ended = [this]() -> bool { return bool(last_callback_data_.buffer_) || !reliable_callback_queue_.empty() || !pull_mode_; };
+
+      if (timeout.count() < 0)
+        last_callback_data_cv_.wait(callback_lock, data_available_or_ended);
+      else if (timeout.count() > 0)
+        last_callback_data_cv_.wait_for(callback_lock, timeout, data_available_or_ended);
+
+      if (!pull_mode_)
+        return callback_data;
+
+      if (!reliable_callback_queue_.empty())
+      {
+        // Messages of reliable sessions are taken first, as their sessions are waiting for credit
+        reliable_callback_data = std::move(reliable_callback_queue_.front());
+        reliable_callback_queue_.pop_front();
+        std::swap(callback_data, reliable_callback_data.callback_data_);
+        is_reliable = true;
+      }
+      else
+      {
+        std::swap(callback_data, last_callback_data_);
+      }
+    }
+
+    // The message belongs to the caller now, so the publisher may send the next one
+    if (is_reliable)
+    {
+      if (auto session = reliable_callback_data.session_.lock())
+        session->releaseCredit(reliable_callback_data.frame_size_);
+    }
+
+    return callback_data;
+  }
+
+  void Subscriber_Impl::stopCallbackThread()
+  {
+    if (!callback_thread_)
+      return;
+
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-      log_(logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Stopping callback thread...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Stopping callback thread...");
 #endif
-      callback_thread_stop_ = true;
-      last_callback_data_cv_.notify_all();
+    callback_thread_stop_ = true;
+    last_callback_data_cv_.notify_all();
 
-      // Join or detach the old thread. We cannot join a thread from it's own
-      // thread, so we detach the thread in that case.
-      if (std::this_thread::get_id() == callback_thread_->get_id())
-        callback_thread_->detach();
-      else
-        callback_thread_->join();
+    // Join or detach the old thread. We cannot join a thread from it's own
+    // thread, so we detach the thread in that case.
+    if (std::this_thread::get_id() == callback_thread_->get_id())
+      callback_thread_->detach();
+    else
+      callback_thread_->join();
 
-      callback_thread_.reset();
+    callback_thread_.reset();
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-      log_(logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Callback thread has terminated.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "Subscriber " + subscriberIdString() + ": Callback thread has terminated.");
 #endif
+  }
+
+  void Subscriber_Impl::cancel()
+  {
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "Subscriber " + subscriberIdString() + ": Cancelling...");
+#endif
+
+    {
+      std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
+      for (const auto& session : session_list_)
+      {
+        session->cancel();
+      }
     }
 
+    // Stop and remove the old callback thread at first
+    stopCallbackThread();
+
+    // Queued messages will never be processed now
+    {
+      std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+      reliable_callback_queue_.clear();
+      pull_mode_              = false;
+      data_available_handler_ = nullptr;
+    }
+    last_callback_data_cv_.notify_all();
+
     // Delete the user callback
     synchronous_user_callback_    = [](const auto&){};
     user_callback_is_synchronous_ = true;
   }
 
+  uint64_t Subscriber_Impl::frameSize(const std::shared_ptr<TcpHeader>& header)
+  {
+    // Credit is counted in bytes on the wire, just like the publisher does
+    return le16toh(header->header_size) + le64toh(header->data_size);
+  }
+
   std::string Subscriber_Impl::subscriberIdString() const
   {
     std::stringstream ss;
     ss << "0x" << std::hex << this;
     return ss.str();
   }
+
+  ////////////////////////////////////////////////
+  // Statistics
+  ////////////////////////////////////////////////
+
+  void Subscriber_Impl::registerStatistics()
+  {
+    executor_->executor_impl_->statisticsRegistry().add(
+              [weak_me = std::weak_ptr<Subscriber_Impl>(shared_from_this()), labels = StatisticsCollector::label("subscriber", subscriberIdString())](StatisticsCollector& collector) -> bool
+              {
+                auto me = weak_me.lock();
+                if (!me)
+                  return false;
+
+                me->collectStatistics(collector, labels);
+                return true;
+              });
+  }
+
+  void Subscriber_Impl::collectStatistics(StatisticsCollector& collector, const std::string& labels) const
+  {
+    const auto sessions = getSessions();
+
+    uint64_t                              reconnects = closed_sessions_reconnects_.load(std::memory_order_relaxed);
+    std::vector<LatencyHistogramSnapshot> header_to_payload_snapshots;
+    std::vector<LatencyHistogramSnapshot> payload_to_callback_snapshots;
+    header_to_payload_snapshots  .reserve(sessions.size() + 1);
+    payload_to_callback_snapshots.reserve(sessions.size() + 1);
+    header_to_payload_snapshots  .push_back(closed_sessions_header_to_payload_histogram_  .snapshot());
+    payload_to_callback_snapshots.push_back(closed_sessions_payload_to_callback_histogram_.snapshot());
+
+    for (const auto& session : sessions)
+    {
+      const SubscriberSessionStatistics session_statistics = session->subscriber_session_impl_->getStatistics();
+      reconnects += session->subscriber_session_impl_->getReconnectCount();
+      header_to_payload_snapshots  .push_back(session_statistics.header_to_payload_);
+      payload_to_callback_snapshots.push_back(session_statistics.payload_to_callback_);
+    }
+
+    size_t queued_messages = 0;
+    {
+      std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+      queued_messages = reliable_callback_queue_.size() + (last_callback_data_.buffer_ ? 1 : 0);
+    }
+
+    collector.counter  ("tcp_pubsub_subscriber_messages_total",         "Number of messages received",                                                            labels, received_messages_.load(std::memory_order_relaxed));
+    collector.counter  ("tcp_pubsub_subscriber_bytes_total",            "Number of payload bytes received",                                                       labels, received_bytes_.load(std::memory_order_relaxed));
+    collector.counter  ("tcp_pubsub_subscriber_dropped_messages_total", "Number of messages that have been replaced by a newer one before the callback could process them", labels, dropped_messages_.load(std::memory_order_relaxed));
+    collector.counter  ("tcp_pubsub_subscriber_duplicate_messages_total", "Number of messages that have been dropped, because another session has received them already", labels, duplicate_messages_.load(std::memory_order_relaxed));
+    collector.counter  ("tcp_pubsub_subscriber_reconnects_total",       "Number of times a session has tried to connect again",                                   labels, reconnects);
+    collector.gauge    ("tcp_pubsub_subscriber_sessions",               "Number of sessions, whether connected or not",                                           labels, sessions.size());
+    collector.gauge    ("tcp_pubsub_subscriber_queued_messages",        "Number of messages waiting for the asynchronous callback",                               labels, queued_messages);
+    collector.histogram("tcp_pubsub_subscriber_header_to_payload_seconds",   "Time from receiving the first header byte until the payload is complete",           labels, header_to_payload_snapshots);
+    collector.histogram("tcp_pubsub_subscriber_payload_to_callback_seconds", "Time from the complete payload until the callback is invoked",                       labels, payload_to_callback_snapshots);
+  }
 }
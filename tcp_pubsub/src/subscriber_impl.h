@@ -7,6 +7,7 @@
 #include <string>
 #include <mutex>
 #include <vector>
+#include <deque>
 #include <functional>
 
 #include <asio.hpp>
@@ -15,11 +16,18 @@
 #include <tcp_pubsub/executor.h>
 #include <tcp_pubsub/subscriber_session.h>
 #include <tcp_pubsub/callback_data.h>
+#include <tcp_pubsub/subscriber.h>
 
 #include "tcp_pubsub_logger_abstraction.h"
+#include "tcp_header.h"
+#include "latency_histogram.h"
+#include "statistics_registry.h"
+#include "deduplication_window.h"
 
 namespace tcp_pubsub
 {
+  class SubscriberSession_Impl;
+
   class Subscriber_Impl : public std::enable_shared_from_this<Subscriber_Impl>
   {
   ////////////////////////////////////////////////
@@ -27,7 +35,7 @@ namespace tcp_pubsub
   ////////////////////////////////////////////////
   public:
     // Constructor
-    Subscriber_Impl(const std::shared_ptr<Executor>& executor);
+    Subscriber_Impl(const std::shared_ptr<Executor>& executor, const SubscriberFlowControlSetting& flow_control_setting);
 
     // Copy
     Subscriber_Impl(const Subscriber_Impl&)            = delete;
@@ -44,18 +52,41 @@ namespace tcp_pubsub
   // Session Management
   ////////////////////////////////////////////////
   public: 
-    std::shared_ptr<SubscriberSession>              addSession(const std::string& address, uint16_t port, int max_reconnection_attempts);
+    std::shared_ptr<SubscriberSession>              addSession(const std::string& address, uint16_t port, const SubscriberReplaySetting& replay_setting, int max_reconnection_attempts);
     std::vector<std::shared_ptr<SubscriberSession>> getSessions() const;
 
     void setCallback(const std::function<void(const CallbackData& callback_data)>& callback_function, bool synchronous_execution);
+
+    void         setDeduplication(bool enabled);
+    void         setPullMode(const std::function<void()>& data_available_handler);
+    CallbackData take(std::chrono::nanoseconds timeout);   /// Negative timeout: Wait until data is available
   private:
     void setCallbackToSession(const std::shared_ptr<SubscriberSession>& session);
 
+    // Passes a message to the asynchronous callback or take(). If the callback
+    // has been made synchronous meanwhile, the message is passed to it instead.
+    void storeCallbackData(const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TcpHeader>& header, const std::weak_ptr<SubscriberSession_Impl>& weak_session);
+    void stopCallbackThread();
+
   public:
     void cancel();
 
   private:
     std::string subscriberIdString() const;
+    static uint64_t frameSize(const std::shared_ptr<TcpHeader>& header);
+
+    // Returns true, if deduplication is enabled and a message with this
+    // sequence number has been passed on already
+    bool isDuplicate(uint64_t sequence_number);
+
+  ////////////////////////////////////////////////
+  // Statistics
+  ////////////////////////////////////////////////
+  public:
+    void registerStatistics();
+
+  private:
+    void collectStatistics(StatisticsCollector& collector, const std::string& labels) const;
 
   ////////////////////////////////////////////////
   // Member variables
@@ -63,6 +94,7 @@ namespace tcp_pubsub
   private:
     // Asio
     const std::shared_ptr<Executor>                 executor_;                 /// Global Executor
+    const SubscriberFlowControlSetting              flow_control_setting_;     /// Credit window granted to reliable publishers
 
     // List of all Sessions
     mutable std::mutex                              session_list_mutex_;
@@ -73,9 +105,27 @@ namespace tcp_pubsub
     std::condition_variable                         last_callback_data_cv_;
     CallbackData                                    last_callback_data_;
 
+    // Messages of reliable sessions are queued instead of overwriting
+    // last_callback_data_. Credit is returned to the session once the
+    // callback has processed the message. (protected by last_callback_data_mutex_)
+    struct ReliableCallbackData
+    {
+      CallbackData                          callback_data_;
+      std::weak_ptr<SubscriberSession_Impl> session_;
+      uint64_t                              frame_size_ = 0;
+    };
+    std::deque<ReliableCallbackData>                reliable_callback_queue_;
+
     std::atomic<bool>                               user_callback_is_synchronous_;
+    bool                                            pull_mode_;                /// [PROTECTED BY last_callback_data_mutex_!] Data is kept for take() instead of being passed to a callback
+    std::function<void()>                           data_available_handler_;   /// [PROTECTED BY last_callback_data_mutex_!] Called in pull mode, when data becomes available
     std::function<void(const CallbackData&)>        synchronous_user_callback_;
 
+    // Deduplication across sessions
+    std::atomic<bool>                               deduplication_enabled_;
+    std::mutex                                      deduplication_mutex_;
+    DeduplicationWindow                             deduplication_window_;     /// [PROTECTED BY deduplication_mutex_!] Sequence numbers that have been passed on since enabling deduplication
+
     std::unique_ptr<std::thread>                    callback_thread_;
     std::atomic<bool>                               callback_thread_stop_;
 
@@ -87,7 +137,16 @@ namespace tcp_pubsub
     };
     recycle::shared_pool<std::vector<char>, buffer_pool_lock_policy_> buffer_pool_;                 /// Buffer pool that let's us reuse memory chunks
 
+    // Statistics
+    std::atomic<uint64_t>                           received_messages_;                           /// Messages received by all sessions
+    std::atomic<uint64_t>                           received_bytes_;                              /// Payload bytes of received_messages_
+    std::atomic<uint64_t>                           dropped_messages_;                            /// Messages that have been replaced by a newer one before the asynchronous callback could process them
+    std::atomic<uint64_t>                           duplicate_messages_;                          /// Messages that have been dropped by the deduplication
+    std::atomic<uint64_t>                           closed_sessions_reconnects_;                  /// Reconnects of sessions that have been removed already
+    LatencyHistogram                                closed_sessions_header_to_payload_histogram_;   /// Latencies of sessions that have been removed already
+    LatencyHistogram                                closed_sessions_payload_to_callback_histogram_;
+
     // Log function
-    const tcp_pubsub::logger::logger_t log_;
+    const tcp_pubsub::logger::Logger log_;
   };
 }
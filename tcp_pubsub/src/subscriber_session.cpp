@@ -27,4 +27,16 @@ namespace tcp_pubsub
 
   bool SubscriberSession::isConnected() const
     { return subscriber_session_impl_->isConnected(); }
+
+  SubscriberSessionStatistics SubscriberSession::getStatistics() const
+    { return subscriber_session_impl_->getStatistics(); }
+
+  void SubscriberSession::setMaxRate(double max_messages_per_second)
+    { subscriber_session_impl_->setMaxRate(max_messages_per_second); }
+
+  RpcResponse SubscriberSession::call(const char* data, size_t size, std::chrono::nanoseconds timeout)
+    { return subscriber_session_impl_->call(data, size, timeout); }
+
+  bool SubscriberSession::callAsync(const char* data, size_t size, const std::function<void(const RpcResponse& response)>& callback)
+    { return subscriber_session_impl_->callAsync(data, size, callback); }
 }
@@ -3,12 +3,29 @@
 
 #include "subscriber_session_impl.h"
 
+#include <algorithm>
+#include <cstring>
+#include <future>
+
 #include "portable_endian.h"
+#include "trace_points.h"
 
 #include "protocol_handshake_message.h"
+#include "credit_grant_message.h"
+#include "rate_limit_message.h"
 
 namespace tcp_pubsub
 {
+  namespace
+  {
+    uint64_t minIntervalNs(double max_messages_per_second)
+    {
+      if (!(max_messages_per_second > 0.0))
+        return 0;
+      return std::max<uint64_t>(1, static_cast<uint64_t>(1e9 / max_messages_per_second));
+    }
+  }
+
   //////////////////////////////////////////////
   /// Constructor & Destructor
   //////////////////////////////////////////////
@@ -17,9 +34,12 @@ namespace tcp_pubsub
                                                 , const std::string&                                                  address
                                                 , uint16_t                                                            port
                                                 , int                                                                 max_reconnection_attempts
+                                                , const SubscriberReplaySetting&                                      replay_setting
+                                                , const SubscriberFlowControlSetting&                                 flow_control_setting
                                                 , const std::function<std::shared_ptr<std::vector<char>>()>&          get_buffer_handler
                                                 , const std::function<void(const std::shared_ptr<SubscriberSession_Impl>&)>& session_closed_handler
-                                                , const tcp_pubsub::logger::logger_t&                                      log_function)
+                                                , const std::function<void()>&                                        publisher_instance_changed_handler
+                                                , const tcp_pubsub::logger::Logger&                                      log_function)
     : address_                (address)
     , port_                   (port)
     , resolver_               (*io_service)
@@ -27,10 +47,28 @@ namespace tcp_pubsub
     , retries_left_           (max_reconnection_attempts)
     , retry_timer_            (*io_service, std::chrono::seconds(1))
     , canceled_               (false)
+    , reconnects_             (0)
+    , replay_setting_         (replay_setting)
+    , publisher_instance_id_  (0)
+    , last_sequence_number_   (0)
+    , flow_control_setting_   (flow_control_setting)
+    , handshake_complete_     (false)
+    , sequence_number_header_ (false)
+    , reliable_               (false)
+    , pending_credit_messages_(0)
+    , pending_credit_bytes_   (0)
+    , credit_window_messages_ (flow_control_setting.credit_window_messages_)
+    , credit_window_bytes_    (flow_control_setting.credit_window_bytes_)
+    , min_interval_ns_        (minIntervalNs(flow_control_setting.max_messages_per_second_))
+    , handshake_min_interval_ns_(0)
     , data_socket_            (*io_service)
     , data_strand_            (*io_service)
     , get_buffer_handler_     (get_buffer_handler)
     , session_closed_handler_ (session_closed_handler)
+    , publisher_instance_changed_handler_(publisher_instance_changed_handler)
+    , next_rpc_correlation_id_(1)
+    , rpc_closed_             (false)
+    , header_receive_time_ns_ (0)
     , log_                    (log_function)
   {}
 
@@ -38,16 +76,13 @@ namespace tcp_pubsub
   SubscriberSession_Impl::~SubscriberSession_Impl()
   {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    std::stringstream ss;
-    ss << std::this_thread::get_id();
-    std::string thread_id = ss.str();
-    log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Deleting from thread " + thread_id + "...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Deleting from thread " + logger::threadIdString() + "...");
 #endif
 
     cancel();
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Deleted.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Deleted.");
 #endif
   }
 
@@ -78,7 +113,7 @@ namespace tcp_pubsub
                               {
                                 if (ec)
                                 {
-                                  me->log_(logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed to resolve address: " + ec.message());
+                                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed to resolve address: " + ec.message());
                                   me->connectionFailedHandler();
                                   return;
                                 }
@@ -111,7 +146,7 @@ namespace tcp_pubsub
     endpoint_ = endpoint_to_connect_to;
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Trigger async connect to endpoint.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Trigger async connect to endpoint.");
 #endif // 
 
     data_socket_.async_connect(endpoint_to_connect_to
@@ -119,18 +154,18 @@ namespace tcp_pubsub
                               {
                                 if (ec)
                                 {
-                                  me->log_(logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed connecting to publisher: " + ec.message());
+                                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed connecting to publisher: " + ec.message());
                                   me->connectionFailedHandler();
                                   return;
                                 }
                                 else
                                 {
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                                  me->log_(logger::LogLevel::Debug, "SubscriberSession " + me->endpointToString() + ": Successfully connected to publisher " + me->endpointToString());
+                                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug, "SubscriberSession " + me->endpointToString() + ": Successfully connected to publisher " + me->endpointToString());
 #endif
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                                  me->log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + me->endpointToString() + ": Setting tcp::no_delay option.");
+                                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + me->endpointToString() + ": Setting tcp::no_delay option.");
 #endif
                                   // Disable Nagle's algorithm. Nagles Algorithm will otherwise cause the
                                   // Socket to wait for more data, if it encounters a frame that can still
@@ -139,7 +174,7 @@ namespace tcp_pubsub
                                   {
                                     asio::error_code nodelay_ec;
                                     me->data_socket_.set_option(asio::ip::tcp::no_delay(true), nodelay_ec);
-                                    if (nodelay_ec) me->log_(logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed setting tcp::no_delay option. The performance may suffer.");
+                                    if (nodelay_ec) TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed setting tcp::no_delay option. The performance may suffer.");
                                   }
 
                                   // Start reading a package by reading the header length. Everything will
@@ -158,20 +193,60 @@ namespace tcp_pubsub
     }
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug,  "SubscriberSession " + endpointToString() + ": Sending ProtocolHandshakeRequest.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug,  "SubscriberSession " + endpointToString() + ": Sending ProtocolHandshakeRequest.");
 #endif
 
+    // The publisher may not know the sequence number yet, so the handshake
+    // is sent with the short header
     std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
-    buffer->resize(sizeof(TcpHeader) + sizeof(ProtocolHandshakeMessage));
+    buffer->resize(short_tcp_header_size + sizeof(ProtocolHandshakeMessage));
 
     TcpHeader* header   = reinterpret_cast<TcpHeader*>(buffer->data());
-    header->header_size = htole16(sizeof(TcpHeader));
+    header->header_size = htole16(short_tcp_header_size);
     header->type        = MessageContentType::ProtocolHandshake;
     header->reserved    = 0;
     header->data_size   = htole64(sizeof(ProtocolHandshakeMessage));
 
-    ProtocolHandshakeMessage* handshake_message = reinterpret_cast<ProtocolHandshakeMessage*>(&(buffer->operator[](sizeof(TcpHeader))));
+    ProtocolHandshakeMessage* handshake_message = reinterpret_cast<ProtocolHandshakeMessage*>(&(buffer->operator[](short_tcp_header_size)));
     handshake_message->protocol_version         = 0; // At the moment, we only support Version 0. 
+    handshake_message->sequence_number_header   = 1;
+    handshake_message->credit_window_messages   = htole64(flow_control_setting_.credit_window_messages_);
+    handshake_message->credit_window_bytes      = htole64(flow_control_setting_.credit_window_bytes_);
+
+    handshake_min_interval_ns_                  = min_interval_ns_;
+    handshake_message->min_interval_ns          = htole64(handshake_min_interval_ns_);
+
+    // When reconnecting, we continue where the connection has been lost. The
+    // publisher falls back to its entire history, if it is not the instance
+    // we have been connected to before.
+    const uint64_t last_sequence_number = last_sequence_number_;
+    if (replay_setting_.resume_on_reconnect_ && (last_sequence_number > 0))
+    {
+      handshake_message->replay_mode            = ReplayMode::AfterSequenceNumber;
+      handshake_message->replay_sequence_number = htole64(last_sequence_number);
+      handshake_message->publisher_instance_id  = htole64(publisher_instance_id_);
+    }
+    else switch (replay_setting_.mode_)
+    {
+    case SubscriberReplaySetting::Mode::None:
+      handshake_message->replay_mode = ReplayMode::None;
+      break;
+    case SubscriberReplaySetting::Mode::LastN:
+      handshake_message->replay_mode  = ReplayMode::LastN;
+      handshake_message->replay_count = htole64(replay_setting_.count_);
+      break;
+    case SubscriberReplaySetting::Mode::SinceTime:
+      handshake_message->replay_mode     = ReplayMode::SinceTime;
+      handshake_message->replay_since_ns = static_cast<int64_t>(htole64(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(replay_setting_.since_.time_since_epoch()).count())));
+      break;
+    case SubscriberReplaySetting::Mode::AfterSequenceNumber:
+      handshake_message->replay_mode            = ReplayMode::AfterSequenceNumber;
+      handshake_message->replay_sequence_number = htole64(replay_setting_.sequence_number_);
+      break;
+    default:
+      handshake_message->replay_mode = ReplayMode::All;
+      break;
+    }
 
     asio::async_write(data_socket_
                 , asio::buffer(*buffer)
@@ -180,10 +255,13 @@ namespace tcp_pubsub
                   {
                     if (ec)
                     {
-                      me->log_(logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed sending ProtocolHandshakeRequest: " + ec.message());
+                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed sending ProtocolHandshakeRequest: " + ec.message());
                       me->connectionFailedHandler();
                       return;
                     }
+
+                    // All messages of this connection are read into the same header
+                    me->header_ = std::make_shared<TcpHeader>();
                     me->readHeaderLength();
                   }));
   }
@@ -196,14 +274,29 @@ namespace tcp_pubsub
       data_socket_.close(ec); // Even if ec indicates an error, the socket is closed now (according to the documentation)
     }
 
-    if (!canceled_ && (retries_left_ < 0 || retries_left_ > 0))
+    const bool reconnect = (!canceled_ && (retries_left_ < 0 || retries_left_ > 0));
+
+    // The credit belongs to the connection, so we must not send it on the next
+    // one. Requests sent on the connection will never be answered.
+    data_strand_.post([me = shared_from_this(), reconnect]()
+                      {
+                        me->write_queue_.clear();
+                        me->pending_credit_messages_ = 0;
+                        me->pending_credit_bytes_    = 0;
+                        me->handshake_complete_      = false;
+                        me->failRpcCalls(!reconnect);
+                      });
+
+    if (reconnect)
     {
       // Decrement the number of retries we have left
       if (retries_left_ > 0)
         retries_left_--;
 
+      reconnects_.fetch_add(1, std::memory_order_relaxed);
+
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-      log_(logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Waiting and retrying to connect");
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Waiting and retrying to connect");
 #endif
 
       // Retry connection after a short time
@@ -211,7 +304,11 @@ namespace tcp_pubsub
                               {
                                 if (ec)
                                 {
-                                  me->log_(logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Waiting to reconnect failed: " + ec.message());
+                                  TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Waiting to reconnect failed: " + ec.message());
+                                  me->data_strand_.post([me]()
+                                                        {
+                                                          me->failRpcCalls(true);
+                                                        });
                                   me->session_closed_handler_(me);
                                   return;
                                 }
@@ -237,10 +334,14 @@ namespace tcp_pubsub
     }
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose,  "SubscriberSession " + endpointToString() + ": Waiting for data...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose,  "SubscriberSession " + endpointToString() + ": Waiting for data...");
 #endif
 
-    std::shared_ptr<TcpHeader> header = std::make_shared<TcpHeader>();
+    // The previous message has already been passed to the callback, so we can
+    // reuse its header. A header sent by an older publisher may be shorter than
+    // ours, so we have to clear the remaining fields.
+    std::shared_ptr<TcpHeader> header = header_;
+    *header = TcpHeader();
 
     asio::async_read(data_socket_
                      , asio::buffer(&(header->header_size), sizeof(header->header_size))
@@ -252,10 +353,11 @@ namespace tcp_pubsub
                                             auto logger_level = logger::LogLevel::Error;
                                             if (ec.value() == static_cast<int>(std::errc::operation_canceled))
                                               logger_level = logger::LogLevel::Info;
-                                            me->log_(logger_level,  "SubscriberSession " + me->endpointToString() + ": Error reading header length: " + ec.message());
+                                            TCP_PUBSUB_LOG(me->log_, logger_level, "SubscriberSession " + me->endpointToString() + ": Error reading header length: " + ec.message());
                                             me->connectionFailedHandler();;
                                             return;
                                           }
+                                          me->header_receive_time_ns_ = LatencyHistogram::now();
                                           me->readHeaderContent(header);
                                         }));
   }
@@ -270,7 +372,7 @@ namespace tcp_pubsub
 
     if (header->header_size < sizeof(header->header_size))
     {
-      log_(logger::LogLevel::Error,  "SubscriberSession " + endpointToString() + ": Received header length of " + std::to_string(header->header_size) + ", which is less than the minimal header size.");
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error,  "SubscriberSession " + endpointToString() + ": Received header length of " + std::to_string(header->header_size) + ", which is less than the minimal header size.");
       connectionFailedHandler();
       return;
     }
@@ -288,15 +390,16 @@ namespace tcp_pubsub
                                         {
                                           if (ec)
                                           {
-                                            me->log_(logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Error reading header content: " + ec.message());
+                                            TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Error reading header content: " + ec.message());
                                             me->connectionFailedHandler();;
                                             return;
                                           }
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                                          me->log_(logger::LogLevel::DebugVerbose,  "SubscriberSession " + me->endpointToString()
+                                          TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose,  "SubscriberSession " + me->endpointToString()
                                             + ": Received header content: "
                                             + "data_size: "       + std::to_string(le64toh(header->data_size)));
 #endif
+                                          TCP_PUBSUB_TRACE(ReceiveHeader, le64toh(header->sequence_number));
 
                                           if (bytes_to_discard_from_socket > 0)
                                           {
@@ -317,21 +420,21 @@ namespace tcp_pubsub
       return;
     }
 
-    std::vector<char> data_to_discard;
-    data_to_discard.resize(bytes_to_discard);
+    // The buffer must live until the read operation has finished, so the handler keeps a reference to it
+    std::shared_ptr<std::vector<char>> data_to_discard = std::make_shared<std::vector<char>>(bytes_to_discard);
 
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose,  "SubscriberSession " + endpointToString() + ": Discarding " + std::to_string(bytes_to_discard) + " bytes after the header.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose,  "SubscriberSession " + endpointToString() + ": Discarding " + std::to_string(bytes_to_discard) + " bytes after the header.");
 #endif
 
     asio::async_read(data_socket_
-                    , asio::buffer(data_to_discard.data(), bytes_to_discard)
+                    , asio::buffer(data_to_discard->data(), bytes_to_discard)
                     , asio::transfer_at_least(bytes_to_discard)
-                    , data_strand_.wrap([me = shared_from_this(), header](asio::error_code ec, std::size_t /*length*/)
+                    , data_strand_.wrap([me = shared_from_this(), header, data_to_discard](asio::error_code ec, std::size_t /*length*/)
                                         {
                                           if (ec)
                                           {
-                                            me->log_(logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Error discarding bytes after header: " + ec.message());
+                                            TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Error discarding bytes after header: " + ec.message());
                                             me->connectionFailedHandler();;
                                             return;
                                           }
@@ -349,8 +452,18 @@ namespace tcp_pubsub
 
     if (header->data_size == 0)
     {
+      if ((header->type == MessageContentType::RpcResponse) || (header->type == MessageContentType::RpcError))
+      {
+        // Empty responses are valid
+        std::shared_ptr<std::vector<char>> data_buffer = get_buffer_handler_();
+        data_buffer->clear();
+        handleRpcResponse(header->type, le64toh(header->sequence_number), data_buffer);
+      }
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-        log_(logger::LogLevel::Debug,  "SubscriberSession " + endpointToString() + ": Received data size of 0.");
+      else
+      {
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug,  "SubscriberSession " + endpointToString() + ": Received data size of 0.");
+      }
 #endif
       readHeaderLength();
       return;
@@ -375,7 +488,7 @@ namespace tcp_pubsub
                                     {
                                       if (ec)
                                       {
-                                        me->log_(logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Error reading payload: " + ec.message());
+                                        TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Error reading payload: " + ec.message());
                                         me->connectionFailedHandler();;
                                         return;
                                       }
@@ -389,40 +502,116 @@ namespace tcp_pubsub
                                         size_t bytes_to_copy = std::min(data_buffer->size(), sizeof(ProtocolHandshakeMessage));
                                         std::memcpy(&handshake_message, data_buffer->data(), bytes_to_copy);
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-                                        me->log_(logger::LogLevel::Debug,  "SubscriberSession " + me->endpointToString() + ": Received Handshake message. Using Protocol version v" + std::to_string(handshake_message.protocol_version));
+                                        TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Debug,  "SubscriberSession " + me->endpointToString() + ": Received Handshake message. Using Protocol version v" + std::to_string(handshake_message.protocol_version));
 #endif
                                         if (handshake_message.protocol_version > 0)
                                         {
-                                          me->log_(logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Publisher set protocol version to v" + std::to_string(handshake_message.protocol_version) + ". This protocol is not supported.");
+                                          TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Error,  "SubscriberSession " + me->endpointToString() + ": Publisher set protocol version to v" + std::to_string(handshake_message.protocol_version) + ". This protocol is not supported.");
                                           me->connectionFailedHandler();
                                           return;
                                         }
+
+                                        // A different publisher instance counts its messages from the start
+                                        const uint64_t publisher_instance_id = le64toh(handshake_message.publisher_instance_id);
+                                        const uint64_t previous_instance_id  = me->publisher_instance_id_.exchange(publisher_instance_id);
+                                        if (previous_instance_id != publisher_instance_id)
+                                        {
+                                          me->last_sequence_number_ = 0;
+                                          if (previous_instance_id != 0)
+                                            me->publisher_instance_changed_handler_();
+                                        }
+
+                                        // The publisher starts with the entire window of credit. It
+                                        // may limit the window, so we must return credit earlier.
+                                        me->reliable_                = (handshake_message.reliable != 0);
+                                        me->pending_credit_messages_ = 0;
+                                        me->pending_credit_bytes_    = 0;
+                                        me->credit_window_messages_  = me->flow_control_setting_.credit_window_messages_;
+                                        me->credit_window_bytes_     = me->flow_control_setting_.credit_window_bytes_;
+                                        if (me->reliable_ && (handshake_message.credit_window_messages != 0))
+                                        {
+                                          me->credit_window_messages_ = le64toh(handshake_message.credit_window_messages);
+                                          me->credit_window_bytes_    = le64toh(handshake_message.credit_window_bytes);
+                                        }
+
+                                        // The publisher accepts other messages from now on. The
+                                        // rate limit may have changed since we sent the handshake.
+                                        // Older publishers only read the handshake, so they
+                                        // cannot answer requests.
+                                        me->handshake_complete_     = true;
+                                        me->sequence_number_header_ = (handshake_message.sequence_number_header != 0);
+                                        if (me->sequence_number_header_)
+                                        {
+                                          if (me->min_interval_ns_ != me->handshake_min_interval_ns_)
+                                            me->sendRateLimit();
+                                          me->sendUnsentRpcRequests();
+                                        }
+                                        else
+                                        {
+                                          me->rejectRpcCalls();
+                                        }
+                                      }
+                                      else if ((header->type == MessageContentType::RpcResponse) || (header->type == MessageContentType::RpcError))
+                                      {
+                                        // Responses are not counted against the credit
+                                        me->handleRpcResponse(header->type, le64toh(header->sequence_number), data_buffer);
                                       }
                                       else if (header->type == MessageContentType::RegularPayload)
                                       {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                                        me->log_(logger::LogLevel::DebugVerbose,  "SubscriberSession " + me->endpointToString() + ": Received message of type \"RegularPayload\"");
+                                        TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose,  "SubscriberSession " + me->endpointToString() + ": Received message of type \"RegularPayload\"");
 #endif
-                                        // Call the callback first, ...
-                                        me->data_strand_.post([me, data_buffer, header]()
+                                        me->header_to_payload_histogram_.recordSince(me->header_receive_time_ns_);
+                                        const int64_t payload_complete_time_ns = LatencyHistogram::now();
+
+                                        // Drop messages we already have received, e.g. because they
+                                        // have been both in the history and in the live data.
+                                        const uint64_t sequence_number = le64toh(header->sequence_number);
+                                        TCP_PUBSUB_TRACE(ReceivePayload, sequence_number);
+
+                                        if (sequence_number != 0)
+                                        {
+                                          if (me->replay_setting_.resume_on_reconnect_ && (sequence_number <= me->last_sequence_number_))
+                                          {
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+                                            TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose,  "SubscriberSession " + me->endpointToString() + ": Dropping duplicate message " + std::to_string(sequence_number));
+#endif
+                                            if (me->reliable_)
+                                              me->releaseCredit(le16toh(header->header_size) + le64toh(header->data_size));
+
+                                            me->data_strand_.post([me]()
+                                                                  {
+                                                                    me->readHeaderLength();
+                                                                  });
+                                            return;
+                                          }
+                                          me->last_sequence_number_ = sequence_number;
+                                        }
+
+                                        // Call the callback first, then start reading the next message
+                                        // into the same header. Both are done in one handler, so
+                                        // we only need to post once per message.
+                                        me->data_strand_.post([me, data_buffer, header, payload_complete_time_ns]()
                                                               {
                                                                 if (me->canceled_)
                                                                 {
                                                                   me->connectionFailedHandler();
                                                                   return;
                                                                 }
+                                                                me->payload_to_callback_histogram_.recordSince(payload_complete_time_ns);
                                                                 me->synchronous_callback_(data_buffer, header);
+                                                                me->readHeaderLength();
                                                               });
-
+                                        return;
                                       }
                                       else
                                       {
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-                                        me->log_(logger::LogLevel::DebugVerbose,  "SubscriberSession " + me->endpointToString() + ": Received message has unknow type: " + std::to_string(static_cast<int>(header->type)));
+                                        TCP_PUBSUB_LOG(me->log_, logger::LogLevel::DebugVerbose,  "SubscriberSession " + me->endpointToString() + ": Received message has unknow type: " + std::to_string(static_cast<int>(header->type)));
 #endif
                                       }
 
-                                      // ... then start reading the next message
+                                      // Start reading the next message
                                       me->data_strand_.post([me]()
                                                             {
                                                               me->readHeaderLength();
@@ -430,6 +619,296 @@ namespace tcp_pubsub
                                     }));
   }
 
+  /////////////////////////////////////////////
+  // Credit
+  /////////////////////////////////////////////
+
+  bool SubscriberSession_Impl::isReliable() const
+  {
+    return reliable_;
+  }
+
+  void SubscriberSession_Impl::releaseCredit(uint64_t frame_size)
+  {
+    data_strand_.post([me = shared_from_this(), frame_size]()
+                      {
+                        if (me->canceled_ || !me->reliable_)
+                          return;
+
+                        me->pending_credit_messages_++;
+                        me->pending_credit_bytes_ += frame_size;
+
+                        // Granting credit for each message would double the
+                        // amount of packets, so we wait until half the window
+                        // is used up.
+                        const uint64_t window_messages = me->credit_window_messages_;
+                        const uint64_t window_bytes    = me->credit_window_bytes_;
+
+                        if ((me->pending_credit_messages_ >= std::max<uint64_t>(1, window_messages / 2))
+                            || ((window_bytes > 0) && (me->pending_credit_bytes_ >= window_bytes / 2)))
+                        {
+                          me->sendCreditGrant();
+                        }
+                      });
+  }
+
+  void SubscriberSession_Impl::sendCreditGrant()
+  {
+    // Must be called from the data_strand_
+
+#if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose,  "SubscriberSession " + endpointToString() + ": Granting credit for " + std::to_string(pending_credit_messages_) + " messages / " + std::to_string(pending_credit_bytes_) + " bytes.");
+#endif
+
+    std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
+    buffer->resize(sizeof(TcpHeader) + sizeof(CreditGrantMessage));
+
+    TcpHeader* header   = reinterpret_cast<TcpHeader*>(buffer->data());
+    header->header_size = htole16(sizeof(TcpHeader));
+    header->type        = MessageContentType::CreditGrant;
+    header->reserved    = 0;
+    header->data_size   = htole64(sizeof(CreditGrantMessage));
+
+    CreditGrantMessage* credit_grant_message = reinterpret_cast<CreditGrantMessage*>(&(buffer->operator[](sizeof(TcpHeader))));
+    credit_grant_message->messages           = htole64(pending_credit_messages_);
+    credit_grant_message->bytes              = htole64(pending_credit_bytes_);
+
+    pending_credit_messages_ = 0;
+    pending_credit_bytes_    = 0;
+
+    queueWrite(buffer);
+  }
+
+  void SubscriberSession_Impl::setMaxRate(double max_messages_per_second)
+  {
+    min_interval_ns_ = minIntervalNs(max_messages_per_second);
+
+    // Before the handshake is complete, the new value is sent afterwards (or
+    // in the handshake of the next connection)
+    data_strand_.post([me = shared_from_this()]()
+                      {
+                        if (!me->canceled_ && me->handshake_complete_ && me->sequence_number_header_)
+                          me->sendRateLimit();
+                      });
+  }
+
+  void SubscriberSession_Impl::sendRateLimit()
+  {
+    // Must be called from the data_strand_
+
+#if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug,  "SubscriberSession " + endpointToString() + ": Requesting a minimum interval of " + std::to_string(min_interval_ns_) + " ns.");
+#endif
+
+    std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
+    buffer->resize(sizeof(TcpHeader) + sizeof(RateLimitMessage));
+
+    TcpHeader* header   = reinterpret_cast<TcpHeader*>(buffer->data());
+    header->header_size = htole16(sizeof(TcpHeader));
+    header->type        = MessageContentType::RateLimit;
+    header->reserved    = 0;
+    header->data_size   = htole64(sizeof(RateLimitMessage));
+
+    RateLimitMessage* rate_limit_message = reinterpret_cast<RateLimitMessage*>(&(buffer->operator[](sizeof(TcpHeader))));
+    rate_limit_message->min_interval_ns  = htole64(min_interval_ns_);
+
+    queueWrite(buffer);
+  }
+
+  void SubscriberSession_Impl::queueWrite(const std::shared_ptr<std::vector<char>>& buffer)
+  {
+    // Must be called from the data_strand_
+
+    write_queue_.push_back(buffer);
+    if (write_queue_.size() == 1)
+      writeNext();
+  }
+
+  void SubscriberSession_Impl::writeNext()
+  {
+    // Must be called from the data_strand_
+
+    asio::async_write(data_socket_
+                , asio::buffer(*write_queue_.front())
+                , data_strand_.wrap(
+                  [me = shared_from_this(), buffer = write_queue_.front()](asio::error_code ec, std::size_t /*bytes_to_transfer*/)
+                  {
+                    // The queue is cleared after a connection loss, so it
+                    // may already contain buffers of the next connection.
+                    const bool is_current_write = (!me->write_queue_.empty() && (me->write_queue_.front() == buffer));
+
+                    if (ec)
+                    {
+                      // Reading fails as well and takes care of reconnecting
+                      TCP_PUBSUB_LOG(me->log_, logger::LogLevel::Warning, "SubscriberSession " + me->endpointToString() + ": Failed sending message: " + ec.message());
+                      if (is_current_write)
+                        me->write_queue_.clear();
+                      return;
+                    }
+
+                    if (is_current_write)
+                    {
+                      me->write_queue_.pop_front();
+                      if (!me->write_queue_.empty())
+                        me->writeNext();
+                    }
+                  }));
+  }
+
+  /////////////////////////////////////////////
+  // RPC
+  /////////////////////////////////////////////
+
+  RpcResponse SubscriberSession_Impl::call(const char* data, size_t size, std::chrono::nanoseconds timeout)
+  {
+    auto                     promise = std::make_shared<std::promise<RpcResponse>>();
+    std::future<RpcResponse> future  = promise->get_future();
+
+    if (!callAsync(data, size, [promise](const RpcResponse& response) { promise->set_value(response); }))
+      return RpcResponse();
+
+    if ((timeout.count() > 0) && (future.wait_for(timeout) != std::future_status::ready))
+    {
+      RpcResponse response;
+      response.status_ = RpcResponse::Status::Timeout;
+      return response;
+    }
+
+    return future.get();
+  }
+
+  bool SubscriberSession_Impl::callAsync(const char* data, size_t size, const std::function<void(const RpcResponse&)>& callback)
+  {
+    if (canceled_) return false;
+
+    // The request is written to a buffer of the subscriber's buffer pool. The
+    // correlation id is only known in the strand.
+    std::shared_ptr<std::vector<char>> buffer = get_buffer_handler_();
+    buffer->resize(sizeof(TcpHeader) + size);
+
+    TcpHeader* header   = reinterpret_cast<TcpHeader*>(buffer->data());
+    header->header_size = htole16(sizeof(TcpHeader));
+    header->type        = MessageContentType::RpcRequest;
+    header->reserved    = 0;
+    header->data_size   = htole64(size);
+
+    if (size > 0)
+      std::memcpy(&(buffer->operator[](sizeof(TcpHeader))), data, size);
+
+    data_strand_.post([me = shared_from_this(), buffer, callback]()
+                      {
+                        if (me->rpc_closed_)
+                        {
+                          callback(RpcResponse());
+                          return;
+                        }
+
+                        const uint64_t correlation_id = me->next_rpc_correlation_id_++;
+                        reinterpret_cast<TcpHeader*>(buffer->data())->sequence_number = htole64(correlation_id);
+
+                        me->rpc_calls_[correlation_id] = RpcCall{ callback, me->handshake_complete_ };
+
+                        if (!me->handshake_complete_)
+                          me->rpc_unsent_requests_.push_back(buffer);
+                        else if (me->sequence_number_header_)
+                          me->queueWrite(buffer);
+                        else
+                          me->rejectRpcCalls();
+                      });
+
+    return true;
+  }
+
+  void SubscriberSession_Impl::handleRpcResponse(MessageContentType type, uint64_t correlation_id, const std::shared_ptr<std::vector<char>>& buffer)
+  {
+    // Must be called from the data_strand_
+
+    auto call_it = rpc_calls_.find(correlation_id);
+    if ((call_it == rpc_calls_.end()) || !call_it->second.sent_)
+    {
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "SubscriberSession " + endpointToString() + ": Received response to unknown request " + std::to_string(correlation_id) + ".");
+      return;
+    }
+
+    const std::function<void(const RpcResponse&)> callback = std::move(call_it->second.callback_);
+    rpc_calls_.erase(call_it);
+
+    RpcResponse response;
+    if (type == MessageContentType::RpcResponse)
+    {
+      response.status_ = RpcResponse::Status::Ok;
+      response.buffer_ = buffer;
+    }
+    else
+    {
+      response.status_ = RpcResponse::Status::NoHandler;
+    }
+
+    callback(response);
+  }
+
+  void SubscriberSession_Impl::sendUnsentRpcRequests()
+  {
+    // Must be called from the data_strand_
+
+    for (auto& call : rpc_calls_)
+      call.second.sent_ = true;
+
+    while (!rpc_unsent_requests_.empty())
+    {
+      queueWrite(rpc_unsent_requests_.front());
+      rpc_unsent_requests_.pop_front();
+    }
+  }
+
+  void SubscriberSession_Impl::rejectRpcCalls()
+  {
+    // Must be called from the data_strand_
+
+    rpc_unsent_requests_.clear();
+
+    // Collect the callbacks first, as they may make new requests
+    std::vector<std::function<void(const RpcResponse&)>> rejected_callbacks;
+    for (auto& call : rpc_calls_)
+      rejected_callbacks.push_back(std::move(call.second.callback_));
+    rpc_calls_.clear();
+
+    RpcResponse response;
+    response.status_ = RpcResponse::Status::NoHandler;
+
+    for (const auto& callback : rejected_callbacks)
+      callback(response);
+  }
+
+  void SubscriberSession_Impl::failRpcCalls(bool session_closed)
+  {
+    // Must be called from the data_strand_
+
+    if (session_closed)
+    {
+      rpc_closed_ = true;
+      rpc_unsent_requests_.clear();
+    }
+
+    // Collect the callbacks first, as they may make new requests
+    std::vector<std::function<void(const RpcResponse&)>> failed_callbacks;
+    for (auto call_it = rpc_calls_.begin(); call_it != rpc_calls_.end();)
+    {
+      if (session_closed || call_it->second.sent_)
+      {
+        failed_callbacks.push_back(std::move(call_it->second.callback_));
+        call_it = rpc_calls_.erase(call_it);
+      }
+      else
+      {
+        call_it++;
+      }
+    }
+
+    for (const auto& callback : failed_callbacks)
+      callback(RpcResponse());
+  }
+
   //////////////////////////////////////////////
   /// Public API
   //////////////////////////////////////////////
@@ -465,7 +944,7 @@ namespace tcp_pubsub
     if (already_canceled) return;
 
 #if (TCP_PUBSUB_LOG_DEBUG_ENABLED)
-    log_(logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Cancelling...");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Debug, "SubscriberSession " + endpointToString() + ": Cancelling...");
 #endif
     
     {
@@ -473,9 +952,9 @@ namespace tcp_pubsub
       data_socket_.close(ec);
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
       if (ec)
-        log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Failed closing socket: " + ec.message());
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Failed closing socket: " + ec.message());
       else
-        log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully closed socket.");
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully closed socket.");
 #endif
     }
 
@@ -484,9 +963,9 @@ namespace tcp_pubsub
       data_socket_.cancel(ec); // Even if ec indicates an error, the socket is closed now (according to the documentation)
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
       if (ec)
-        log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Failed cancelling socket: " + ec.message());
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Failed cancelling socket: " + ec.message());
       else
-        log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully canceled socket.");
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully canceled socket.");
 #endif
     }
 
@@ -495,15 +974,15 @@ namespace tcp_pubsub
       retry_timer_.cancel(ec);
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
       if (ec)
-        log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Failed canceling retry timer: " + ec.message());
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Failed canceling retry timer: " + ec.message());
       else
-        log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully canceled retry timer.");
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully canceled retry timer.");
 #endif
     }
 
     resolver_.cancel();
 #if (TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED)
-    log_(logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully canceled resovler.");
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::DebugVerbose, "SubscriberSession " + endpointToString() + ": Successfully canceled resovler.");
 #endif
   }
 
@@ -521,6 +1000,19 @@ namespace tcp_pubsub
       return true;
   }
 
+  SubscriberSessionStatistics SubscriberSession_Impl::getStatistics() const
+  {
+    SubscriberSessionStatistics statistics;
+    statistics.header_to_payload_   = header_to_payload_histogram_.snapshot();
+    statistics.payload_to_callback_ = payload_to_callback_histogram_.snapshot();
+    return statistics;
+  }
+
+  uint64_t SubscriberSession_Impl::getReconnectCount() const
+  {
+    return reconnects_.load(std::memory_order_relaxed);
+  }
+
   std::string SubscriberSession_Impl::remoteEndpointToString() const
   {
     return address_ + ":" + std::to_string(port_);
@@ -6,12 +6,18 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <deque>
 #include <functional>
+#include <map>
 
 #include <asio.hpp>
 
+#include <tcp_pubsub/subscriber.h>
+#include <tcp_pubsub/rpc.h>
+
 #include "tcp_pubsub_logger_abstraction.h"
 #include "tcp_header.h"
+#include "latency_histogram.h"
 
 namespace tcp_pubsub
 {
@@ -25,9 +31,12 @@ namespace tcp_pubsub
                           , const std::string&                                                  address
                           , uint16_t                                                            port
                           , int                                                                 max_reconnection_attempts
+                          , const SubscriberReplaySetting&                                      replay_setting
+                          , const SubscriberFlowControlSetting&                                 flow_control_setting
                           , const std::function<std::shared_ptr<std::vector<char>>()>&          get_buffer_handler
                           , const std::function<void(const std::shared_ptr<SubscriberSession_Impl>&)>& session_closed_handler
-                          , const tcp_pubsub::logger::logger_t&                                     log_function);
+                          , const std::function<void()>&                                        publisher_instance_changed_handler
+                          , const tcp_pubsub::logger::Logger&                                     log_function);
 
 
     // Copy
@@ -64,6 +73,43 @@ namespace tcp_pubsub
     void discardDataBetweenHeaderAndPayload(const std::shared_ptr<TcpHeader>& header, uint16_t bytes_to_discard);
     void readPayload(const std::shared_ptr<TcpHeader>& header);
 
+  /////////////////////////////////////////////
+  // Credit & Rate limit
+  /////////////////////////////////////////////
+  public:
+    bool isReliable() const;
+
+    // Returns the credit for a message that has been processed. Credit is
+    // collected and sent to the publisher once half the window is used up.
+    void releaseCredit(uint64_t frame_size);
+
+    // Asks the publisher to send at most this many messages per second. 0 means no limit.
+    void setMaxRate(double max_messages_per_second);
+
+  private:
+    void sendCreditGrant();
+    void sendRateLimit();
+    void queueWrite(const std::shared_ptr<std::vector<char>>& buffer);
+    void writeNext();
+
+  /////////////////////////////////////////////
+  // RPC
+  /////////////////////////////////////////////
+  public:
+    RpcResponse call(const char* data, size_t size, std::chrono::nanoseconds timeout);
+    bool        callAsync(const char* data, size_t size, const std::function<void(const RpcResponse&)>& callback);
+
+  private:
+    void handleRpcResponse(MessageContentType type, uint64_t correlation_id, const std::shared_ptr<std::vector<char>>& buffer);
+    void sendUnsentRpcRequests();
+
+    // Answers all requests with NoHandler, as the publisher is too old to read them
+    void rejectRpcCalls();
+
+    // Fails all requests that have been sent on the lost connection. When the
+    // session is closed, unsent requests fail as well.
+    void failRpcCalls(bool session_closed);
+
   //////////////////////////////////////////////
   /// Public API
   //////////////////////////////////////////////
@@ -76,6 +122,9 @@ namespace tcp_pubsub
     void        cancel();
     bool        isConnected() const;
 
+    SubscriberSessionStatistics getStatistics() const;
+    uint64_t    getReconnectCount() const;
+
     std::string remoteEndpointToString() const;
     std::string localEndpointToString() const;
     std::string endpointToString() const;
@@ -95,17 +144,57 @@ namespace tcp_pubsub
     int                retries_left_;
     asio::steady_timer retry_timer_;
     std::atomic<bool>  canceled_;
+    std::atomic<uint64_t> reconnects_;   /// Number of times we have waited and tried to connect again
+
+    // History requested from the publisher when connecting
+    const SubscriberReplaySetting replay_setting_;
+    std::atomic<uint64_t>         publisher_instance_id_;   /// Instance id the publisher has sent in the last handshake. 0 if unknown.
+    std::atomic<uint64_t>         last_sequence_number_;    /// Sequence number of the last message received from that instance
+
+    // Credit granted to reliable publishers
+    const SubscriberFlowControlSetting flow_control_setting_;
+    bool                          handshake_complete_;      /// [PROTECTED BY data_strand_!] Whether the publisher has answered the handshake of the current connection, so credit, rate limits and requests can be sent
+    bool                          sequence_number_header_;  /// [PROTECTED BY data_strand_!] Whether the publisher of the current connection supports the TcpHeader with sequence number. Older publishers only read the handshake.
+    std::atomic<bool>             reliable_;                /// Whether the publisher has told us in the handshake that it is reliable
+    uint64_t                      pending_credit_messages_; /// [PROTECTED BY data_strand_!] Credit that has been released, but not sent yet
+    uint64_t                      pending_credit_bytes_;    /// [PROTECTED BY data_strand_!]
+    uint64_t                      credit_window_messages_;  /// [PROTECTED BY data_strand_!] Window the publisher of the current connection uses. It may have made ours smaller.
+    uint64_t                      credit_window_bytes_;     /// [PROTECTED BY data_strand_!] 0 means unlimited
+
+    // Rate limit requested from the publisher
+    std::atomic<uint64_t>         min_interval_ns_;         /// Minimum time between two messages. 0 means no limit.
+    uint64_t                      handshake_min_interval_ns_;   /// Value of min_interval_ns_ sent in the handshake of the current connection
 
     // TCP Socket & Queue (protected by the strand!)
     asio::ip::tcp::socket         data_socket_;
     asio::io_service::strand      data_strand_;   // Used for socket operations and the callback. This is done so messages don't queue up in the asio stack. We only start receiving new messages, after we have delivered the current one.
+    std::deque<std::shared_ptr<std::vector<char>>> write_queue_;  /// [PROTECTED BY data_strand_!] Messages to the publisher. The first one is currently being written.
 
     // Handlers
     const std::function<std::shared_ptr<std::vector<char>>()>                                         get_buffer_handler_;         /// Function for retrieving / constructing an empty buffer
     const std::function<void(const std::shared_ptr<SubscriberSession_Impl>&)>                         session_closed_handler_;     /// Handler that is called when the session is closed
-    std::function<void(const std::shared_ptr<std::vector<char>>&, const std::shared_ptr<TcpHeader>&)> synchronous_callback_;       /// [PROTECTED BY data_strand_!] Callback that is called when a complete message has been received. Executed in the asio constext, so this must be cheap!
+    const std::function<void()>                                                                       publisher_instance_changed_handler_; /// Handler that is called when the session has reconnected to a different publisher instance, i.e. the sequence numbers start again
+    std::function<void(const std::shared_ptr<std::vector<char>>&, const std::shared_ptr<TcpHeader>&)> synchronous_callback_;       /// [PROTECTED BY data_strand_!] Callback that is called when a complete message has been received. Executed in the asio constext, so this must be cheap! The header is reused for the next message, so it must not be kept.
+
+    // RPC
+    struct RpcCall
+    {
+      std::function<void(const RpcResponse&)> callback_;
+      bool                                    sent_;      /// Whether the request has been queued on the current connection
+    };
+    uint64_t                      next_rpc_correlation_id_;         /// [PROTECTED BY data_strand_!]
+    bool                          rpc_closed_;                      /// [PROTECTED BY data_strand_!] The session will not connect again, so new requests fail right away
+    std::map<uint64_t, RpcCall>   rpc_calls_;                       /// [PROTECTED BY data_strand_!] Requests that have not been answered yet, by correlation id
+    std::deque<std::shared_ptr<std::vector<char>>> rpc_unsent_requests_;   /// [PROTECTED BY data_strand_!] Requests made while not connected
+
+    std::shared_ptr<TcpHeader>    header_;                          /// [PROTECTED BY data_strand_!] Header of the message that is currently being read. Created once per connection.
+
+    // Statistics
+    int64_t                       header_receive_time_ns_;          /// [PROTECTED BY data_strand_!] Time the first bytes of the current header have been received
+    LatencyHistogram              header_to_payload_histogram_;
+    LatencyHistogram              payload_to_callback_histogram_;
 
     // Logger
-    const tcp_pubsub::logger::logger_t log_;
+    const tcp_pubsub::logger::Logger log_;
   };
 }
@@ -5,12 +5,22 @@
 
 #include <stdint.h>
 
+#include <cstddef>
+#include <vector>
+
+#include "portable_endian.h"
+
 namespace tcp_pubsub
 {
   enum class MessageContentType : uint8_t
   {
     RegularPayload    = 0, // The Content is a user-defined payload that shall be given to the user code
     ProtocolHandshake = 1, // The contnet is a handshake message that defines which protocol version shall be used
+    CreditGrant       = 2, // The content is a CreditGrantMessage sent from a subscriber to a reliable publisher
+    RpcRequest        = 3, // The content is a request from a subscriber. The sequence number field carries the correlation id.
+    RpcResponse       = 4, // The content is the publisher's response to the request with the correlation id in the sequence number field
+    RpcError          = 5, // The publisher could not handle the request with the correlation id in the sequence number field (e.g. no handler is set). Has no content.
+    RateLimit         = 6, // The content is a RateLimitMessage sent from a subscriber to a publisher
 
     // This is meant for future use. At the moment, received messages that don't
     // have the type set to "RegularPayload" are discarded. So in the future,
@@ -28,8 +38,30 @@ namespace tcp_pubsub
     MessageContentType type            = MessageContentType::RegularPayload;
     uint8_t            reserved        = 0;                                   // Added for 32bit-alignment. Can later be reused e.g. as a flag field or similar.
     uint64_t           data_size       = 0;
+    uint64_t           sequence_number = 0;                                   // Number of the message in the publisher, starting at 1. The correlation id for RPC messages. 0 for all other message types and for publishers that do not count their messages.
   };
 
 #pragma pack(pop)
 
+  // Size of the header without the sequence number. Peers only use the entire
+  // header, if both have announced it in the ProtocolHandshakeMessage. Older
+  // peers expect this size, so the handshake messages always use it.
+  constexpr uint16_t short_tcp_header_size = offsetof(TcpHeader, sequence_number);
+
+  // Reads the sequence number from the header at the beginning of a buffer.
+  // Buffers restored from a journal may have been written with a header
+  // that does not contain a sequence number yet.
+  inline uint64_t sequenceNumberOfBuffer(const std::vector<char>& buffer)
+  {
+    if (buffer.size() < sizeof(TcpHeader))
+      return 0;
+
+    const TcpHeader* header = reinterpret_cast<const TcpHeader*>(buffer.data());
+    if (header->type != MessageContentType::RegularPayload)
+      return 0;
+    if (le16toh(header->header_size) < sizeof(TcpHeader))
+      return 0;
+
+    return le64toh(header->sequence_number);
+  }
 }
\ No newline at end of file
@@ -3,19 +3,22 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
 #include <tcp_pubsub/tcp_pubsub_logger.h>
 
 //
-// If DEBUG_VERBOSE is not set by the user, we enable it when compiling in
-// Debug mode. The user can still omit those verbose messages by setting a
-// logger function that drops the verbose messages.
+// Whether a message is logged is decided at runtime by the log level of the
+// Executor (see Executor::setLogLevel()). The following switches can remove
+// the debug messages from the binary entirely. By default they are compiled
+// in, as TCP_PUBSUB_LOG only formats a message after the level check.
 //
 #ifndef TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED
-  #ifdef NDEBUG
-    #define TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED 0
-  #else
-    #define TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED 1
-  #endif // NDEBUG
+  #define TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED 1
 #endif // !TCP_PUBSUB_LOG_DEBUG_VERBOSE_ENABLED
 
 //
@@ -25,14 +28,65 @@
   #define TCP_PUBSUB_LOG_DEBUG_ENABLED 1
 #endif
 
-//
-// If we haven't decided yet whether DEBUG logging shall be enabled, we enable
-// it when compiling in Debug mode and disable it otherwise.
-//
 #ifndef TCP_PUBSUB_LOG_DEBUG_ENABLED
-  #ifdef NDEBUG
-    #define TCP_PUBSUB_LOG_DEBUG_ENABLED 0
-  #else
-    #define TCP_PUBSUB_LOG_DEBUG_ENABLED 1
-  #endif // NDEBUG
+  #define TCP_PUBSUB_LOG_DEBUG_ENABLED 1
 #endif // !TCP_PUBSUB_LOG_DEBUG_ENABLED
+
+//
+// Logs a message, if the level is enabled. The message expression is only
+// evaluated in that case, so building the string (and e.g. looking up socket
+// endpoints for it) costs nothing while the level is disabled.
+//
+#define TCP_PUBSUB_LOG(logger, level, message)            \
+  do                                                      \
+  {                                                       \
+    if ((logger).isEnabled(level))                        \
+      (logger)(level, message);                           \
+  } while (false)
+
+namespace tcp_pubsub
+{
+  namespace logger
+  {
+    // The log function together with the minimal level that shall be logged.
+    // The level is shared with the Executor, so changing it at runtime affects
+    // all copies.
+    class Logger
+    {
+    public:
+      Logger(const logger_t& log_function, const std::shared_ptr<const std::atomic<LogLevel>>& log_level)
+        : log_function_(log_function)
+        , log_level_   (log_level)
+      {}
+
+      bool isEnabled(LogLevel log_level) const
+      {
+        return (log_level >= log_level_->load(std::memory_order_relaxed));
+      }
+
+      void operator()(LogLevel log_level, const std::string& message) const
+      {
+        if (isEnabled(log_level))
+          log_function_(log_level, message);
+      }
+
+    private:
+      logger_t                                     log_function_;
+      std::shared_ptr<const std::atomic<LogLevel>> log_level_;
+    };
+
+    inline std::string threadIdString()
+    {
+      std::stringstream ss;
+      ss << std::this_thread::get_id();
+      return ss.str();
+    }
+
+    inline std::string pointerString(const void* pointer)
+    {
+      std::stringstream ss;
+      ss << "0x" << std::hex << pointer;
+      return ss.str();
+    }
+  }
+}
@@ -0,0 +1,50 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+//
+// Trace points cost a clock read and a few stores per message and stage, so
+// they have to be enabled explicitly (see the CMake option
+// TCP_PUBSUB_ENABLE_TRACING). If disabled, the macros don't evaluate their
+// arguments.
+//
+#ifndef TCP_PUBSUB_TRACING_ENABLED
+  #define TCP_PUBSUB_TRACING_ENABLED 0
+#endif // !TCP_PUBSUB_TRACING_ENABLED
+
+namespace tcp_pubsub
+{
+  namespace tracing
+  {
+    enum class TracePoint : uint8_t
+    {
+      PublishEntry,
+      BufferFilled,
+      SessionEnqueue,
+      WriteStart,
+      WriteComplete,
+      ReceiveHeader,
+      ReceivePayload,
+      CallbackStart,
+      CallbackEnd,
+    };
+
+    int64_t now();
+
+    // Records a trace point into the ring buffer of the calling thread
+    void record(TracePoint trace_point, uint64_t message_id, int64_t timestamp_ns);
+  }
+}
+
+#if (TCP_PUBSUB_TRACING_ENABLED)
+  #define TCP_PUBSUB_TRACE_NOW()                                   ::tcp_pubsub::tracing::now()
+  #define TCP_PUBSUB_TRACE_AT(trace_point, message_id, timestamp)  ::tcp_pubsub::tracing::record(::tcp_pubsub::tracing::TracePoint::trace_point, (message_id), (timestamp))
+  #define TCP_PUBSUB_TRACE(trace_point, message_id)                TCP_PUBSUB_TRACE_AT(trace_point, message_id, TCP_PUBSUB_TRACE_NOW())
+#else
+  #define TCP_PUBSUB_TRACE_NOW()                                   int64_t(0)
+  #define TCP_PUBSUB_TRACE_AT(trace_point, message_id, timestamp)  do { static_cast<void>(timestamp); } while (false)
+  #define TCP_PUBSUB_TRACE(trace_point, message_id)                do {} while (false)
+#endif // TCP_PUBSUB_TRACING_ENABLED
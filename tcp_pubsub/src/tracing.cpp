@@ -0,0 +1,201 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include <tcp_pubsub/tracing.h>
+
+#include "trace_points.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <sys/prctl.h>
+#include <unistd.h>
+
+namespace tcp_pubsub
+{
+  namespace tracing
+  {
+    namespace
+    {
+      struct TraceEvent
+      {
+        int64_t    timestamp_ns_;
+        uint64_t   message_id_;
+        TracePoint trace_point_;
+      };
+
+      // Ring buffer of a single thread. Only that thread writes to it.
+      struct ThreadTraceBuffer
+      {
+        static constexpr size_t capacity_ = 65536;
+
+        uint64_t                              thread_index_ = 0;
+        std::string                           thread_name_;
+        std::atomic<uint64_t>                 write_count_ {0};
+        std::array<TraceEvent, capacity_>     events_;
+      };
+
+      struct TraceBufferRegistry
+      {
+        std::mutex                                      mutex_;
+        std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers_;
+        uint64_t                                        next_thread_index_ = 1;
+      };
+
+      TraceBufferRegistry& registry()
+      {
+        // Never destroyed, as threads may still record while the program exits
+        static TraceBufferRegistry* registry = new TraceBufferRegistry();
+        return *registry;
+      }
+
+      ThreadTraceBuffer& threadTraceBuffer()
+      {
+        thread_local std::shared_ptr<ThreadTraceBuffer> thread_trace_buffer;
+
+        if (!thread_trace_buffer)
+        {
+          thread_trace_buffer = std::make_shared<ThreadTraceBuffer>();
+
+          char thread_name[17] = {};
+          prctl(PR_GET_NAME, thread_name, nullptr, nullptr, nullptr);
+          thread_trace_buffer->thread_name_ = thread_name;
+
+          TraceBufferRegistry& trace_buffer_registry = registry();
+          const std::lock_guard<std::mutex> registry_lock(trace_buffer_registry.mutex_);
+          thread_trace_buffer->thread_index_ = trace_buffer_registry.next_thread_index_++;
+          trace_buffer_registry.buffers_.push_back(thread_trace_buffer);
+        }
+
+        return *thread_trace_buffer;
+      }
+
+      // Write operations and callbacks are spans. Write operations may end
+      // on a different thread, so they are async events matched by the
+      // message id.
+      void appendTraceEvent(std::ostringstream& stream, const ThreadTraceBuffer& buffer, const TraceEvent& event, int pid)
+      {
+        const char* name  = "";
+        const char* phase = "i";
+        switch (event.trace_point_)
+        {
+        case TracePoint::PublishEntry:    name = "publish";         break;
+        case TracePoint::BufferFilled:    name = "buffer filled";   break;
+        case TracePoint::SessionEnqueue:  name = "enqueue";         break;
+        case TracePoint::WriteStart:      name = "write";           phase = "b"; break;
+        case TracePoint::WriteComplete:   name = "write";           phase = "e"; break;
+        case TracePoint::ReceiveHeader:   name = "receive header";  break;
+        case TracePoint::ReceivePayload:  name = "receive payload"; break;
+        case TracePoint::CallbackStart:   name = "callback";        phase = "B"; break;
+        case TracePoint::CallbackEnd:     name = "callback";        phase = "E"; break;
+        default:                                                    break;
+        }
+
+        const int64_t timestamp_ns = event.timestamp_ns_;
+
+        stream << "{\"name\":\"" << name << "\",\"cat\":\"tcp_pubsub\",\"ph\":\"" << phase << "\""
+               << ",\"ts\":" << (timestamp_ns / 1000) << "." << std::setw(3) << std::setfill('0') << (timestamp_ns % 1000) << std::setfill(' ')
+               << ",\"pid\":" << pid << ",\"tid\":" << buffer.thread_index_;
+        if (phase[0] == 'i')
+          stream << ",\"s\":\"t\"";
+        if ((phase[0] == 'b') || (phase[0] == 'e'))
+          stream << ",\"id\":" << event.message_id_;
+        stream << ",\"args\":{\"message_id\":" << event.message_id_ << "}}";
+      }
+    }
+
+    int64_t now()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void record(TracePoint trace_point, uint64_t message_id, int64_t timestamp_ns)
+    {
+      ThreadTraceBuffer& buffer      = threadTraceBuffer();
+      const uint64_t     write_count = buffer.write_count_.load(std::memory_order_relaxed);
+
+      TraceEvent& event   = buffer.events_[write_count % ThreadTraceBuffer::capacity_];
+      event.timestamp_ns_ = timestamp_ns;
+      event.message_id_   = message_id;
+      event.trace_point_  = trace_point;
+
+      buffer.write_count_.store(write_count + 1, std::memory_order_release);
+    }
+
+    bool isEnabled()
+    {
+      return (TCP_PUBSUB_TRACING_ENABLED != 0);
+    }
+
+    std::string toChromeTraceJson()
+    {
+      std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+      {
+        TraceBufferRegistry& trace_buffer_registry = registry();
+        const std::lock_guard<std::mutex> registry_lock(trace_buffer_registry.mutex_);
+        buffers = trace_buffer_registry.buffers_;
+      }
+
+      const int pid = static_cast<int>(getpid());
+
+      std::ostringstream stream;
+      stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+      bool first = true;
+      for (const auto& buffer : buffers)
+      {
+        if (!first) stream << ",";
+        first = false;
+
+        stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->thread_index_
+               << ",\"args\":{\"name\":\"" << buffer->thread_name_ << "\"}}";
+
+        const uint64_t write_count = buffer->write_count_.load(std::memory_order_acquire);
+        const uint64_t begin       = (write_count > ThreadTraceBuffer::capacity_ ? write_count - ThreadTraceBuffer::capacity_ : 0);
+        for (uint64_t i = begin; i < write_count; i++)
+        {
+          stream << ",";
+          appendTraceEvent(stream, *buffer, buffer->events_[i % ThreadTraceBuffer::capacity_], pid);
+        }
+      }
+
+      stream << "]}";
+      return stream.str();
+    }
+
+    bool writeChromeTraceJson(const std::string& file_path)
+    {
+      std::ofstream file(file_path, std::ios::out | std::ios::trunc);
+      if (!file)
+        return false;
+
+      file << toChromeTraceJson();
+      return bool(file);
+    }
+
+    void clear()
+    {
+      TraceBufferRegistry& trace_buffer_registry = registry();
+      const std::lock_guard<std::mutex> registry_lock(trace_buffer_registry.mutex_);
+
+      // Forget the buffers of terminated threads and reset the others
+      std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+      for (const auto& buffer : trace_buffer_registry.buffers_)
+      {
+        if (buffer.use_count() > 1)
+        {
+          buffer->write_count_.store(0, std::memory_order_release);
+          buffers.push_back(buffer);
+        }
+      }
+      trace_buffer_registry.buffers_ = std::move(buffers);
+    }
+  }
+}
@@ -0,0 +1,319 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "transient_local_journal.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tcp_header.h"
+#include "portable_endian.h"
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif // !_WIN32
+
+namespace tcp_pubsub
+{
+  namespace
+  {
+    constexpr char     journal_magic[8] = { 'T', 'C', 'P', 'P', 'S', 'J', 'R', 'N' };
+    constexpr uint32_t journal_version  = 2;
+  }
+
+  ////////////////////////////////////////////////
+  // Constructor & Destructor
+  ////////////////////////////////////////////////
+
+  TransientLocalJournal::TransientLocalJournal(const std::string& path, uint32_t index_capacity, uint64_t data_size, uint64_t publisher_instance_id, const logger::Logger& log_function)
+    : index_capacity_ (index_capacity)
+    , data_size_      (data_size)
+    , publisher_instance_id_(publisher_instance_id)
+    , log_            (log_function)
+    , file_descriptor_(-1)
+    , mapping_size_   (0)
+    , mapping_        (nullptr)
+  {
+    if ((index_capacity_ == 0) || (data_size_ == 0))
+    {
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "TransientLocalJournal " + path + ": Index capacity and data size must not be 0.");
+      return;
+    }
+
+    if (open(path))
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Info, "TransientLocalJournal " + path + ": Opened journal with " + std::to_string(fileHeader()->next_index - fileHeader()->oldest_index) + " samples.");
+  }
+
+  TransientLocalJournal::~TransientLocalJournal()
+  {
+    close();
+  }
+
+  ////////////////////////////////////////////////
+  // Open & Close
+  ////////////////////////////////////////////////
+
+#ifdef _WIN32
+  bool TransientLocalJournal::open(const std::string& path)
+  {
+    TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "TransientLocalJournal " + path + ": Journals are not supported on this platform.");
+    return false;
+  }
+
+  void TransientLocalJournal::close()
+  {}
+#else
+  bool TransientLocalJournal::open(const std::string& path)
+  {
+    mapping_size_ = sizeof(JournalFileHeader) + (sizeof(JournalIndexEntry) * index_capacity_) + data_size_;
+
+    file_descriptor_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file_descriptor_ < 0)
+    {
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "TransientLocalJournal " + path + ": Error opening file: " + std::strerror(errno));
+      return false;
+    }
+
+    struct stat file_stat;
+    if (::fstat(file_descriptor_, &file_stat) != 0)
+    {
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "TransientLocalJournal " + path + ": Error reading file size: " + std::strerror(errno));
+      close();
+      return false;
+    }
+
+    const bool size_matches = (static_cast<uint64_t>(file_stat.st_size) == mapping_size_);
+    if (!size_matches && (::ftruncate(file_descriptor_, static_cast<off_t>(mapping_size_)) != 0))
+    {
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "TransientLocalJournal " + path + ": Error resizing file: " + std::strerror(errno));
+      close();
+      return false;
+    }
+
+    void* mapping = ::mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor_, 0);
+    if (mapping == MAP_FAILED)
+    {
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Error, "TransientLocalJournal " + path + ": Error mapping file: " + std::strerror(errno));
+      close();
+      return false;
+    }
+    mapping_ = static_cast<char*>(mapping);
+
+    // Only re-use an existing journal that has been created with the same layout
+    const JournalFileHeader* header = fileHeader();
+    if (!size_matches
+        || (std::memcmp(header->magic, journal_magic, sizeof(journal_magic)) != 0)
+        || (header->version        != journal_version)
+        || (header->index_capacity != index_capacity_)
+        || (header->data_size      != data_size_))
+    {
+      if (size_matches)
+        TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "TransientLocalJournal " + path + ": Existing journal has a different layout. Discarding its content.");
+      initialize();
+    }
+    else if (!isConsistent())
+    {
+      // E.g. the file has been truncated or modified by someone else
+      TCP_PUBSUB_LOG(log_, logger::LogLevel::Warning, "TransientLocalJournal " + path + ": Existing journal is corrupt. Discarding its content.");
+      initialize();
+    }
+
+    return true;
+  }
+
+  void TransientLocalJournal::close()
+  {
+    if (mapping_ != nullptr)
+    {
+      ::msync(mapping_, mapping_size_, MS_ASYNC);
+      ::munmap(mapping_, mapping_size_);
+      mapping_ = nullptr;
+    }
+
+    if (file_descriptor_ >= 0)
+    {
+      ::close(file_descriptor_);
+      file_descriptor_ = -1;
+    }
+  }
+#endif // _WIN32
+
+  void TransientLocalJournal::initialize()
+  {
+    std::memset(mapping_, 0, sizeof(JournalFileHeader) + (sizeof(JournalIndexEntry) * index_capacity_));
+
+    JournalFileHeader* header = fileHeader();
+    std::memcpy(header->magic, journal_magic, sizeof(journal_magic));
+    header->version           = journal_version;
+    header->index_capacity    = index_capacity_;
+    header->data_size         = data_size_;
+    header->oldest_index      = 0;
+    header->next_index        = 0;
+    header->data_write_offset = 0;
+    header->publisher_instance_id = publisher_instance_id_;
+  }
+
+  bool TransientLocalJournal::isConsistent() const
+  {
+    const JournalFileHeader* header = fileHeader();
+
+    if ((header->oldest_index > header->next_index)
+        || (header->next_index - header->oldest_index > index_capacity_)
+        || (header->data_write_offset > data_size_))
+    {
+      return false;
+    }
+
+    // Entries with a wrong tag have been invalidated and are skipped anyways
+    for (uint64_t index = header->oldest_index; index < header->next_index; index++)
+    {
+      const JournalIndexEntry* entry = indexEntry(index);
+      if ((entry->tag == index + 1) && !isCompleteFrame(*entry))
+        return false;
+    }
+
+    return true;
+  }
+
+  bool TransientLocalJournal::isCompleteFrame(const JournalIndexEntry& entry) const
+  {
+    // The entry must lie within the data segment and hold exactly one
+    // message, so it can be sent as it is
+    if ((entry.offset > data_size_) || (entry.size > data_size_ - entry.offset) || (entry.size < short_tcp_header_size))
+      return false;
+
+    TcpHeader header;
+    std::memcpy(&header, dataSegment() + entry.offset, std::min(static_cast<size_t>(entry.size), sizeof(header)));
+
+    const uint16_t header_size = le16toh(header.header_size);
+    return (header_size >= short_tcp_header_size)
+        && (header_size <= entry.size)
+        && (le64toh(header.data_size) == entry.size - header_size);
+  }
+
+  bool TransientLocalJournal::isOpen() const
+  {
+    return mapping_ != nullptr;
+  }
+
+  uint64_t TransientLocalJournal::publisherInstanceId() const
+  {
+    if (!isOpen())
+      return publisher_instance_id_;
+
+    std::lock_guard<std::mutex> journal_lock(journal_mutex_);
+    return fileHeader()->publisher_instance_id;
+  }
+
+  ////////////////////////////////////////////////
+  // Append & Restore
+  ////////////////////////////////////////////////
+
+  void TransientLocalJournal::append(const std::vector<char>& buffer, int64_t system_time_ns)
+  {
+    if (!isOpen())
+      return;
+
+    if (buffer.empty() || (buffer.size() > data_size_))
+      return;
+
+    std::lock_guard<std::mutex> journal_lock(journal_mutex_);
+
+    JournalFileHeader* header = fileHeader();
+
+    // Drop all samples whose data is going to be overwritten. As samples are
+    // written in order, those are always the oldest ones.
+    const uint64_t write_size         = buffer.size();
+    const uint64_t write_offset_begin = header->data_write_offset;
+    while (header->oldest_index < header->next_index)
+    {
+      JournalIndexEntry* oldest_entry = indexEntry(header->oldest_index);
+      if ((oldest_entry->tag == header->oldest_index + 1) && !overlapsConsumedRange(*oldest_entry, write_offset_begin, write_size))
+        break;
+
+      oldest_entry->tag = 0;
+      header->oldest_index++;
+    }
+
+    // The index entry we are going to use must not be referenced any more
+    if (header->next_index - header->oldest_index >= index_capacity_)
+      header->oldest_index = header->next_index - index_capacity_ + 1;
+
+    // Samples are never split. If the sample does not fit at the end of the
+    // data segment, we continue at the beginning.
+    const uint64_t write_offset = ((write_offset_begin + write_size) <= data_size_ ? write_offset_begin : 0);
+    std::memcpy(dataSegment() + write_offset, buffer.data(), static_cast<size_t>(write_size));
+
+    // Write the index entry after the data and publish it with the tag
+    JournalIndexEntry* entry = indexEntry(header->next_index);
+    entry->tag            = 0;
+    entry->offset         = write_offset;
+    entry->size           = write_size;
+    entry->system_time_ns = system_time_ns;
+    entry->tag            = header->next_index + 1;
+
+    header->next_index++;
+    header->data_write_offset = write_offset + write_size;
+  }
+
+  std::vector<TransientLocalJournal::Element> TransientLocalJournal::restore() const
+  {
+    std::vector<Element> elements;
+
+    if (!isOpen())
+      return elements;
+
+    std::lock_guard<std::mutex> journal_lock(journal_mutex_);
+
+    const JournalFileHeader* header = fileHeader();
+    for (uint64_t index = header->oldest_index; index < header->next_index; index++)
+    {
+      const JournalIndexEntry* entry = indexEntry(index);
+      if ((entry->tag != index + 1) || !isCompleteFrame(*entry))
+        continue;
+
+      Element element;
+      element.buffer_         = std::make_shared<std::vector<char>>(dataSegment() + entry->offset, dataSegment() + entry->offset + entry->size);
+      element.system_time_ns_ = entry->system_time_ns;
+      elements.push_back(std::move(element));
+    }
+
+    return elements;
+  }
+
+  ////////////////////////////////////////////////
+  // Helpers
+  ////////////////////////////////////////////////
+
+  bool TransientLocalJournal::overlapsConsumedRange(const JournalIndexEntry& entry, uint64_t write_offset, uint64_t write_size) const
+  {
+    auto overlaps = [&entry](uint64_t range_begin, uint64_t range_end) -> bool
+                    {
+                      return (entry.offset < range_end) && (range_begin < entry.offset + entry.size);
+                    };
+
+    if (write_offset + write_size <= data_size_)
+      return overlaps(write_offset, write_offset + write_size);
+
+    // When wrapping around, the unused end of the data segment is consumed as well
+    return overlaps(write_offset, data_size_) || overlaps(0, write_size);
+  }
+
+  TransientLocalJournal::JournalFileHeader* TransientLocalJournal::fileHeader() const
+  {
+    return reinterpret_cast<JournalFileHeader*>(mapping_);
+  }
+
+  TransientLocalJournal::JournalIndexEntry* TransientLocalJournal::indexEntry(uint64_t index) const
+  {
+    return reinterpret_cast<JournalIndexEntry*>(mapping_ + sizeof(JournalFileHeader)) + (index % index_capacity_);
+  }
+
+  char* TransientLocalJournal::dataSegment() const
+  {
+    return mapping_ + sizeof(JournalFileHeader) + (sizeof(JournalIndexEntry) * index_capacity_);
+  }
+}
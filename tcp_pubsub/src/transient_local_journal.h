@@ -0,0 +1,115 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tcp_pubsub_logger_abstraction.h"
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Append-only journal of the transient local history in a memory-mapped file
+   *
+   * The journal file consists of three parts:
+   *
+   *   [ JournalFileHeader ][ JournalIndexEntry * index_capacity ][ data segment ]
+   *
+   * The data segment is used as a circular byte log. Each appended sample is
+   * copied as complete wire buffer (i.e. TcpHeader + payload), so it can be
+   * sent to a subscriber again without re-serializing it. The fixed-size
+   * index holds one entry per sample and is written after the sample data, so
+   * a crashed publisher never leaves an index entry pointing to incomplete
+   * data.
+   *
+   * When appending a sample would overwrite the data of old samples, those
+   * samples are dropped from the index, oldest first.
+   *
+   * The file is only meant to survive a restart of the publisher process on
+   * the same machine. All numbers are stored in host byte order.
+   */
+  class TransientLocalJournal
+  {
+  public:
+    struct Element
+    {
+      std::shared_ptr<std::vector<char>> buffer_;
+      int64_t                            system_time_ns_;
+    };
+
+  public:
+    TransientLocalJournal(const std::string& path, uint32_t index_capacity, uint64_t data_size, uint64_t publisher_instance_id, const logger::Logger& log_function);
+    ~TransientLocalJournal();
+
+    // Copy
+    TransientLocalJournal(const TransientLocalJournal&)            = delete;
+    TransientLocalJournal& operator=(const TransientLocalJournal&) = delete;
+
+    // Move
+    TransientLocalJournal& operator=(TransientLocalJournal&&)      = delete;
+    TransientLocalJournal(TransientLocalJournal&&)                 = delete;
+
+  public:
+    bool isOpen() const;
+
+    // Instance id of the publisher that has created the journal. The sequence
+    // numbers of the journaled samples are only meaningful in combination
+    // with this id.
+    uint64_t publisherInstanceId() const;
+
+    void                 append(const std::vector<char>& buffer, int64_t system_time_ns);
+    std::vector<Element> restore() const;
+
+  private:
+#pragma pack(push,1)
+    struct JournalFileHeader
+    {
+      char     magic[8];
+      uint32_t version;
+      uint32_t index_capacity;
+      uint64_t data_size;
+      uint64_t oldest_index;        /// Index of the oldest sample that may still be valid
+      uint64_t next_index;          /// Index the next sample will be written to
+      uint64_t data_write_offset;   /// Offset in the data segment the next sample will be written to
+      uint64_t publisher_instance_id;
+    };
+
+    struct JournalIndexEntry
+    {
+      uint64_t tag;                 /// index + 1 of the sample. 0 if the entry is invalid.
+      uint64_t offset;
+      uint64_t size;
+      int64_t  system_time_ns;
+    };
+#pragma pack(pop)
+
+    bool open(const std::string& path);
+    void close();
+
+    void initialize();
+    bool isConsistent() const;
+    bool isCompleteFrame(const JournalIndexEntry& entry) const;
+    bool overlapsConsumedRange(const JournalIndexEntry& entry, uint64_t write_offset, uint64_t write_size) const;
+
+    JournalFileHeader* fileHeader() const;
+    JournalIndexEntry* indexEntry(uint64_t index) const;
+    char*              dataSegment() const;
+
+  private:
+    const uint32_t         index_capacity_;
+    const uint64_t         data_size_;
+    const uint64_t         publisher_instance_id_;   /// Used when creating a new journal
+    const logger::Logger log_;
+
+    mutable std::mutex     journal_mutex_;
+    int                    file_descriptor_;
+    size_t                 mapping_size_;
+    char*                  mapping_;
+  };
+}
@@ -0,0 +1,263 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "transient_local_keyed_cache.h"
+
+#include <utility>
+
+namespace tcp_pubsub
+{
+  namespace
+  {
+    size_t tableSizeForKeys(size_t max_keys)
+    {
+      // Keep the load factor at or below 50%. The size is a power of 2, so we
+      // can use a mask instead of a modulo.
+      size_t table_size = 2;
+      while (table_size < max_keys * 2)
+        table_size *= 2;
+      return table_size;
+    }
+
+    uint64_t mixKey(uint64_t key)
+    {
+      // Finalizer of splitmix64. Users will often use consecutive numbers as
+      // keys, which would otherwise end up in one long probe sequence.
+      key ^= key >> 30;
+      key *= 0xbf58476d1ce4e5b9ULL;
+      key ^= key >> 27;
+      key *= 0x94d049bb133111ebULL;
+      key ^= key >> 31;
+      return key;
+    }
+  }
+
+  TransientLocalKeyedCache::TransientLocalKeyedCache(size_t max_keys, int64_t lifespan_ns, uint64_t max_bytes)
+    : max_keys_      (max_keys)
+    , lifespan_ns_   (lifespan_ns)
+    , max_bytes_     (max_bytes)
+    , table_         (max_keys > 0 ? tableSizeForKeys(max_keys) : 0)
+    , slot_mask_     (table_.empty() ? 0 : table_.size() - 1)
+    , size_          (0)
+    , oldest_slot_   (no_slot_)
+    , newest_slot_   (no_slot_)
+    , retained_bytes_(0)
+  {}
+
+  void TransientLocalKeyedCache::update(uint64_t key, const std::shared_ptr<std::vector<char>>& buffer, std::chrono::steady_clock::time_point now_tp)
+  {
+    if (max_keys_ == 0)
+      return;
+
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+
+    size_t slot = findSlot(key);
+    if (!table_[slot].occupied_)
+    {
+      if (size_ >= max_keys_)
+      {
+        evictLeastRecentlyUpdated();
+
+        // Evicting may have shifted entries, so the free slot may have moved
+        slot = findSlot(key);
+      }
+
+      table_[slot].occupied_ = true;
+      table_[slot].key_      = key;
+      size_++;
+    }
+    else
+    {
+      if (table_[slot].buffer_)
+        retained_bytes_ -= table_[slot].buffer_->size();
+      unlink(slot);
+    }
+
+    linkNewest(slot);
+    table_[slot].enqueue_time_ns_ = now_ns;
+    table_[slot].buffer_          = buffer;
+    retained_bytes_ += buffer->size();
+
+    // Evict the least recently updated keys until we are within the byte
+    // budget again. This may evict the key we have just updated, if its
+    // buffer alone exceeds the budget.
+    while ((max_bytes_ > 0) && (retained_bytes_ > max_bytes_) && (size_ > 0))
+    {
+      evictLeastRecentlyUpdated();
+    }
+  }
+
+  void TransientLocalKeyedCache::purgeExpired(std::chrono::steady_clock::time_point now_tp)
+  {
+    if ((max_keys_ == 0) || (lifespan_ns_ <= 0))
+      return;
+
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+    purgeExpiredUnlocked(now_ns);
+  }
+
+  std::vector<std::shared_ptr<std::vector<char>>> TransientLocalKeyedCache::snapshot(std::chrono::steady_clock::time_point now_tp, std::vector<int64_t>& enqueue_times_ns)
+  {
+    std::vector<std::shared_ptr<std::vector<char>>> buffers;
+    enqueue_times_ns.clear();
+
+    if (max_keys_ == 0)
+      return buffers;
+
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+
+    {
+      std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+      purgeExpiredUnlocked(now_ns);
+
+      // Replay the keys in the order they have been updated
+      buffers         .reserve(size_);
+      enqueue_times_ns.reserve(size_);
+      for (size_t slot = oldest_slot_; slot != no_slot_; slot = table_[slot].newer_)
+      {
+        buffers         .push_back(table_[slot].buffer_);
+        enqueue_times_ns.push_back(table_[slot].enqueue_time_ns_);
+      }
+    }
+
+    return buffers;
+  }
+
+  size_t TransientLocalKeyedCache::size() const
+  {
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+    return size_;
+  }
+
+  uint64_t TransientLocalKeyedCache::retainedBytes() const
+  {
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+    return retained_bytes_;
+  }
+
+  size_t TransientLocalKeyedCache::homeSlot(uint64_t key) const
+  {
+    return static_cast<size_t>(mixKey(key)) & slot_mask_;
+  }
+
+  size_t TransientLocalKeyedCache::findSlot(uint64_t key) const
+  {
+    // Returns the slot containing the key or the free slot where the key
+    // would have to be inserted. As the table is never more than half full,
+    // there always is a free slot.
+    size_t slot = homeSlot(key);
+    while (table_[slot].occupied_ && (table_[slot].key_ != key))
+    {
+      slot = (slot + 1) & slot_mask_;
+    }
+    return slot;
+  }
+
+  void TransientLocalKeyedCache::eraseSlot(size_t slot)
+  {
+    // Backward-shift deletion: Move all following entries of the same probe
+    // sequence one step closer to their home slot, so lookups never hit a
+    // hole in the middle of a probe sequence.
+    if (table_[slot].buffer_)
+      retained_bytes_ -= table_[slot].buffer_->size();
+
+    unlink(slot);
+
+    size_t hole = slot;
+    size_t next = slot;
+    for (;;)
+    {
+      next = (next + 1) & slot_mask_;
+      if (!table_[next].occupied_)
+        break;
+
+      const size_t home = homeSlot(table_[next].key_);
+
+      // The entry must stay where it is, if its home slot lies cyclically in (hole, next]
+      const bool stays = (hole <= next) ? ((hole < home) && (home <= next))
+                                        : ((hole < home) || (home <= next));
+      if (stays)
+        continue;
+
+      table_[hole] = std::move(table_[next]);
+      relinkMoved(hole);
+      hole = next;
+    }
+
+    table_[hole].occupied_ = false;
+    table_[hole].buffer_.reset();
+    size_--;
+  }
+
+  void TransientLocalKeyedCache::linkNewest(size_t slot)
+  {
+    table_[slot].older_ = newest_slot_;
+    table_[slot].newer_ = no_slot_;
+
+    if (newest_slot_ != no_slot_)
+      table_[newest_slot_].newer_ = slot;
+    else
+      oldest_slot_ = slot;
+
+    newest_slot_ = slot;
+  }
+
+  void TransientLocalKeyedCache::unlink(size_t slot)
+  {
+    const size_t older = table_[slot].older_;
+    const size_t newer = table_[slot].newer_;
+
+    if (older != no_slot_)
+      table_[older].newer_ = newer;
+    else
+      oldest_slot_ = newer;
+
+    if (newer != no_slot_)
+      table_[newer].older_ = older;
+    else
+      newest_slot_ = older;
+
+    table_[slot].older_ = no_slot_;
+    table_[slot].newer_ = no_slot_;
+  }
+
+  void TransientLocalKeyedCache::relinkMoved(size_t slot)
+  {
+    // The entry has been moved to this slot, so its neighbours must point
+    // to the new slot
+    const size_t older = table_[slot].older_;
+    const size_t newer = table_[slot].newer_;
+
+    if (older != no_slot_)
+      table_[older].newer_ = slot;
+    else
+      oldest_slot_ = slot;
+
+    if (newer != no_slot_)
+      table_[newer].older_ = slot;
+    else
+      newest_slot_ = slot;
+  }
+
+  void TransientLocalKeyedCache::evictLeastRecentlyUpdated()
+  {
+    if (oldest_slot_ != no_slot_)
+      eraseSlot(oldest_slot_);
+  }
+
+  void TransientLocalKeyedCache::purgeExpiredUnlocked(int64_t now_ns)
+  {
+    if (lifespan_ns_ <= 0)
+      return;
+
+    // Keys are linked in update order, so the expired ones are at the front
+    while ((oldest_slot_ != no_slot_) && ((now_ns - table_[oldest_slot_].enqueue_time_ns_) > lifespan_ns_))
+    {
+      eraseSlot(oldest_slot_);
+    }
+  }
+}
@@ -0,0 +1,90 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Last-value cache for the keyed transient local mode
+   *
+   * Keeps a reference to the latest buffer of each key in an open-addressing
+   * hash table with linear probing. The table is allocated once with twice
+   * the maximum number of keys, so probe sequences stay short. Entries are
+   * removed with backward-shift deletion, so no tombstones are needed.
+   *
+   * When a new key is added while the cache is full, or when the buffers
+   * referenced by the cache exceed the byte budget, the keys that have not
+   * been updated for the longest time are evicted. The occupied slots are
+   * linked in update order, so finding that key does not need a scan.
+   *
+   * A snapshot returns one buffer per key, ordered by the time the keys have
+   * been updated.
+   */
+  class TransientLocalKeyedCache
+  {
+  public:
+    TransientLocalKeyedCache(size_t max_keys, int64_t lifespan_ns, uint64_t max_bytes);
+
+    // Copy
+    TransientLocalKeyedCache(const TransientLocalKeyedCache&)            = delete;
+    TransientLocalKeyedCache& operator=(const TransientLocalKeyedCache&) = delete;
+
+    // Move
+    TransientLocalKeyedCache& operator=(TransientLocalKeyedCache&&)      = delete;
+    TransientLocalKeyedCache(TransientLocalKeyedCache&&)                 = delete;
+
+  public:
+    void update(uint64_t key, const std::shared_ptr<std::vector<char>>& buffer, std::chrono::steady_clock::time_point now_tp);
+    void purgeExpired(std::chrono::steady_clock::time_point now_tp);
+
+    // Returns one buffer per key in update order.
+    // enqueue_times_ns is set to the steady_clock enqueue time of each element.
+    std::vector<std::shared_ptr<std::vector<char>>> snapshot(std::chrono::steady_clock::time_point now_tp, std::vector<int64_t>& enqueue_times_ns);
+
+    size_t   size()          const;
+    uint64_t retainedBytes() const;
+
+  private:
+    static constexpr size_t no_slot_ = SIZE_MAX;
+
+    struct Entry
+    {
+      bool                               occupied_        = false;
+      uint64_t                           key_             = 0;
+      int64_t                            enqueue_time_ns_ = 0;
+      std::shared_ptr<std::vector<char>> buffer_;
+      size_t                             older_           = no_slot_;   /// Slot of the entry updated right before this one
+      size_t                             newer_           = no_slot_;   /// Slot of the entry updated right after this one
+    };
+
+    size_t homeSlot(uint64_t key) const;
+    size_t findSlot(uint64_t key) const;
+    void   eraseSlot(size_t slot);
+    void   linkNewest(size_t slot);
+    void   unlink(size_t slot);
+    void   relinkMoved(size_t slot);
+    void   evictLeastRecentlyUpdated();
+    void   purgeExpiredUnlocked(int64_t now_ns);
+
+  private:
+    const size_t       max_keys_;
+    const int64_t      lifespan_ns_;
+    const uint64_t     max_bytes_;
+
+    mutable std::mutex cache_mutex_;
+    std::vector<Entry> table_;
+    size_t             slot_mask_;
+    size_t             size_;
+    size_t             oldest_slot_;        /// Slot of the least recently updated entry
+    size_t             newest_slot_;        /// Slot of the most recently updated entry
+    uint64_t           retained_bytes_;     /// Sum of the sizes of all buffers referenced by the cache
+  };
+}
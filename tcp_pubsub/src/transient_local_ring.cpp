@@ -0,0 +1,107 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#include "transient_local_ring.h"
+
+namespace tcp_pubsub
+{
+  TransientLocalRing::TransientLocalRing(size_t capacity, int64_t lifespan_ns, uint64_t max_bytes)
+    : capacity_      (capacity)
+    , lifespan_ns_   (lifespan_ns)
+    , max_bytes_     (max_bytes)
+    , slots_         (capacity > 0 ? new Slot[capacity] : nullptr)
+    , oldest_slot_   (0)
+    , size_          (0)
+    , retained_bytes_(0)
+  {}
+
+  void TransientLocalRing::push(const std::shared_ptr<std::vector<char>>& buffer, std::chrono::steady_clock::time_point now_tp)
+  {
+    if (capacity_ == 0)
+      return;
+
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> ring_lock(ring_mutex_);
+
+    if (size_ == capacity_)
+      dropOldest();
+
+    Slot& slot = slots_[(oldest_slot_ + size_) % capacity_];
+    slot.enqueue_time_ns_ = now_ns;
+    slot.buffer_          = buffer;
+    size_++;
+    retained_bytes_ += buffer->size();
+
+    while ((max_bytes_ > 0) && (retained_bytes_ > max_bytes_) && (size_ > 0))
+      dropOldest();
+  }
+
+  void TransientLocalRing::purgeExpired(std::chrono::steady_clock::time_point now_tp)
+  {
+    if ((capacity_ == 0) || (lifespan_ns_ <= 0))
+      return;
+
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> ring_lock(ring_mutex_);
+    while ((size_ > 0) && isExpired(slots_[oldest_slot_].enqueue_time_ns_, now_ns))
+      dropOldest();
+  }
+
+  std::vector<std::shared_ptr<std::vector<char>>> TransientLocalRing::snapshot(std::chrono::steady_clock::time_point now_tp, std::vector<int64_t>& enqueue_times_ns) const
+  {
+    std::vector<std::shared_ptr<std::vector<char>>> buffers;
+    enqueue_times_ns.clear();
+
+    if (capacity_ == 0)
+      return buffers;
+
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> ring_lock(ring_mutex_);
+
+    buffers         .reserve(size_);
+    enqueue_times_ns.reserve(size_);
+
+    for (size_t i = 0; i < size_; i++)
+    {
+      const Slot& slot = slots_[(oldest_slot_ + i) % capacity_];
+      if (isExpired(slot.enqueue_time_ns_, now_ns))
+        continue;
+
+      buffers         .push_back(slot.buffer_);
+      enqueue_times_ns.push_back(slot.enqueue_time_ns_);
+    }
+
+    return buffers;
+  }
+
+  size_t TransientLocalRing::capacity() const
+  {
+    return capacity_;
+  }
+
+  uint64_t TransientLocalRing::retainedBytes() const
+  {
+    std::lock_guard<std::mutex> ring_lock(ring_mutex_);
+    return retained_bytes_;
+  }
+
+  bool TransientLocalRing::isExpired(int64_t enqueue_time_ns, int64_t now_ns) const
+  {
+    return (lifespan_ns_ > 0) && ((now_ns - enqueue_time_ns) > lifespan_ns_);
+  }
+
+  void TransientLocalRing::dropOldest()
+  {
+    // ring_mutex_ must be locked by the caller
+
+    Slot& slot = slots_[oldest_slot_];
+    retained_bytes_ -= slot.buffer_->size();
+    slot.buffer_.reset();
+
+    oldest_slot_ = (oldest_slot_ + 1) % capacity_;
+    size_--;
+  }
+}
@@ -0,0 +1,76 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tcp_pubsub
+{
+  /**
+   * @brief Fixed-capacity ring of buffer references for the transient local history
+   *
+   * The ring is allocated once with the capacity given to the constructor, so
+   * pushing a buffer only stores a reference and never allocates memory.
+   *
+   * When the ring is full, pushing drops the oldest element. Elements are also
+   * dropped from the oldest end when the byte budget is exceeded or when
+   * purgeExpired() finds that their lifespan has expired. Expired elements are
+   * not purged when pushing. The owner is expected to call purgeExpired()
+   * periodically; snapshots skip expired elements anyways.
+   *
+   * The publisher pushes while holding its send order mutex, so pushes never
+   * compete with each other. The ring mutex only serializes them with
+   * snapshots and the periodic purge.
+   */
+  class TransientLocalRing
+  {
+  public:
+    TransientLocalRing(size_t capacity, int64_t lifespan_ns, uint64_t max_bytes);
+
+    // Copy
+    TransientLocalRing(const TransientLocalRing&)            = delete;
+    TransientLocalRing& operator=(const TransientLocalRing&) = delete;
+
+    // Move
+    TransientLocalRing& operator=(TransientLocalRing&&)      = delete;
+    TransientLocalRing(TransientLocalRing&&)                 = delete;
+
+  public:
+    void push(const std::shared_ptr<std::vector<char>>& buffer, std::chrono::steady_clock::time_point now_tp);
+    void purgeExpired(std::chrono::steady_clock::time_point now_tp);
+
+    // Returns the history, oldest element first.
+    // enqueue_times_ns is set to the steady_clock enqueue time of each element.
+    std::vector<std::shared_ptr<std::vector<char>>> snapshot(std::chrono::steady_clock::time_point now_tp, std::vector<int64_t>& enqueue_times_ns) const;
+
+    size_t   capacity()      const;
+    uint64_t retainedBytes() const;
+
+  private:
+    struct Slot
+    {
+      int64_t                            enqueue_time_ns_ = 0;     /// steady_clock time the element has been pushed
+      std::shared_ptr<std::vector<char>> buffer_;
+    };
+
+    bool isExpired(int64_t enqueue_time_ns, int64_t now_ns) const;
+    void dropOldest();
+
+  private:
+    const size_t            capacity_;
+    const int64_t           lifespan_ns_;
+    const uint64_t          max_bytes_;
+
+    mutable std::mutex      ring_mutex_;
+    std::unique_ptr<Slot[]> slots_;
+    size_t                  oldest_slot_;                       /// Slot of the oldest element
+    size_t                  size_;                              /// Number of elements in the ring
+    uint64_t                retained_bytes_;                    /// Sum of the sizes of all buffers referenced by the ring
+  };
+}
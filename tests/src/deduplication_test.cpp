@@ -0,0 +1,164 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// A subscriber with deduplication that is connected to redundant publishers
+// must pass on each message exactly once, including messages that arrive
+// after a greater sequence number has been passed on already. A restarted
+// publisher that counts from the start again must not be taken for a
+// duplicate.
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  struct RedundantPublishers
+  {
+    explicit RedundantPublishers(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+      : publisher_a_(std::make_shared<tcp_pubsub::Publisher>(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliableSetting(), "127.0.0.1", 0))
+      , publisher_b_(std::make_shared<tcp_pubsub::Publisher>(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliableSetting(), "127.0.0.1", 0))
+      , subscriber_ (executor)
+    {
+      subscriber_.setDeduplication(true);
+      subscriber_.setCallback([this](const tcp_pubsub::CallbackData& data)
+                              {
+                                std::lock_guard<std::mutex> lock(received_mutex_);
+                                received_.push_back(data.sequence_number_);
+                              }, true);
+      auto session_a = subscriber_.addSession("127.0.0.1", publisher_a_->getPort());
+      auto session_b = subscriber_.addSession("127.0.0.1", publisher_b_->getPort());
+      TEST_CHECK(test_helpers::waitUntil([&]() { return session_a->isConnected() && session_b->isConnected()
+                                                      && (publisher_a_->getSubscriberCount() == 1) && (publisher_b_->getSubscriberCount() == 1); }));
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    static tcp_pubsub::PublisherReliableSetting reliableSetting()
+    {
+      tcp_pubsub::PublisherReliableSetting reliable_setting;
+      reliable_setting.enabled_ = true;
+      return reliable_setting;
+    }
+
+    static void send(tcp_pubsub::Publisher& publisher, uint64_t sequence_number)
+    {
+      const std::string payload = std::to_string(sequence_number);
+      TEST_CHECK(publisher.sendWithSequenceNumber(sequence_number, {{payload.data(), payload.size()}}));
+    }
+
+    std::vector<uint64_t> received()
+    {
+      std::lock_guard<std::mutex> lock(received_mutex_);
+      return received_;
+    }
+
+    std::shared_ptr<tcp_pubsub::Publisher> publisher_a_;
+    std::shared_ptr<tcp_pubsub::Publisher> publisher_b_;
+    tcp_pubsub::Subscriber                 subscriber_;
+    std::mutex                             received_mutex_;
+    std::vector<uint64_t>                  received_;
+  };
+
+  // Both publishers send the same stream. One of them fails in the middle,
+  // the subscriber must still see every message once and without a gap.
+  void testFailover(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    RedundantPublishers publishers(executor);
+
+    for (uint64_t sequence_number = 1; sequence_number <= 2000; sequence_number++)
+    {
+      if (sequence_number <= 1000)
+        RedundantPublishers::send(*publishers.publisher_a_, sequence_number);
+      if (sequence_number == 1000)
+        publishers.publisher_a_->cancel();
+      RedundantPublishers::send(*publishers.publisher_b_, sequence_number);
+    }
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { return publishers.received().size() >= 2000; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const auto received = publishers.received();
+    TEST_CHECK(received.size() == 2000);
+    for (size_t i = 0; i < received.size(); i++)
+      TEST_CHECK(received[i] == i + 1);
+  }
+
+  // A message that has never been passed on is not a duplicate, even if it
+  // arrives after a greater sequence number (e.g. because the other
+  // publisher's session has dropped it).
+  void testLateMessageIsNotDuplicate(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    RedundantPublishers publishers(executor);
+
+    RedundantPublishers::send(*publishers.publisher_a_, 5);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return publishers.received().size() == 1; }));
+
+    RedundantPublishers::send(*publishers.publisher_b_, 4);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return publishers.received().size() == 2; }));
+
+    // These have been passed on already
+    RedundantPublishers::send(*publishers.publisher_b_, 5);
+    RedundantPublishers::send(*publishers.publisher_a_, 4);
+
+    // Marker, so we know the duplicates have been processed
+    RedundantPublishers::send(*publishers.publisher_a_, 6);
+    RedundantPublishers::send(*publishers.publisher_b_, 6);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return publishers.received().size() >= 3; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    TEST_CHECK((publishers.received() == std::vector<uint64_t>{5, 4, 6}));
+  }
+
+  // The window of the subscriber has moved far beyond the numbers of a
+  // restarted publisher, so it must be reset when the session reconnects to
+  // the new publisher instance
+  void testRestartedPublisher(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    auto publisher = std::make_shared<tcp_pubsub::Publisher>(executor, tcp_pubsub::PublisherTransientLocalSetting(), RedundantPublishers::reliableSetting(), "127.0.0.1", 0);
+    const uint16_t port = publisher->getPort();
+
+    std::atomic<size_t>    received{0};
+    tcp_pubsub::Subscriber subscriber(executor);
+    subscriber.setDeduplication(true);
+    subscriber.setCallback([&received](const tcp_pubsub::CallbackData&) { received++; }, true);
+    auto session = subscriber.addSession("127.0.0.1", port);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected() && (publisher->getSubscriberCount() == 1); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (uint64_t sequence_number = 1; sequence_number <= 6000; sequence_number++)
+      RedundantPublishers::send(*publisher, sequence_number);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return received >= 6000; }));
+
+    publisher->cancel();
+    publisher = std::make_shared<tcp_pubsub::Publisher>(executor, tcp_pubsub::PublisherTransientLocalSetting(), RedundantPublishers::reliableSetting(), "127.0.0.1", port);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected() && (publisher->getSubscriberCount() == 1); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (uint64_t sequence_number = 1; sequence_number <= 10; sequence_number++)
+      RedundantPublishers::send(*publisher, sequence_number);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return received >= 6010; }));
+
+    subscriber.cancel();
+    publisher->cancel();
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  testFailover(executor);
+  testLateMessageIsNotDuplicate(executor);
+  testRestartedPublisher(executor);
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// A publisher with a journal must restore its history from the journal of a
+// previous publisher and continue counting after the restored messages. A
+// journal that is corrupt must be discarded instead of being restored.
+
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  // Connects a subscriber, publishes one live message and returns everything
+  // the subscriber has received until then
+  std::vector<std::pair<uint64_t, std::string>> receive(const std::shared_ptr<tcp_pubsub::Executor>& executor, tcp_pubsub::Publisher& publisher, size_t expected_history_count)
+  {
+    std::mutex                                        received_mutex;
+    std::vector<std::pair<uint64_t, std::string>>     received;
+    tcp_pubsub::Subscriber subscriber(executor);
+    subscriber.setCallback([&](const tcp_pubsub::CallbackData& data)
+                           {
+                             std::lock_guard<std::mutex> lock(received_mutex);
+                             received.emplace_back(data.sequence_number_, std::string(data.buffer_->begin(), data.buffer_->end()));
+                           }, true);
+    auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected(); }));
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(received_mutex); return received.size() >= expected_history_count; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const std::string live = "live";
+    publisher.send(live.data(), live.size());
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(received_mutex); return received.size() >= expected_history_count + 1; }));
+
+    subscriber.cancel();
+
+    std::lock_guard<std::mutex> lock(received_mutex);
+    return received;
+  }
+
+  // Lets a publisher write 20 messages to a new journal
+  void writeJournal(const std::shared_ptr<tcp_pubsub::Executor>& executor, const tcp_pubsub::PublisherTransientLocalSetting& transient_local_setting)
+  {
+    std::remove(transient_local_setting.journal_path_.c_str());
+
+    tcp_pubsub::Publisher publisher(executor, transient_local_setting, "127.0.0.1", 0);
+    for (int i = 1; i <= 20; i++)
+    {
+      const std::string data = "message " + std::to_string(i);
+      publisher.send(data.data(), data.size());
+    }
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  tcp_pubsub::PublisherTransientLocalSetting transient_local_setting;
+  transient_local_setting.buffer_max_count_   = 5;
+  transient_local_setting.journal_path_       = std::string(TEST_OUTPUT_DIR) + "/journal_test.journal";
+  transient_local_setting.journal_size_bytes_ = 64 * 1024;
+
+  // The second publisher replays the last 5 messages and continues with 21
+  {
+    writeJournal(executor, transient_local_setting);
+
+    tcp_pubsub::Publisher publisher(executor, transient_local_setting, "127.0.0.1", 0);
+    const auto received = receive(executor, publisher, 5);
+
+    TEST_CHECK(received.size() == 6);
+    for (size_t i = 0; i < 5; i++)
+    {
+      TEST_CHECK(received[i].first  == 16 + i);
+      TEST_CHECK(received[i].second == "message " + std::to_string(16 + i));
+    }
+    TEST_CHECK(received[5].first  == 21);
+    TEST_CHECK(received[5].second == "live");
+
+    publisher.cancel();
+  }
+
+  // A journal whose next index is far beyond its capacity is discarded, so
+  // the second publisher starts without history
+  {
+    writeJournal(executor, transient_local_setting);
+    {
+      // The next index follows the magic, version, index capacity, data size
+      // and oldest index in the file header
+      const uint64_t next_index_offset = 8 + 4 + 4 + 8 + 8;
+      const uint64_t next_index        = 1000000;
+      std::fstream journal_file(transient_local_setting.journal_path_, std::ios::in | std::ios::out | std::ios::binary);
+      journal_file.seekp(next_index_offset);
+      journal_file.write(reinterpret_cast<const char*>(&next_index), sizeof(next_index));
+    }
+
+    tcp_pubsub::Publisher publisher(executor, transient_local_setting, "127.0.0.1", 0);
+    const auto received = receive(executor, publisher, 0);
+
+    TEST_CHECK(received.size() == 1);
+    TEST_CHECK(received[0].second == "live");
+
+    publisher.cancel();
+  }
+
+  std::remove(transient_local_setting.journal_path_.c_str());
+
+  return 0;
+}
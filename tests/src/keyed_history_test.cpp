@@ -0,0 +1,116 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// A keyed transient local publisher must keep the latest message of each
+// key, evict the keys that have not been updated for the longest time and
+// replay the keys in the order they have been updated.
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  std::vector<std::string> replay(const std::shared_ptr<tcp_pubsub::Executor>& executor, const tcp_pubsub::Publisher& publisher)
+  {
+    std::mutex               received_mutex;
+    std::vector<std::string> received;
+    tcp_pubsub::Subscriber   subscriber(executor);
+    subscriber.setCallback([&](const tcp_pubsub::CallbackData& data)
+                           {
+                             std::lock_guard<std::mutex> lock(received_mutex);
+                             received.emplace_back(data.buffer_->begin(), data.buffer_->end());
+                           }, true);
+    auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected(); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    subscriber.cancel();
+    std::lock_guard<std::mutex> lock(received_mutex);
+    return received;
+  }
+
+  std::string payload(uint64_t key, int update)
+  {
+    return "key " + std::to_string(key) + " update " + std::to_string(update);
+  }
+
+  // 60 keys are updated in a fixed order, but only 50 fit into the history
+  void testKeyLimit(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    tcp_pubsub::PublisherTransientLocalSetting transient_local_setting;
+    transient_local_setting.buffer_max_count_ = 50;
+    transient_local_setting.keyed_            = true;
+    tcp_pubsub::Publisher publisher(executor, transient_local_setting, "127.0.0.1", 0);
+
+    std::vector<std::string> expected;
+    for (int update = 0; update < 1000; update++)
+    {
+      const uint64_t    key  = (update * 7) % 60;
+      const std::string data = payload(key, update);
+      publisher.send(key, data.data(), data.size());
+      if (update >= 950)
+        expected.push_back(data);
+    }
+
+    // Messages without a key are not kept
+    publisher.send("no key", 6);
+
+    TEST_CHECK(replay(executor, publisher) == expected);
+  }
+
+  // Only the most recently updated keys that fit into the byte budget are kept
+  void testByteBudget(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    tcp_pubsub::PublisherTransientLocalSetting transient_local_setting;
+    transient_local_setting.buffer_max_count_ = 100;
+    transient_local_setting.keyed_            = true;
+    transient_local_setting.buffer_max_bytes_ = 10000;
+    tcp_pubsub::Publisher publisher(executor, transient_local_setting, "127.0.0.1", 0);
+
+    // Each buffer is about 1000 bytes, including the header
+    for (uint64_t key = 0; key < 20; key++)
+    {
+      const std::string data(960, static_cast<char>('a' + key));
+      publisher.send(key, data.data(), data.size());
+    }
+
+    // One large update evicts several keys at once
+    const std::string large(4500, 'z');
+    publisher.send(uint64_t(5), large.data(), large.size());
+
+    const auto received = replay(executor, publisher);
+    TEST_CHECK(!received.empty());
+    TEST_CHECK(received.back() == large);
+
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < received.size(); i++)
+    {
+      total_bytes += received[i].size();
+      if (i + 1 < received.size())
+      {
+        // The oldest keys have been evicted, the newest ones are kept in update order
+        TEST_CHECK(received[i] == std::string(960, static_cast<char>('a' + 20 - (received.size() - 1) + i)));
+      }
+    }
+    TEST_CHECK(total_bytes <= 10000);
+    TEST_CHECK(received.size() >= 5);
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  testKeyLimit(executor);
+  testByteBudget(executor);
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// A subscriber that limits the rate of a publisher must only receive about
+// the requested number of messages, the latest one included. Messages that
+// are skipped for the rate limit must not be counted as dropped.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  // Sends at about 100 Hz for the given duration. Returns the number of the last message.
+  uint64_t sendAt100Hz(const tcp_pubsub::Publisher& publisher, std::chrono::milliseconds duration)
+  {
+    uint64_t   sent = 0;
+    const auto end  = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+    {
+      publisher.send("x", 1);
+      sent++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return sent;
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), "127.0.0.1", 0);
+
+  tcp_pubsub::SubscriberFlowControlSetting flow_control_setting;
+  flow_control_setting.max_messages_per_second_ = 5;
+
+  std::atomic<uint64_t> received            {0};
+  std::atomic<uint64_t> last_sequence_number{0};
+  tcp_pubsub::Subscriber subscriber(executor, flow_control_setting);
+  subscriber.setCallback([&](const tcp_pubsub::CallbackData& data)
+                         {
+                           received++;
+                           last_sequence_number = data.sequence_number_;
+                         }, true);
+  auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+  TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected() && (publisher.getSubscriberCount() == 1); }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // Limited to 5 Hz
+  const uint64_t sent = sendAt100Hz(publisher, std::chrono::seconds(1));
+  TEST_CHECK(test_helpers::waitUntil([&]() { return last_sequence_number == sent; }));
+  TEST_CHECK(received >= 3);
+  TEST_CHECK(received <= 10);
+
+  const std::string statistics = executor->getPrometheusStatistics();
+  TEST_CHECK(test_helpers::prometheusCounter(statistics, "tcp_pubsub_publisher_downsampled_messages_total") > 0);
+  TEST_CHECK(test_helpers::prometheusCounter(statistics, "tcp_pubsub_publisher_dropped_messages_total")     == 0);
+
+  // Unlimited again
+  session->setMaxRate(0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  received = 0;
+  const uint64_t sent_unlimited = sendAt100Hz(publisher, std::chrono::milliseconds(500));
+  TEST_CHECK(test_helpers::waitUntil([&]() { return received == sent_unlimited; }));
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// A reliable publisher must never drop a message for a slow subscriber and
+// block send() instead. Subscribers that do not grant credit in time must be
+// evicted, and the eviction timeout must bound the entire send() call, no
+// matter how many subscribers are stalled. Neither a credit window that the
+// publisher limits nor switching the callback mode may lose messages.
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  void testBackpressure(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_ = true;
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+
+    tcp_pubsub::SubscriberFlowControlSetting flow_control_setting;
+    flow_control_setting.credit_window_messages_ = 8;
+
+    std::mutex             received_mutex;
+    std::vector<uint64_t>  received;
+    tcp_pubsub::Subscriber subscriber(executor, flow_control_setting);
+    subscriber.setCallback([&](const tcp_pubsub::CallbackData& data)
+                           {
+                             std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                             std::lock_guard<std::mutex> lock(received_mutex);
+                             received.push_back(data.sequence_number_);
+                           });
+    auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected() && (publisher.getSubscriberCount() == 1); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // The subscriber needs at least 5 ms per message, so send() must have
+    // waited for all but the messages that fit into the credit window
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++)
+      TEST_CHECK(publisher.send("x", 1));
+    TEST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(5 * (100 - 2 * 8)));
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(received_mutex); return received.size() >= 100; }));
+
+    std::lock_guard<std::mutex> lock(received_mutex);
+    TEST_CHECK(received.size() == 100);
+    for (size_t i = 0; i < received.size(); i++)
+      TEST_CHECK(received[i] == i + 1);
+  }
+
+  void testLimitedCreditWindow(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_                    = true;
+    reliable_setting.max_credit_window_messages_ = 4;
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+
+    // The subscriber asks for a much larger window than the publisher grants,
+    // so it must return credit after the window of the publisher
+    tcp_pubsub::SubscriberFlowControlSetting flow_control_setting;
+    flow_control_setting.credit_window_messages_ = 1000;
+
+    std::atomic<size_t>    received{0};
+    tcp_pubsub::Subscriber subscriber(executor, flow_control_setting);
+    subscriber.setCallback([&](const tcp_pubsub::CallbackData&)
+                           {
+                             std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                             received++;
+                           });
+    auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected() && (publisher.getSubscriberCount() == 1); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 50; i++)
+      TEST_CHECK(publisher.send("x", 1));
+    TEST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(5 * (50 - 2 * 4)));
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { return received >= 50; }));
+    TEST_CHECK(publisher.getSubscriberCount() == 1);
+  }
+
+  void testCallbackModeSwitch(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_ = true;
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+
+    tcp_pubsub::SubscriberFlowControlSetting flow_control_setting;
+    flow_control_setting.credit_window_messages_ = 4;
+
+    std::atomic<size_t>    received{0};
+    const auto             callback = [&received](const tcp_pubsub::CallbackData&) { received++; };
+    tcp_pubsub::Subscriber subscriber(executor, flow_control_setting);
+    subscriber.setCallback(callback, false);
+    auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected() && (publisher.getSubscriberCount() == 1); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Messages that are in flight while the mode changes must reach the new
+    // callback and return their credit, otherwise send() would block forever
+    std::atomic<bool> sending_done{false};
+    std::thread switcher([&]()
+                         {
+                           bool synchronous_execution = true;
+                           while (!sending_done)
+                           {
+                             subscriber.setCallback(callback, synchronous_execution);
+                             synchronous_execution = !synchronous_execution;
+                             std::this_thread::sleep_for(std::chrono::microseconds(300));
+                           }
+                         });
+    for (int i = 0; i < 2000; i++)
+      TEST_CHECK(publisher.send("x", 1));
+    TEST_CHECK(test_helpers::waitUntil([&]() { return received >= 2000; }));
+    sending_done = true;
+    switcher.join();
+
+    TEST_CHECK(received == 2000);
+  }
+
+  void testEviction(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    const auto eviction_timeout = std::chrono::milliseconds(200);
+
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_          = true;
+    reliable_setting.eviction_timeout_ = std::chrono::duration_cast<std::chrono::nanoseconds>(eviction_timeout).count();
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+
+    tcp_pubsub::SubscriberFlowControlSetting flow_control_setting;
+    flow_control_setting.credit_window_messages_ = 2;
+
+    // Subscribers whose callback does not return until the end of the test
+    std::atomic<bool> release{false};
+    std::vector<std::unique_ptr<tcp_pubsub::Subscriber>> subscribers;
+    for (int i = 0; i < 3; i++)
+    {
+      subscribers.emplace_back(new tcp_pubsub::Subscriber(executor, flow_control_setting));
+      subscribers.back()->setCallback([&release](const tcp_pubsub::CallbackData&)
+                                      {
+                                        while (!release)
+                                          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                      });
+      subscribers.back()->addSession("127.0.0.1", publisher.getPort());
+    }
+    TEST_CHECK(test_helpers::waitUntil([&]() { return publisher.getSubscriberCount() == 3; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto longest_send = std::chrono::steady_clock::duration::zero();
+    for (int i = 0; i < 10; i++)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      TEST_CHECK(publisher.send("x", 1));
+      longest_send = std::max(longest_send, std::chrono::steady_clock::now() - start);
+    }
+
+    // All three subscribers stalled in the same send() call. Waiting for each
+    // of them in turn would have taken 3 times the timeout.
+    TEST_CHECK(longest_send >= eviction_timeout);
+    TEST_CHECK(longest_send <  eviction_timeout * 2);
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { return publisher.getSubscriberCount() == 0; }));
+    TEST_CHECK(test_helpers::prometheusCounter(executor->getPrometheusStatistics(), "tcp_pubsub_publisher_evicted_sessions_total") == 3);
+
+    release = true;
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  testBackpressure(executor);
+  testLimitedCreditWindow(executor);
+  testCallbackModeSwitch(executor);
+  testEviction(executor);
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// A late joining subscriber must receive the part of the transient local
+// history it has asked for with its replay setting.
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  // Connects a new subscriber and returns the sequence numbers it has
+  // received once the history has been sent
+  std::vector<uint64_t> replay(const std::shared_ptr<tcp_pubsub::Executor>& executor, const tcp_pubsub::Publisher& publisher, const tcp_pubsub::SubscriberReplaySetting& replay_setting)
+  {
+    std::mutex             received_mutex;
+    std::vector<uint64_t>  received;
+    tcp_pubsub::Subscriber subscriber(executor);
+    subscriber.setCallback([&](const tcp_pubsub::CallbackData& data)
+                           {
+                             std::lock_guard<std::mutex> lock(received_mutex);
+                             received.push_back(data.sequence_number_);
+                           }, true);
+    auto session = subscriber.addSession("127.0.0.1", publisher.getPort(), replay_setting);
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected(); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    subscriber.cancel();
+    std::lock_guard<std::mutex> lock(received_mutex);
+    return received;
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  tcp_pubsub::PublisherTransientLocalSetting transient_local_setting;
+  transient_local_setting.buffer_max_count_ = 10;
+  tcp_pubsub::Publisher publisher(executor, transient_local_setting, "127.0.0.1", 0);
+
+  // Messages 1..12 and 13..15 after a pause. The history keeps the last 10.
+  for (int i = 0; i < 12; i++)
+    publisher.send("x", 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  const auto between = std::chrono::system_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  for (int i = 0; i < 3; i++)
+    publisher.send("y", 1);
+
+  tcp_pubsub::SubscriberReplaySetting replay_setting;
+
+  replay_setting.mode_ = tcp_pubsub::SubscriberReplaySetting::Mode::All;
+  TEST_CHECK((replay(executor, publisher, replay_setting) == std::vector<uint64_t>{6, 7, 8, 9, 10, 11, 12, 13, 14, 15}));
+
+  replay_setting.mode_ = tcp_pubsub::SubscriberReplaySetting::Mode::None;
+  TEST_CHECK(replay(executor, publisher, replay_setting).empty());
+
+  replay_setting.mode_  = tcp_pubsub::SubscriberReplaySetting::Mode::LastN;
+  replay_setting.count_ = 4;
+  TEST_CHECK((replay(executor, publisher, replay_setting) == std::vector<uint64_t>{12, 13, 14, 15}));
+
+  replay_setting.mode_  = tcp_pubsub::SubscriberReplaySetting::Mode::SinceTime;
+  replay_setting.since_ = between;
+  TEST_CHECK((replay(executor, publisher, replay_setting) == std::vector<uint64_t>{13, 14, 15}));
+
+  replay_setting.mode_            = tcp_pubsub::SubscriberReplaySetting::Mode::AfterSequenceNumber;
+  replay_setting.sequence_number_ = 10;
+  TEST_CHECK((replay(executor, publisher, replay_setting) == std::vector<uint64_t>{11, 12, 13, 14, 15}));
+
+  return 0;
+}
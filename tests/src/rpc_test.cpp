@@ -0,0 +1,127 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// Requests sent over a subscriber session must be answered with the
+// response of the matching request, also if the publisher answers them out
+// of order, and must fail cleanly if there is no handler, no response in
+// time or no connection anymore.
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  std::string toString(const tcp_pubsub::RpcResponse& response)
+  {
+    return response.buffer_ ? std::string(response.buffer_->begin(), response.buffer_->end()) : std::string();
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  tcp_pubsub::Publisher  publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), "127.0.0.1", 0);
+  tcp_pubsub::Subscriber subscriber(executor);
+  subscriber.setCallback([](const tcp_pubsub::CallbackData&) {}, true);
+  auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+
+  // Without a handler
+  {
+    const auto response = session->call("request", 7, std::chrono::seconds(5));
+    TEST_CHECK(response.status_ == tcp_pubsub::RpcResponse::Status::NoHandler);
+  }
+
+  // Requests starting with "hold" are answered later from the test thread,
+  // all others are echoed right away
+  std::mutex                                       held_mutex;
+  std::vector<std::pair<std::string, tcp_pubsub::RpcResponder>> held;
+  publisher.setRpcHandler([&](const tcp_pubsub::CallbackData& request, const tcp_pubsub::RpcResponder& respond)
+                          {
+                            const std::string payload(request.buffer_->begin(), request.buffer_->end());
+                            if (payload.compare(0, 4, "hold") == 0)
+                            {
+                              std::lock_guard<std::mutex> lock(held_mutex);
+                              held.emplace_back(payload, respond);
+                              return;
+                            }
+
+                            TEST_CHECK(respond(payload.data(), payload.size()));
+                            TEST_CHECK(!respond("twice", 5));   // Only the first response is sent
+                          });
+
+  // Echo
+  {
+    const auto response = session->call("echo", 4, std::chrono::seconds(5));
+    TEST_CHECK(response.status_ == tcp_pubsub::RpcResponse::Status::Ok);
+    TEST_CHECK(toString(response) == "echo");
+  }
+
+  // Responses in reverse order must still reach the matching callback
+  {
+    std::mutex                         responses_mutex;
+    std::map<std::string, std::string> responses;
+    for (int i = 0; i < 5; i++)
+    {
+      const std::string request = "hold" + std::to_string(i);
+      TEST_CHECK(session->callAsync(request.data(), request.size()
+                                   , [&, request](const tcp_pubsub::RpcResponse& response)
+                                     {
+                                       std::lock_guard<std::mutex> lock(responses_mutex);
+                                       responses[request] = toString(response);
+                                     }));
+    }
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(held_mutex); return held.size() == 5; }));
+    {
+      std::lock_guard<std::mutex> lock(held_mutex);
+      for (auto it = held.rbegin(); it != held.rend(); ++it)
+      {
+        const std::string response = "response to " + it->first;
+        TEST_CHECK(it->second(response.data(), response.size()));
+      }
+      held.clear();
+    }
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(responses_mutex); return responses.size() == 5; }));
+    std::lock_guard<std::mutex> lock(responses_mutex);
+    for (const auto& response : responses)
+      TEST_CHECK(response.second == "response to " + response.first);
+  }
+
+  // Timeout
+  {
+    const auto response = session->call("hold timeout", 12, std::chrono::milliseconds(100));
+    TEST_CHECK(response.status_ == tcp_pubsub::RpcResponse::Status::Timeout);
+  }
+
+  // Connection lost while waiting for the response
+  {
+    std::atomic<int> status{-1};
+    TEST_CHECK(session->callAsync("hold lost", 9, [&](const tcp_pubsub::RpcResponse& response) { status = static_cast<int>(response.status_); }));
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(held_mutex); return held.size() == 2; }));
+
+    publisher.cancel();
+    TEST_CHECK(test_helpers::waitUntil([&]() { return status >= 0; }));
+    TEST_CHECK(status == static_cast<int>(tcp_pubsub::RpcResponse::Status::ConnectionLost));
+
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.clear();
+  }
+
+  // A canceled session does not accept requests anymore
+  session->cancel();
+  TEST_CHECK(test_helpers::waitUntil([&]() { return !session->callAsync("x", 1, [](const tcp_pubsub::RpcResponse&) {}); }));
+
+  return 0;
+}
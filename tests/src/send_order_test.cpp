@@ -0,0 +1,110 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+// Sequence numbers must be handed to the sessions and to the history in the
+// order they have been assigned, also if several threads call send() at the
+// same time. Otherwise subscribers drop the message that has been overtaken.
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tcp_pubsub/executor.h>
+#include <tcp_pubsub/publisher.h>
+#include <tcp_pubsub/subscriber.h>
+
+#include "test_helpers.h"
+
+namespace
+{
+  constexpr int    sending_threads     = 4;
+  constexpr int    messages_per_thread = 2500;
+  constexpr size_t total_messages      = sending_threads * messages_per_thread;
+
+  void sendConcurrently(const tcp_pubsub::Publisher& publisher)
+  {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < sending_threads; i++)
+    {
+      threads.emplace_back([&publisher]()
+                           {
+                             for (int j = 0; j < messages_per_thread; j++)
+                               publisher.send("x", 1);
+                           });
+    }
+    for (auto& thread : threads)
+      thread.join();
+  }
+
+  // A reliable subscriber must receive every number exactly once and in order
+  void testLiveOrder(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    tcp_pubsub::PublisherReliableSetting reliable_setting;
+    reliable_setting.enabled_ = true;
+    tcp_pubsub::Publisher publisher(executor, tcp_pubsub::PublisherTransientLocalSetting(), reliable_setting, "127.0.0.1", 0);
+
+    std::mutex            received_mutex;
+    std::vector<uint64_t> received;
+    tcp_pubsub::Subscriber subscriber(executor);
+    subscriber.setCallback([&](const tcp_pubsub::CallbackData& data)
+                           {
+                             std::lock_guard<std::mutex> lock(received_mutex);
+                             received.push_back(data.sequence_number_);
+                           }, true);
+    auto session = subscriber.addSession("127.0.0.1", publisher.getPort());
+    TEST_CHECK(test_helpers::waitUntil([&]() { return session->isConnected() && (publisher.getSubscriberCount() == 1); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    sendConcurrently(publisher);
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(received_mutex); return received.size() >= total_messages; }));
+
+    std::lock_guard<std::mutex> lock(received_mutex);
+    TEST_CHECK(received.size() == total_messages);
+    for (size_t i = 0; i < received.size(); i++)
+      TEST_CHECK(received[i] == i + 1);
+  }
+
+  // The history must be sorted by sequence number, so replaying after a
+  // number returns exactly the newer messages
+  void testHistoryOrder(const std::shared_ptr<tcp_pubsub::Executor>& executor)
+  {
+    tcp_pubsub::PublisherTransientLocalSetting transient_local_setting;
+    transient_local_setting.buffer_max_count_ = 100;
+    tcp_pubsub::Publisher publisher(executor, transient_local_setting, "127.0.0.1", 0);
+
+    sendConcurrently(publisher);
+
+    tcp_pubsub::SubscriberReplaySetting replay_setting;
+    replay_setting.mode_            = tcp_pubsub::SubscriberReplaySetting::Mode::AfterSequenceNumber;
+    replay_setting.sequence_number_ = total_messages - 50;
+
+    std::mutex            received_mutex;
+    std::vector<uint64_t> received;
+    tcp_pubsub::Subscriber subscriber(executor);
+    subscriber.setCallback([&](const tcp_pubsub::CallbackData& data)
+                           {
+                             std::lock_guard<std::mutex> lock(received_mutex);
+                             received.push_back(data.sequence_number_);
+                           }, true);
+    subscriber.addSession("127.0.0.1", publisher.getPort(), replay_setting);
+
+    TEST_CHECK(test_helpers::waitUntil([&]() { std::lock_guard<std::mutex> lock(received_mutex); return received.size() >= 50; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lock(received_mutex);
+    TEST_CHECK(received.size() == 50);
+    for (size_t i = 0; i < received.size(); i++)
+      TEST_CHECK(received[i] == total_messages - 50 + i + 1);
+  }
+}
+
+int main()
+{
+  const auto executor = test_helpers::quietExecutor();
+
+  testLiveOrder(executor);
+  testHistoryOrder(executor);
+
+  return 0;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) Continental. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for details.
+
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <tcp_pubsub/executor.h>
+
+// Exits the test with a failure, if the condition does not hold
+#define TEST_CHECK(condition)                                                                         \
+  do                                                                                                  \
+  {                                                                                                   \
+    if (!(condition))                                                                                 \
+    {                                                                                                 \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": Check failed: " << #condition << std::endl;      \
+      std::exit(EXIT_FAILURE);                                                                        \
+    }                                                                                                 \
+  } while (false)
+
+namespace test_helpers
+{
+  // Polls the predicate until it returns true or the timeout has expired.
+  // Returns the last result of the predicate.
+  inline bool waitUntil(const std::function<bool()>& predicate, std::chrono::milliseconds timeout = std::chrono::seconds(10))
+  {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate())
+    {
+      if (std::chrono::steady_clock::now() >= deadline)
+        return predicate();
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+  }
+
+  // Executor that does not log, so the test output only shows failed checks
+  inline std::shared_ptr<tcp_pubsub::Executor> quietExecutor(size_t thread_count = 4)
+  {
+    return std::make_shared<tcp_pubsub::Executor>(thread_count, [](const tcp_pubsub::logger::LogLevel, const std::string&) {});
+  }
+
+  // Returns the sum of all samples of a counter in the Prometheus text format
+  inline uint64_t prometheusCounter(const std::string& prometheus_text, const std::string& name)
+  {
+    uint64_t           sum = 0;
+    std::istringstream lines(prometheus_text);
+    std::string        line;
+    while (std::getline(lines, line))
+    {
+      if ((line.compare(0, name.size(), name) == 0) && (line.size() > name.size()) && (line[name.size()] == '{'))
+        sum += std::stoull(line.substr(line.rfind(' ') + 1));
+    }
+    return sum;
+  }
+}